@@ -0,0 +1,132 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * disasm_test.c - Check the decode tree against the old linear scan for every opcode
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "disasm.h"
+
+/* Branch targets depend on the PC so use somewhere in user memory */
+#define TEST_PC       0x08900000
+/* Print progress every this many opcodes */
+#define TEST_PROGRESS 0x10000000
+/* Stop reporting after this many mismatches */
+#define TEST_MAXERR   20
+
+void refDisasmSetOpts(const char *opts, int set);
+const char *refDisasmInstruction(unsigned int opcode, unsigned int PC, unsigned int *realregs, unsigned int *regmask);
+
+/* Differences from the old disassembler which are intended. ll and bgezal had typos in
+ * their table entries, and the register mask is now cleared for unknown opcodes where it
+ * used to be left alone */
+static int expected_diff(const struct DisasmResult *res, int text, int mask)
+{
+	const char *name;
+
+	if(res->id == DISASM_ID_UNKNOWN)
+	{
+		return !text;
+	}
+
+	name = disasmGetName(res->id);
+	if((strcmp(name, "ll") == 0) || (strcmp(name, "bgezal") == 0))
+	{
+		return !mask;
+	}
+
+	return 0;
+}
+
+static void print_help(void)
+{
+	fprintf(stderr, "Usage: disasm-test [options]\n");
+	fprintf(stderr, "Compare the disassembler with the old linear scan for every 32bit opcode\n\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "-s start : First opcode to check (default 0)\n");
+	fprintf(stderr, "-n count : Number of opcodes to check (default all)\n");
+	fprintf(stderr, "-o opts  : Set disassembler options on both\n");
+	fprintf(stderr, "-O opts  : Clear disassembler options on both\n");
+	fprintf(stderr, "-h       : Print this help\n");
+}
+
+int main(int argc, char **argv)
+{
+	char output[DISASM_MAX_TEXT];
+	struct DisasmResult res;
+	unsigned int start = 0;
+	unsigned long long count = 0x100000000ULL;
+	unsigned long long i;
+	unsigned long long errors = 0;
+	unsigned long long allowed = 0;
+	int ch;
+
+	while((ch = getopt(argc, argv, "s:n:o:O:h")) != -1)
+	{
+		switch(ch)
+		{
+			case 's': start = strtoul(optarg, NULL, 0);
+					  break;
+			case 'n': count = strtoull(optarg, NULL, 0);
+					  break;
+			case 'o': disasmSetOpts(optarg, 1);
+					  refDisasmSetOpts(optarg, 1);
+					  break;
+			case 'O': disasmSetOpts(optarg, 0);
+					  refDisasmSetOpts(optarg, 0);
+					  break;
+			default: print_help();
+					 return 1;
+		};
+	}
+
+	disasmInit();
+
+	for(i = 0; i < count; i++)
+	{
+		unsigned int opcode = start + (unsigned int) i;
+		unsigned int refmask = 0;
+		unsigned int mask = 0;
+		const char *ref;
+		int text;
+
+		ref = refDisasmInstruction(opcode, TEST_PC, NULL, &refmask);
+		disasmDecode(opcode, TEST_PC, &res);
+		disasmFormat(&res, NULL, output, &mask);
+
+		text = strcmp(ref, output) != 0;
+		if((text) || (refmask != mask))
+		{
+			if(expected_diff(&res, text, refmask != mask))
+			{
+				allowed++;
+			}
+			else
+			{
+				errors++;
+				if(errors <= TEST_MAXERR)
+				{
+					printf("Mismatch %08X\n  old: %s (regs %08X)\n  new: %s (regs %08X)\n", opcode, ref, refmask, output, mask);
+				}
+			}
+		}
+
+		if(((i + 1) % TEST_PROGRESS) == 0)
+		{
+			fprintf(stderr, "Checked %llu of %llu opcodes\n", i + 1, count);
+		}
+	}
+
+	printf("%llu opcodes checked, %llu expected differences, %llu mismatches\n", count, allowed, errors);
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,1009 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * main.c - Host side PSP disassembler
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "disasm.h"
+
+#define MAX_THREADS    32
+/* Number of instructions handed to a thread at a time */
+#define CHUNK_WORDS    (16*1024)
+/* Chunks queued per thread before the output is flushed */
+#define CHUNKS_PER_THREAD 4
+#define MAX_SECTIONS   64
+#define MAX_SYMNAME    128
+
+#define ELF_MACHINE_MIPS 8
+#define ELF_EXEC_TYPE    2
+#define ELF_PRX_TYPE     0xFFA0
+#define PT_LOAD          1
+#define PF_X             1
+#define SHT_PROGBITS     1
+#define SHT_SYMTAB       2
+#define SHT_PRXRELOC     0x700000A0
+#define SHF_EXECINSTR    4
+#define STT_NOTYPE       0
+#define STT_FUNC         2
+
+#define R_MIPS_NONE      0
+#define R_MIPS_32        2
+#define R_MIPS_26        4
+#define R_MIPS_HI16      5
+#define R_MIPS_LO16      6
+
+#define SYMFILE_MAGIC    "SYMS"
+#define SYMFILE_HEADER   44
+#define SYMFILE_ENTRY    12
+#define MODNAME_SIZE     28
+
+struct Symbol
+{
+	unsigned int addr;
+	unsigned int size;
+	char *name;
+};
+
+struct Section
+{
+	char name[32];
+	unsigned int addr;
+	unsigned int size;
+	const unsigned char *data;
+};
+
+struct Chunk
+{
+	const unsigned char *data;
+	unsigned int addr;
+	int count;
+	char *text;
+	int len;
+};
+
+struct Args
+{
+	const char *file;
+	const char *symfiles[16];
+	int symcount;
+	const char *setopts;
+	const char *clropts;
+	unsigned int base;
+	unsigned int start;
+	unsigned int length;
+	int raw;
+	int threads;
+};
+
+static struct Args g_args;
+
+static struct Symbol *g_syms = NULL;
+static int g_symcount = 0;
+static int g_symalloc = 0;
+
+static struct Section g_sections[MAX_SECTIONS];
+static int g_sectcount = 0;
+
+static unsigned char *g_file = NULL;
+static unsigned int g_filesize = 0;
+/* Loaded program image for ELF files */
+static unsigned char *g_image = NULL;
+static unsigned int g_imagebase = 0;
+static unsigned int g_imagesize = 0;
+
+/* Work queue for the decode threads */
+static struct Chunk *g_chunks = NULL;
+static int g_chunkcount = 0;
+static int g_nextchunk = 0;
+static pthread_mutex_t g_chunklock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int read32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+static unsigned int read16(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static void write32(unsigned char *p, unsigned int val)
+{
+	p[0] = val;
+	p[1] = val >> 8;
+	p[2] = val >> 16;
+	p[3] = val >> 24;
+}
+
+static unsigned char *load_file(const char *file, unsigned int *size)
+{
+	FILE *fp;
+	unsigned char *data = NULL;
+	long len;
+
+	fp = fopen(file, "rb");
+	if(fp == NULL)
+	{
+		fprintf(stderr, "Error could not open file %s\n", file);
+		return NULL;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	if(len > 0)
+	{
+		data = malloc(len);
+		if(data)
+		{
+			if(fread(data, 1, len, fp) != (size_t) len)
+			{
+				fprintf(stderr, "Error reading file %s\n", file);
+				free(data);
+				data = NULL;
+			}
+			else
+			{
+				*size = len;
+			}
+		}
+		else
+		{
+			fprintf(stderr, "Error could not allocate %ld bytes\n", len);
+		}
+	}
+	else
+	{
+		fprintf(stderr, "Error file %s is empty\n", file);
+	}
+
+	fclose(fp);
+
+	return data;
+}
+
+static int add_symbol(unsigned int addr, unsigned int size, const char *name)
+{
+	if(g_symcount == g_symalloc)
+	{
+		struct Symbol *syms;
+		int alloc;
+
+		alloc = g_symalloc ? g_symalloc * 2 : 256;
+		syms = realloc(g_syms, alloc * sizeof(struct Symbol));
+		if(syms == NULL)
+		{
+			fprintf(stderr, "Error could not allocate symbol table\n");
+			return 0;
+		}
+		g_syms = syms;
+		g_symalloc = alloc;
+	}
+
+	g_syms[g_symcount].addr = addr;
+	g_syms[g_symcount].size = size;
+	g_syms[g_symcount].name = strdup(name);
+	if(g_syms[g_symcount].name == NULL)
+	{
+		return 0;
+	}
+	g_symcount++;
+
+	return 1;
+}
+
+static int sym_compare(const void *left, const void *right)
+{
+	const struct Symbol *l = left;
+	const struct Symbol *r = right;
+
+	if(l->addr < r->addr)
+	{
+		return -1;
+	}
+	else if(l->addr > r->addr)
+	{
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Sort the symbols and give unsized ones the space up to the next symbol */
+static void sort_symbols(void)
+{
+	int i;
+
+	qsort(g_syms, g_symcount, sizeof(struct Symbol), sym_compare);
+	for(i = 0; i < g_symcount; i++)
+	{
+		if((g_syms[i].size == 0) && (i < (g_symcount-1)))
+		{
+			g_syms[i].size = g_syms[i+1].addr - g_syms[i].addr;
+		}
+	}
+}
+
+/* Returns the last symbol starting at or before addr, NULL if none */
+static const struct Symbol *find_symbol(unsigned int addr)
+{
+	int low = 0;
+	int high = g_symcount - 1;
+	const struct Symbol *sym = NULL;
+
+	while(low <= high)
+	{
+		int mid = (low + high) / 2;
+
+		if(g_syms[mid].addr <= addr)
+		{
+			sym = &g_syms[mid];
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid - 1;
+		}
+	}
+
+	return sym;
+}
+
+/* Symbol resolver for the disassembler, called from the decode threads */
+static int resolve_symbol(unsigned int addr, char *output, int size)
+{
+	const struct Symbol *sym;
+
+	sym = find_symbol(addr);
+	if((sym == NULL) || ((addr - sym->addr) >= sym->size))
+	{
+		return 0;
+	}
+
+	if(addr > sym->addr)
+	{
+		snprintf(output, size, "%s+0x%x", sym->name, addr - sym->addr);
+	}
+	else
+	{
+		snprintf(output, size, "%s", sym->name);
+	}
+
+	return 1;
+}
+
+/* Load a psplink symbol file, relative addresses are based on the load address */
+static int load_symfile(const char *file)
+{
+	unsigned char *data;
+	unsigned int size;
+	unsigned int symcount, strstart, strsize;
+	int ret = 0;
+	unsigned int i;
+
+	data = load_file(file, &size);
+	if(data == NULL)
+	{
+		return 0;
+	}
+
+	do
+	{
+		if((size < SYMFILE_HEADER) || (memcmp(data, SYMFILE_MAGIC, 4) != 0))
+		{
+			fprintf(stderr, "Error %s is not a symbol file\n", file);
+			break;
+		}
+
+		symcount = read32(data + 4 + MODNAME_SIZE);
+		strstart = read32(data + 8 + MODNAME_SIZE);
+		strsize = read32(data + 12 + MODNAME_SIZE);
+		if((((unsigned long long) symcount * SYMFILE_ENTRY) + strsize + SYMFILE_HEADER) != size)
+		{
+			fprintf(stderr, "Error invalid size for symbol file %s\n", file);
+			break;
+		}
+
+		for(i = 0; i < symcount; i++)
+		{
+			const unsigned char *entry = data + SYMFILE_HEADER + (i * SYMFILE_ENTRY);
+			unsigned int name, addr;
+			char symname[MAX_SYMNAME];
+
+			name = read32(entry);
+			addr = read32(entry + 4);
+			if((name >= strsize) || ((strstart + name) >= size))
+			{
+				continue;
+			}
+			snprintf(symname, sizeof(symname), "%.*s", (int) (size - strstart - name), (const char *) data + strstart + name);
+			if(addr < 0x08000000)
+			{
+				addr += g_args.base;
+			}
+			if(!add_symbol(addr, read32(entry + 8), symname))
+			{
+				break;
+			}
+		}
+
+		ret = (i == symcount);
+	}
+	while(0);
+
+	free(data);
+
+	return ret;
+}
+
+static void add_section(const char *name, unsigned int addr, unsigned int size, const unsigned char *data)
+{
+	struct Section *sect;
+
+	if(g_sectcount == MAX_SECTIONS)
+	{
+		fprintf(stderr, "Warning too many sections, ignoring %s\n", name);
+		return;
+	}
+
+	sect = &g_sections[g_sectcount++];
+	snprintf(sect->name, sizeof(sect->name), "%s", name);
+	sect->addr = addr;
+	sect->size = size & ~3;
+	sect->data = data;
+}
+
+/* Image offset a relocation applies to, -1 if invalid */
+static int reloc_offset(const unsigned char *rel, const unsigned char *phdrs, int phnum)
+{
+	unsigned int info = read32(rel + 4);
+	int ofsph = (info >> 8) & 0xFF;
+	unsigned int loc;
+
+	if(ofsph >= phnum)
+	{
+		return -1;
+	}
+
+	loc = read32(phdrs + (ofsph * 32) + 8) + read32(rel) - g_imagebase;
+	if((loc + 4) > g_imagesize)
+	{
+		return -1;
+	}
+
+	return loc;
+}
+
+/* Relocate a HI16, the carry from the low half comes from the following LO16 */
+static unsigned int reloc_hi16(unsigned int word, unsigned int relbase, const unsigned char *rel, 
+		unsigned int left, const unsigned char *phdrs, int phnum)
+{
+	unsigned int addr;
+	unsigned int i;
+
+	addr = (word & 0xFFFF) << 16;
+	for(i = 1; i < left; i++)
+	{
+		if((read32(rel + (i * 8) + 4) & 0xFF) == R_MIPS_LO16)
+		{
+			int loc = reloc_offset(rel + (i * 8), phdrs, phnum);
+
+			if(loc >= 0)
+			{
+				addr += (short) read16(g_image + loc);
+			}
+			break;
+		}
+	}
+
+	addr += relbase;
+
+	return (word & ~0xFFFF) | (((addr >> 16) + ((addr & 0x8000) ? 1 : 0)) & 0xFFFF);
+}
+
+/* Apply the PSP relocations in a section to the loaded image */
+static void apply_relocs(const unsigned char *rel, unsigned int size, const unsigned char *phdrs, int phnum)
+{
+	unsigned int count = size / 8;
+	unsigned int i;
+	int warned = 0;
+
+	for(i = 0; i < count; i++)
+	{
+		unsigned int info = read32(rel + (i * 8) + 4);
+		int valph = (info >> 16) & 0xFF;
+		unsigned int relbase, word;
+		int loc;
+
+		loc = reloc_offset(rel + (i * 8), phdrs, phnum);
+		if((loc < 0) || (valph >= phnum))
+		{
+			continue;
+		}
+
+		relbase = g_args.base + read32(phdrs + (valph * 32) + 8);
+		word = read32(g_image + loc);
+		switch(info & 0xFF)
+		{
+			case R_MIPS_NONE: break;
+			case R_MIPS_32: word += relbase;
+							break;
+			case R_MIPS_26: word = (word & ~0x03FFFFFF) | ((word + (relbase >> 2)) & 0x03FFFFFF);
+							break;
+			case R_MIPS_HI16: word = reloc_hi16(word, relbase, rel + (i * 8), count - i, phdrs, phnum);
+							  break;
+			case R_MIPS_LO16: word = (word & ~0xFFFF) | ((word + relbase) & 0xFFFF);
+							  break;
+			default: if(!warned)
+					 {
+						 fprintf(stderr, "Warning unsupported relocation type %d\n", info & 0xFF);
+						 warned = 1;
+					 }
+					 break;
+		};
+
+		write32(g_image + loc, word);
+	}
+}
+
+static int load_elf(void)
+{
+	const unsigned char *ehdr = g_file;
+	const unsigned char *phdrs, *shdrs;
+	const char *shstrtab = NULL;
+	unsigned int type, phoff, shoff, phnum, shnum, shstrndx;
+	unsigned int reloc;
+	unsigned int end = 0;
+	unsigned int i;
+
+	if((g_filesize < 52) || (ehdr[4] != 1) || (ehdr[5] != 1) || (read16(ehdr + 18) != ELF_MACHINE_MIPS))
+	{
+		fprintf(stderr, "Error not a 32bit little endian MIPS ELF\n");
+		return 0;
+	}
+
+	type = read16(ehdr + 16);
+	phoff = read32(ehdr + 28);
+	shoff = read32(ehdr + 32);
+	phnum = read16(ehdr + 44);
+	shnum = read16(ehdr + 48);
+	shstrndx = read16(ehdr + 50);
+
+	if((phoff + (phnum * 32)) > g_filesize)
+	{
+		phnum = 0;
+	}
+	if((shoff + (shnum * 40)) > g_filesize)
+	{
+		shnum = 0;
+	}
+	phdrs = g_file + phoff;
+	shdrs = g_file + shoff;
+
+	/* PRX addresses are relative, everything moves by the base */
+	reloc = (type == ELF_PRX_TYPE) ? g_args.base : 0;
+
+	g_imagebase = 0xFFFFFFFF;
+	for(i = 0; i < phnum; i++)
+	{
+		const unsigned char *ph = phdrs + (i * 32);
+
+		if(read32(ph) == PT_LOAD)
+		{
+			if(read32(ph + 8) < g_imagebase)
+			{
+				g_imagebase = read32(ph + 8);
+			}
+			if((read32(ph + 8) + read32(ph + 20)) > end)
+			{
+				end = read32(ph + 8) + read32(ph + 20);
+			}
+		}
+	}
+
+	if(end > g_imagebase)
+	{
+		g_imagesize = end - g_imagebase;
+		g_image = calloc(1, g_imagesize);
+		if(g_image == NULL)
+		{
+			fprintf(stderr, "Error could not allocate %u bytes for the image\n", g_imagesize);
+			return 0;
+		}
+
+		for(i = 0; i < phnum; i++)
+		{
+			const unsigned char *ph = phdrs + (i * 32);
+			unsigned int offset = read32(ph + 4);
+			unsigned int filesz = read32(ph + 16);
+
+			if((read32(ph) == PT_LOAD) && (offset < g_filesize))
+			{
+				if(filesz > (g_filesize - offset))
+				{
+					filesz = g_filesize - offset;
+				}
+				memcpy(g_image + read32(ph + 8) - g_imagebase, g_file + offset, filesz);
+			}
+		}
+	}
+	else
+	{
+		g_imagebase = 0;
+	}
+
+	if(shstrndx < shnum)
+	{
+		unsigned int ofs = read32(shdrs + (shstrndx * 40) + 16);
+
+		if(ofs < g_filesize)
+		{
+			shstrtab = (const char *) g_file + ofs;
+		}
+	}
+
+	for(i = 0; i < shnum; i++)
+	{
+		const unsigned char *sh = shdrs + (i * 40);
+
+		if((read32(sh + 4) == SHT_PRXRELOC) && (g_image) && (reloc))
+		{
+			if((read32(sh + 16) + read32(sh + 20)) <= g_filesize)
+			{
+				apply_relocs(g_file + read32(sh + 16), read32(sh + 20), phdrs, phnum);
+			}
+		}
+	}
+
+	for(i = 0; i < shnum; i++)
+	{
+		const unsigned char *sh = shdrs + (i * 40);
+		const char *name = shstrtab ? shstrtab + read32(sh) : "";
+		unsigned int addr = read32(sh + 12);
+		unsigned int offset = read32(sh + 16);
+		unsigned int size = read32(sh + 20);
+
+		if((read32(sh + 4) == SHT_PROGBITS) && (read32(sh + 8) & SHF_EXECINSTR))
+		{
+			if((g_image) && (addr >= g_imagebase) && ((addr - g_imagebase + size) <= g_imagesize))
+			{
+				add_section(name, addr + reloc, size, g_image + addr - g_imagebase);
+			}
+			else if((offset + size) <= g_filesize)
+			{
+				add_section(name, addr + reloc, size, g_file + offset);
+			}
+		}
+		else if(read32(sh + 4) == SHT_SYMTAB)
+		{
+			unsigned int link = read32(sh + 24);
+			const char *strtab;
+			unsigned int strsize;
+			unsigned int s;
+
+			if((link >= shnum) || ((offset + size) > g_filesize))
+			{
+				continue;
+			}
+
+			strtab = (const char *) g_file + read32(shdrs + (link * 40) + 16);
+			strsize = read32(shdrs + (link * 40) + 20);
+			if((read32(shdrs + (link * 40) + 16) + strsize) > g_filesize)
+			{
+				continue;
+			}
+			for(s = 0; s < (size / 16); s++)
+			{
+				const unsigned char *sym = g_file + offset + (s * 16);
+				unsigned int symname = read32(sym);
+				int symtype = sym[12] & 0xF;
+
+				if(((symtype == STT_FUNC) || (symtype == STT_NOTYPE)) && (read16(sym + 14) != 0)
+						&& (symname > 0) && (symname < strsize))
+				{
+					add_symbol(read32(sym + 4) + reloc, read32(sym + 8), strtab + symname);
+				}
+			}
+		}
+	}
+
+	/* Stripped files, fall back to the executable segments */
+	if(g_sectcount == 0)
+	{
+		for(i = 0; i < phnum; i++)
+		{
+			const unsigned char *ph = phdrs + (i * 32);
+
+			if((read32(ph) == PT_LOAD) && (read32(ph + 24) & PF_X) && (g_image))
+			{
+				add_section("segment", read32(ph + 8) + reloc, read32(ph + 16), g_image + read32(ph + 8) - g_imagebase);
+			}
+		}
+	}
+
+	return 1;
+}
+
+static int load_input(void)
+{
+	g_file = load_file(g_args.file, &g_filesize);
+	if(g_file == NULL)
+	{
+		return 0;
+	}
+
+	if((g_filesize >= 4) && (memcmp(g_file, "~PSP", 4) == 0))
+	{
+		fprintf(stderr, "Error %s is an encrypted PRX\n", g_args.file);
+		return 0;
+	}
+
+	if((!g_args.raw) && (g_filesize >= 4) && (memcmp(g_file, "\177ELF", 4) == 0))
+	{
+		return load_elf();
+	}
+
+	add_section("raw", g_args.base, g_filesize, g_file);
+
+	return 1;
+}
+
+static int append_text(struct Chunk *chunk, int *alloc, const char *text)
+{
+	int len = strlen(text);
+
+	if((chunk->len + len + 1) > *alloc)
+	{
+		char *buf;
+		int size = *alloc * 2 + len + 1;
+
+		buf = realloc(chunk->text, size);
+		if(buf == NULL)
+		{
+			return 0;
+		}
+		chunk->text = buf;
+		*alloc = size;
+	}
+
+	memcpy(chunk->text + chunk->len, text, len + 1);
+	chunk->len += len;
+
+	return 1;
+}
+
+static void process_chunk(struct Chunk *chunk, unsigned int *code, struct DisasmResult *res)
+{
+	char line[DISASM_MAX_TEXT + 1];
+	int alloc = chunk->count * 64;
+	int i;
+
+	chunk->len = 0;
+	chunk->text = malloc(alloc);
+	if(chunk->text == NULL)
+	{
+		return;
+	}
+	chunk->text[0] = 0;
+
+	for(i = 0; i < chunk->count; i++)
+	{
+		code[i] = read32(chunk->data + (i * 4));
+	}
+
+	disasmRange(code, chunk->addr, chunk->count, res);
+
+	for(i = 0; i < chunk->count; i++)
+	{
+		const struct Symbol *sym;
+
+		sym = find_symbol(res[i].pc);
+		if((sym) && (sym->addr == res[i].pc))
+		{
+			snprintf(line, sizeof(line), "\n; ======================================================\n%s:\n", sym->name);
+			if(!append_text(chunk, &alloc, line))
+			{
+				break;
+			}
+		}
+
+		disasmFormat(&res[i], NULL, line, NULL);
+		strcat(line, "\n");
+		if(!append_text(chunk, &alloc, line))
+		{
+			break;
+		}
+	}
+}
+
+static void *decode_thread(void *arg)
+{
+	unsigned int *code;
+	struct DisasmResult *res;
+
+	code = malloc(CHUNK_WORDS * sizeof(unsigned int));
+	res = malloc(CHUNK_WORDS * sizeof(struct DisasmResult));
+
+	if((code) && (res))
+	{
+		while(1)
+		{
+			int next;
+
+			pthread_mutex_lock(&g_chunklock);
+			next = g_nextchunk++;
+			pthread_mutex_unlock(&g_chunklock);
+
+			if(next >= g_chunkcount)
+			{
+				break;
+			}
+
+			process_chunk(&g_chunks[next], code, res);
+		}
+	}
+
+	free(code);
+	free(res);
+
+	return NULL;
+}
+
+/* Decode the queued chunks across the threads and print them in order */
+static int flush_chunks(void)
+{
+	pthread_t threads[MAX_THREADS];
+	int started = 0;
+	int ret = 1;
+	int i;
+
+	g_nextchunk = 0;
+	if(g_args.threads > 1)
+	{
+		for(i = 0; i < g_args.threads; i++)
+		{
+			if(pthread_create(&threads[started], NULL, decode_thread, NULL) == 0)
+			{
+				started++;
+			}
+		}
+	}
+
+	/* Run on this thread as well, also covers failing to start any */
+	decode_thread(NULL);
+
+	for(i = 0; i < started; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	for(i = 0; i < g_chunkcount; i++)
+	{
+		if(g_chunks[i].text)
+		{
+			fwrite(g_chunks[i].text, 1, g_chunks[i].len, stdout);
+			free(g_chunks[i].text);
+			g_chunks[i].text = NULL;
+		}
+		else
+		{
+			fprintf(stderr, "Error could not allocate memory for output\n");
+			ret = 0;
+		}
+	}
+	g_chunkcount = 0;
+
+	return ret;
+}
+
+static int disasm_section(const struct Section *sect)
+{
+	unsigned int addr = sect->addr;
+	unsigned int end = sect->addr + sect->size;
+	int maxchunks = g_args.threads * CHUNKS_PER_THREAD;
+
+	if(g_args.length)
+	{
+		if((g_args.start >= end) || ((g_args.start + g_args.length) <= addr))
+		{
+			return 1;
+		}
+		if(g_args.start > addr)
+		{
+			addr = g_args.start & ~3;
+		}
+		if((g_args.start + g_args.length) < end)
+		{
+			end = g_args.start + g_args.length;
+		}
+	}
+
+	printf("\n; Section %s 0x%08X - 0x%08X\n", sect->name, addr, end);
+
+	while(addr < end)
+	{
+		struct Chunk *chunk = &g_chunks[g_chunkcount++];
+		unsigned int words = (end - addr + 3) / 4;
+
+		if(words > CHUNK_WORDS)
+		{
+			words = CHUNK_WORDS;
+		}
+		if((addr + words * 4) > (sect->addr + sect->size))
+		{
+			words = (sect->addr + sect->size - addr) / 4;
+		}
+		if(words == 0)
+		{
+			g_chunkcount--;
+			break;
+		}
+
+		chunk->data = sect->data + (addr - sect->addr);
+		chunk->addr = addr;
+		chunk->count = words;
+		chunk->text = NULL;
+		chunk->len = 0;
+		addr += words * 4;
+
+		if(g_chunkcount == maxchunks)
+		{
+			if(!flush_chunks())
+			{
+				return 0;
+			}
+		}
+	}
+
+	return flush_chunks();
+}
+
+static void print_help(void)
+{
+	fprintf(stderr, "Usage: psp-disasm [options] file\n");
+	fprintf(stderr, "Disassemble a PSP ELF, PRX or raw memory dump\n\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "-b addr    : Base address of a raw dump or PRX (default 0)\n");
+	fprintf(stderr, "-a addr    : Start disassembling at addr\n");
+	fprintf(stderr, "-l len     : Disassemble len bytes\n");
+	fprintf(stderr, "-s file    : Load a psplink symbol file, may be repeated\n");
+	fprintf(stderr, "-o opts    : Set disassembler options\n");
+	fprintf(stderr, "-O opts    : Clear disassembler options\n");
+	fprintf(stderr, "-r         : Treat the file as raw even if it is an ELF\n");
+	fprintf(stderr, "-j threads : Number of decode threads (default one per cpu)\n");
+	fprintf(stderr, "-h         : Print this help\n\n");
+	disasmPrintOpts();
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int ch;
+
+	memset(&g_args, 0, sizeof(g_args));
+	g_args.threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	while((ch = getopt(argc, argv, "b:a:l:s:o:O:rj:h")) != -1)
+	{
+		switch(ch)
+		{
+			case 'b': g_args.base = strtoul(optarg, NULL, 0);
+					  break;
+			case 'a': g_args.start = strtoul(optarg, NULL, 0);
+					  break;
+			case 'l': g_args.length = strtoul(optarg, NULL, 0);
+					  break;
+			case 's': if(g_args.symcount < (sizeof(g_args.symfiles) / sizeof(g_args.symfiles[0])))
+					  {
+						  g_args.symfiles[g_args.symcount++] = optarg;
+					  }
+					  else
+					  {
+						  fprintf(stderr, "Too many symbol files\n");
+					  }
+					  break;
+			case 'o': g_args.setopts = optarg;
+					  break;
+			case 'O': g_args.clropts = optarg;
+					  break;
+			case 'r': g_args.raw = 1;
+					  break;
+			case 'j': g_args.threads = atoi(optarg);
+					  break;
+			case 'h':
+			default: return 0;
+		};
+	}
+
+	if(optind >= argc)
+	{
+		return 0;
+	}
+	g_args.file = argv[optind];
+
+	if((g_args.start) && (g_args.length == 0))
+	{
+		g_args.length = 0xFFFFFFFF - g_args.start;
+	}
+
+	if(g_args.threads < 1)
+	{
+		g_args.threads = 1;
+	}
+	else if(g_args.threads > MAX_THREADS)
+	{
+		g_args.threads = MAX_THREADS;
+	}
+
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+
+	if(!parse_args(argc, argv))
+	{
+		print_help();
+		return 1;
+	}
+
+	if(g_args.setopts)
+	{
+		disasmSetOpts(g_args.setopts, 1);
+	}
+	if(g_args.clropts)
+	{
+		disasmSetOpts(g_args.clropts, 0);
+	}
+
+	if(!load_input())
+	{
+		return 1;
+	}
+
+	for(i = 0; i < g_args.symcount; i++)
+	{
+		if(!load_symfile(g_args.symfiles[i]))
+		{
+			return 1;
+		}
+	}
+
+	if(g_symcount > 0)
+	{
+		sort_symbols();
+		disasmSetSymResolver(resolve_symbol);
+	}
+
+	/* Build the decode tables before any threads start */
+	disasmInit();
+
+	g_chunks = calloc(g_args.threads * CHUNKS_PER_THREAD, sizeof(struct Chunk));
+	if(g_chunks == NULL)
+	{
+		fprintf(stderr, "Error could not allocate work queue\n");
+		return 1;
+	}
+
+	for(i = 0; i < g_sectcount; i++)
+	{
+		if(!disasm_section(&g_sections[i]))
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,22 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * regs.c - Register names for the host disassembler, on the PSP these
+ * live in exception.c
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+
+/* Mnemonic register names */
+const char *regName[32] =
+{
+    "zr", "at", "v0", "v1", "a0", "a1", "a2", "a3",
+    "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7", 
+    "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+    "t8", "t9", "k0", "k1", "gp", "sp", "fp", "ra"
+};
@@ -19,6 +19,7 @@
 #include <unistd.h>
 #include "gdb-common.h"
 #include "../psplink_user/psplink_user.h"
+#include "../psplink/decodeaddr.h"
 
 struct GdbContext g_context;
 
@@ -101,31 +102,76 @@ void GdbMain(void)
 	}
 }
 
-/* These should be changed on for different remote methods */
-int GdbReadByte(unsigned char *address, unsigned char *dest)
+/* Returns the number of bytes from addr which can be accessed, up to len. Checked
+ * once per block against psplink's region map, user accessible regions only */
+static int valid_range(u32 addr, int len, u32 attrib)
 {
-	u32 addr;
+	int size;
+
+	/* Kernel addresses fault in user mode whatever protoff says */
+	if((addr & 0x80000000) || (len <= 0))
+	{
+		return 0;
+	}
 
-	addr = (u32) address;
-	if((addr >= 0x08800000) && (addr < 0x0a000000))
+	size = memValidate(addr, attrib | MEM_ATTRIB_USER);
+	if(len > size)
 	{
-		*dest = *address;
-		return 1;
+		len = size;
 	}
 
-	return 0;
+	return len;
 }
 
-int GdbWriteByte(char val, unsigned char *dest)
+/* Copy memory, a word at a time when both sides are aligned */
+static void copy_memory(unsigned char *dest, const unsigned char *src, int len)
 {
-	u32 addr;
+	if((((u32) dest | (u32) src) & 3) == 0)
+	{
+		while(len >= 4)
+		{
+			*((u32 *) dest) = *((const u32 *) src);
+			dest += 4;
+			src += 4;
+			len -= 4;
+		}
+	}
 
-	addr = (u32) dest;
-	if((addr >= 0x08800000) && (addr < 0x0a000000))
+	while(len > 0)
+	{
+		*dest++ = *src++;
+		len--;
+	}
+}
+
+int GdbReadMemory(u32 addr, void *dest, int len)
+{
+	len = valid_range(addr, len, MEM_ATTRIB_READ | MEM_ATTRIB_BYTE);
+	if(len > 0)
 	{
-		*dest = val;
-		return 1;
+		copy_memory(dest, (const unsigned char *) addr, len);
 	}
 
-	return 0;
+	return len;
+}
+
+int GdbWriteMemory(const void *src, u32 addr, int len)
+{
+	len = valid_range(addr, len, MEM_ATTRIB_WRITE | MEM_ATTRIB_BYTE);
+	if(len > 0)
+	{
+		copy_memory((unsigned char *) addr, src, len);
+	}
+
+	return len;
+}
+
+int GdbReadByte(unsigned char *address, unsigned char *dest)
+{
+	return GdbReadMemory((u32) address, dest, 1);
+}
+
+int GdbWriteByte(char val, unsigned char *dest)
+{
+	return GdbWriteMemory(&val, (u32) dest, 1);
 }
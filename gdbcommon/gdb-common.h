@@ -48,6 +48,9 @@ extern struct GdbContext g_context;
 
 int GdbReadByte(unsigned char *address, unsigned char *dest);
 int GdbWriteByte(char val, unsigned char *dest);
+/* Block memory access, returns the number of bytes which could be accessed from addr */
+int GdbReadMemory(u32 addr, void *dest, int len);
+int GdbWriteMemory(const void *src, u32 addr, int len);
 int GdbHandleException (struct PsplinkContext *ctx);
 void GdbStubInit(void);
 int GdbTrapEntry(struct PsplinkContext *ctx);
@@ -57,7 +60,10 @@ int psplinkReferModule(SceUID uid, SceKernelModuleInfo *info);
 /* Link specific functions */
 int isInit(void);
 int putDebugChar(unsigned char ch);
-int getDebugChar(unsigned char *ch);
+/* Largest packet the link can receive in one go, <= 0 for no limit */
+int maxPacketSize(void);
+/* Read up to len bytes, blocking until at least one is available. Returns <= 0 on error */
+int  readDebugData(void *data, int len);
 int  writeDebugData(void *data, int len);
 void start_server(void);
 void stop_server(void);
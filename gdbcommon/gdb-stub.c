@@ -19,12 +19,15 @@
 #include <pspsdk.h>
 #include <psputilsforkernel.h>
 #include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
 #include <signal.h>
 #include <stdio.h>
 #include <ctype.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include "../psplink/debug.h"
+#include "../psplink/watch.h"
 #include "gdb-common.h"
 
 //#define DEBUG
@@ -42,14 +45,22 @@
 extern int sceKernelSuspendIntr(void);
 extern void sceKernelResumeIntr(int intr);
 
-#define MAX_BUF 2048
+/* Largest packet we will build or accept, links may advertise less */
+#define MAX_BUF (16*1024)
+#define RX_BUF  4096
 
 void _GdbExceptionHandler(void);
 static int initialised = 0;
 static char input[MAX_BUF];
 static char output[MAX_BUF];
+/* Staging buffer for memory transfers, large enough for the payload of any packet we accept */
+static unsigned char g_membuf[MAX_BUF];
 static const char hexchars[]="0123456789abcdef";
 static int attached = 0;
+/* Set once gdb has agreed to QStartNoAckMode */
+static int g_noack = 0;
+/* Set once gdb has said it understands swbreak stop reasons */
+static int g_swbreak = 0;
 
 #define SW_BREAK_INST	0x0000000d
 
@@ -73,28 +84,87 @@ void set_swbp(u32 addr)
 }
 
 /*
- * send the packet in buffer.
+ * Receive buffer, filled in blocks from the link and drained by the packet
+ * parser so we do not pay for a link round trip on every byte.
  */
-static int putpacket(unsigned char *buffer)
+static unsigned char g_rxbuf[RX_BUF];
+static int g_rxpos = 0;
+static int g_rxlen = 0;
+
+static void reset_rx(void)
+{
+	g_rxpos = 0;
+	g_rxlen = 0;
+}
+
+/*
+ * Make sure there is at least one byte in the receive buffer
+ */
+static int fill_rx(void)
 {
-	static unsigned char outputbuffer[4096];
+	int ret;
+
+	if(g_rxpos < g_rxlen)
+	{
+		return 1;
+	}
+
+	ret = readDebugData(g_rxbuf, sizeof(g_rxbuf));
+	if(ret <= 0)
+	{
+		/* Link is gone, throw away anything left over from it */
+		reset_rx();
+		return 0;
+	}
+
+	g_rxpos = 0;
+	g_rxlen = ret;
+
+	return 1;
+}
+
+static int get_char(unsigned char *ch)
+{
+	*ch = 0;
+	if(!fill_rx())
+	{
+		return 0;
+	}
+
+	*ch = g_rxbuf[g_rxpos++];
+
+	return 1;
+}
+
+/*
+ * send the packet in buffer, len bytes long (may contain binary data).
+ */
+static int putpacket_len(const unsigned char *buffer, int len)
+{
+	static unsigned char outputbuffer[MAX_BUF + 4];
 	unsigned char checksum;
 	int count;
 	unsigned char ch;
-	int i = 0;
+	int i;
 
 	/*
 	 * $<packet info>#<checksum>.
 	 */
 
+	if(len > MAX_BUF)
+	{
+		len = MAX_BUF;
+	}
+
 	do {
+		i = 0;
 		outputbuffer[i++] = '$';
 		checksum = 0;
-		count = 0;
 
-		while ((ch = buffer[count]) != 0) {
+		for(count = 0; count < len; count++)
+		{
+			ch = buffer[count];
 			checksum += ch;
-			count += 1;
 			outputbuffer[i++] = ch;
 		}
 
@@ -109,7 +179,12 @@ static int putpacket(unsigned char *buffer)
 
 		DEBUG_PRINTF("calculated checksum = %02X\n", checksum);
 
-		if(getDebugChar(&ch) <= 0)
+		if(g_noack)
+		{
+			break;
+		}
+
+		if(get_char(&ch) <= 0)
 		{
 			return 0;
 		}
@@ -119,6 +194,28 @@ static int putpacket(unsigned char *buffer)
 	return 1;
 }
 
+static int putpacket(unsigned char *buffer)
+{
+	return putpacket_len(buffer, strlen((char *) buffer));
+}
+
+/*
+ * Packet size to negotiate, the smaller of ours and the link's. getpacket needs
+ * room for the terminator so one less than MAX_BUF is the most we can take
+ */
+static int packet_size(void)
+{
+	int size;
+
+	size = maxPacketSize();
+	if((size <= 0) || (size > (MAX_BUF - 1)))
+	{
+		size = MAX_BUF - 1;
+	}
+
+	return size;
+}
+
 /*
  * Convert ch from a hex digit to an int
  */
@@ -140,8 +237,13 @@ static int getpacket(char *buffer)
 {
 	unsigned char checksum;
 	unsigned char xmitcsum;
+	unsigned char *start;
+	unsigned char *end;
+	unsigned char ack[3];
+	int acklen;
 	int i;
 	int count;
+	int len;
 	unsigned char ch;
 
 	do {
@@ -149,33 +251,66 @@ static int getpacket(char *buffer)
 		 * wait around for the start character,
 		 * ignore all other characters
 		 */
-		ch = 0;
-		while((ch & 0x7F) != '$')
+		while(1)
 		{
-			if(getDebugChar(&ch) <= 0)
+			if(!fill_rx())
 			{
 				return 0;
 			}
+
+			start = &g_rxbuf[g_rxpos];
+			end = memchr(start, '$', g_rxlen - g_rxpos);
+			if(end)
+			{
+				g_rxpos += (end - start) + 1;
+				break;
+			}
+
+			g_rxpos = g_rxlen;
 		}
 
 		checksum = 0;
 		xmitcsum = -1;
 		count = 0;
+		ch = 0;
 
 		/*
-		 * now, read until a # or end of buffer is found
+		 * now, read until a # or end of buffer is found, a block at a time
 		 */
 		while (count < MAX_BUF) {
-			if(getDebugChar(&ch) <= 0)
+			if(!fill_rx())
 			{
 				return 0;
 			}
 
-			if (ch == '#')
+			start = &g_rxbuf[g_rxpos];
+			len = g_rxlen - g_rxpos;
+			end = memchr(start, '#', len);
+			if(end)
+			{
+				len = end - start;
+			}
+
+			if((count + len) >= MAX_BUF)
+			{
+				len = MAX_BUF - count;
+			}
+
+			for(i = 0; i < len; i++)
+			{
+				checksum += start[i];
+			}
+			memcpy(&buffer[count], start, len);
+			count += len;
+			g_rxpos += len;
+
+			if((end) && (start + len == end))
+			{
+				/* Consume the # */
+				g_rxpos++;
+				ch = '#';
 				break;
-			checksum = checksum + ch;
-			buffer[count] = ch;
-			count = count + 1;
+			}
 		}
 
 		if (count >= MAX_BUF)
@@ -184,29 +319,34 @@ static int getpacket(char *buffer)
 		buffer[count] = 0;
 
 		if (ch == '#') {
-			if(getDebugChar(&ch) <= 0)
+			if(get_char(&ch) <= 0)
 			{
 				return 0;
 			}
 			xmitcsum = hex(ch & 0x7f) << 4;
-			if(getDebugChar(&ch) <= 0)
+			if(get_char(&ch) <= 0)
 			{
 				return 0;
 			}
 			xmitcsum |= hex(ch & 0x7f);
 
 			if (checksum != xmitcsum)
-				putDebugChar('-');	/* failed checksum */
+			{
+				/* No retransmits in no ack mode, drop it and wait for the next */
+				if(!g_noack)
+					putDebugChar('-');	/* failed checksum */
+			}
 			else {
-				putDebugChar('+'); /* successful transfer */
+				ack[0] = '+'; /* successful transfer */
+				acklen = 1;
 
 				/*
 				 * if a sequence char is present,
 				 * reply the sequence ID
 				 */
 				if (buffer[2] == ':') {
-					putDebugChar(buffer[0]);
-					putDebugChar(buffer[1]);
+					ack[acklen++] = buffer[0];
+					ack[acklen++] = buffer[1];
 
 					/*
 					 * remove sequence chars from buffer
@@ -215,6 +355,9 @@ static int getpacket(char *buffer)
 					for (i=3; i <= count; i++)
 						buffer[i-3] = buffer[i];
 				}
+
+				if(!g_noack)
+					writeDebugData(ack, acklen);
 			}
 		}
 	}
@@ -255,21 +398,20 @@ void GdbStubInit(void)
 {
 	/* Read out any pending data */
 	memset(g_stepbp, 0, 2 * sizeof(struct sw_breakpoint));
+	reset_rx();
+	g_noack = 0;
+	g_swbreak = 0;
 
 	initialised = 1;
 	attached = 1;
 }
 
-static char *mem2hex(unsigned char *mem, char *buf, int count)
+static char *mem2hex(const unsigned char *mem, char *buf, int count)
 {
 	unsigned char ch;
 
 	while (count-- > 0) {
-		if (GdbReadByte(mem++, &ch) == 0)
-		{
-			return NULL;
-		}
-
+		ch = *mem++;
 		*buf++ = hexchars[(ch >> 4) & 0xf];
 		*buf++ = hexchars[ch & 0xf];
 	}
@@ -279,7 +421,11 @@ static char *mem2hex(unsigned char *mem, char *buf, int count)
 	return buf;
 }
 
-static char *hex2mem(char *buf, char *mem, int count, int binary)
+/*
+ * Decode count bytes of hex or escaped binary data from buf into mem,
+ * returns the number of bytes decoded
+ */
+static int hex2mem(char *buf, unsigned char *mem, int count, int binary)
 {
 	int i;
 	unsigned char ch;
@@ -295,11 +441,47 @@ static char *hex2mem(char *buf, char *mem, int count, int binary)
 			ch = hex(*buf++) << 4;
 			ch |= hex(*buf++);
 		}
-		if (GdbWriteByte(ch, (unsigned char *) mem++) == 0)
-			return 0;
+		*mem++ = ch;
 	}
 
-	return mem;
+	return i;
+}
+
+/*
+ * Escape count bytes of mem into buf for a binary reply, stops when the
+ * output would exceed max bytes. Returns the number of bytes consumed.
+ */
+static int mem2bin(const unsigned char *mem, unsigned char *buf, int count, int max, int *outlen)
+{
+	int i;
+	int o = 0;
+	unsigned char ch;
+
+	for(i = 0; i < count; i++)
+	{
+		ch = mem[i];
+		if((ch == '#') || (ch == '$') || (ch == '}') || (ch == '*'))
+		{
+			if((o + 2) > max)
+			{
+				break;
+			}
+			buf[o++] = 0x7d;
+			buf[o++] = ch ^ 0x20;
+		}
+		else
+		{
+			if((o + 1) > max)
+			{
+				break;
+			}
+			buf[o++] = ch;
+		}
+	}
+
+	*outlen = o;
+
+	return i;
 }
 
 static int hexToInt(char **ptr, unsigned int *intValue)
@@ -559,6 +741,13 @@ void build_trap_cmd(int sigval, struct PsplinkContext *ctx)
 	sprintf(ptr, "thread:%08x;", ctx->thid);
 	ptr += strlen(ptr);
 
+	if((g_swbreak) && (ctx->regs.type != PSPLINK_EXTYPE_DEBUG) && (sigval == SIGTRAP) 
+			&& (debugFindBP(ctx->regs.epc) & DEBUG_BP_GDB))
+	{
+		strcpy(ptr, "swbreak:;");
+		ptr += strlen(ptr);
+	}
+
 	if((ctx->regs.type == PSPLINK_EXTYPE_DEBUG) && 
 			(g_context.daddr != 0) && (ctx->drcntl & (1 << 12)))
 	{
@@ -587,12 +776,274 @@ void build_trap_cmd(int sigval, struct PsplinkContext *ctx)
 	*ptr++ = 0;
 }
 
-static void handle_query(char *str)
+/* Thread list of the debugged application, grown as needed */
+static SceUID *g_threads = NULL;
+static int g_threadmax = 0;
+static int g_threadcount = 0;
+static int g_threadloc = 0;
+
+/* Cached qXfer:threads:read document, rebuilt on a read from offset 0 */
+static char *g_threadxml = NULL;
+static int g_threadxmllen = 0;
+static int g_threadxmlmax = 0;
+
+static int is_app_thread(SceKernelThreadInfo *info)
+{
+	return (((u32) info->entry >= g_context.info.text_addr) 
+		&& ((u32) info->entry < (g_context.info.text_addr + g_context.info.text_size)));
+}
+
+/* Fill in g_threads with the threads of our debugged application */
+static int get_threads(void)
 {
-	static SceUID threads[100];
-	static int thread_count = 0;
-	static int thread_loc = 0;
+	SceKernelThreadInfo info;
+	int count = 0;
+	int valid = 0;
+	int i;
+
+	g_threadcount = 0;
+	g_threadloc = 0;
+
+	while(1)
+	{
+		if(g_threadmax == 0)
+		{
+			g_threads = (SceUID *) malloc(64 * sizeof(SceUID));
+			if(g_threads == NULL)
+			{
+				return 0;
+			}
+			g_threadmax = 64;
+		}
+
+		if(sceKernelGetThreadmanIdList(SCE_KERNEL_TMID_Thread, g_threads, g_threadmax, &count) < 0)
+		{
+			return 0;
+		}
+
+		if(count <= g_threadmax)
+		{
+			break;
+		}
+		else
+		{
+			SceUID *temp;
+
+			/* Leave some room in case more threads turn up in the mean time */
+			temp = (SceUID *) realloc(g_threads, (count + 16) * sizeof(SceUID));
+			if(temp == NULL)
+			{
+				count = g_threadmax;
+				break;
+			}
+			g_threads = temp;
+			g_threadmax = count + 16;
+		}
+	}
+
+	for(i = 0; i < count; i++)
+	{
+		memset(&info, 0, sizeof(info));
+		info.size = sizeof(info);
+
+		if(sceKernelReferThreadStatus(g_threads[i], &info) == 0)
+		{
+			/* Check if this is a thread from our debugged application */
+			if(is_app_thread(&info))
+			{
+				g_threads[valid++] = g_threads[i];
+			}
+		}
+	}
+
+	g_threadcount = valid;
+
+	return valid;
+}
 
+static int xml_append(const char *str)
+{
+	int len;
+
+	len = strlen(str);
+	if((g_threadxmllen + len + 1) > g_threadxmlmax)
+	{
+		char *temp;
+		int newmax;
+
+		newmax = g_threadxmlmax ? g_threadxmlmax * 2 : 1024;
+		while(newmax < (g_threadxmllen + len + 1))
+		{
+			newmax *= 2;
+		}
+
+		temp = (char *) realloc(g_threadxml, newmax);
+		if(temp == NULL)
+		{
+			return 0;
+		}
+		g_threadxml = temp;
+		g_threadxmlmax = newmax;
+	}
+
+	memcpy(&g_threadxml[g_threadxmllen], str, len + 1);
+	g_threadxmllen += len;
+
+	return 1;
+}
+
+/* Append a string with the XML special characters escaped */
+static int xml_append_escaped(const char *str)
+{
+	char temp[2];
+
+	temp[1] = 0;
+	while(*str)
+	{
+		const char *esc;
+
+		switch(*str)
+		{
+			case '<': esc = "&lt;";
+					  break;
+			case '>': esc = "&gt;";
+					  break;
+			case '&': esc = "&amp;";
+					  break;
+			case '"': esc = "&quot;";
+					  break;
+			default:  temp[0] = *str;
+					  esc = temp;
+					  break;
+		};
+
+		if(!xml_append(esc))
+		{
+			return 0;
+		}
+		str++;
+	}
+
+	return 1;
+}
+
+static int build_thread_xml(void)
+{
+	SceKernelThreadInfo info;
+	char temp[64];
+	int i;
+
+	g_threadxmllen = 0;
+	get_threads();
+
+	if(!xml_append("<?xml version=\"1.0\"?>\n<threads>\n"))
+	{
+		return 0;
+	}
+
+	for(i = 0; i < g_threadcount; i++)
+	{
+		memset(&info, 0, sizeof(info));
+		info.size = sizeof(info);
+
+		sprintf(temp, "<thread id=\"%x\"", g_threads[i]);
+		if(!xml_append(temp))
+		{
+			return 0;
+		}
+
+		if(sceKernelReferThreadStatus(g_threads[i], &info) == 0)
+		{
+			if((!xml_append(" name=\"")) || (!xml_append_escaped(info.name)) || (!xml_append("\"")))
+			{
+				return 0;
+			}
+		}
+
+		if(!xml_append("/>\n"))
+		{
+			return 0;
+		}
+	}
+
+	return xml_append("</threads>\n");
+}
+
+/*
+ * Handle qXfer:threads:read::offset,length, the reply is sent directly
+ */
+static void handle_xfer_threads(char *str)
+{
+	unsigned int offset;
+	unsigned int length;
+	int count;
+	int outlen;
+
+	if(!(hexToInt(&str, &offset) && *str++ == ',' && hexToInt(&str, &length)))
+	{
+		putpacket((unsigned char *) "E01");
+		return;
+	}
+
+	if((offset == 0) || (g_threadxml == NULL))
+	{
+		if(!build_thread_xml())
+		{
+			putpacket((unsigned char *) "E03");
+			return;
+		}
+	}
+
+	if(offset >= g_threadxmllen)
+	{
+		putpacket((unsigned char *) "l");
+		return;
+	}
+
+	if(length > (packet_size() - 1))
+	{
+		length = packet_size() - 1;
+	}
+
+	count = mem2bin((unsigned char *) &g_threadxml[offset], (unsigned char *) &output[1], 
+			g_threadxmllen - offset, length, &outlen);
+	output[0] = ((offset + count) < g_threadxmllen) ? 'm' : 'l';
+	putpacket_len((unsigned char *) output, outlen + 1);
+}
+
+/*
+ * Put as many threads from the list as will fit into the reply
+ */
+static void list_threads(void)
+{
+	char *ptr;
+	int max;
+
+	if(g_threadloc >= g_threadcount)
+	{
+		strcpy(output, "l");
+		return;
+	}
+
+	max = packet_size() - 16;
+	ptr = output;
+	*ptr++ = 'm';
+	while((g_threadloc < g_threadcount) && ((ptr - output) < max))
+	{
+		if(ptr != &output[1])
+		{
+			*ptr++ = ',';
+		}
+		sprintf(ptr, "%08X", g_threads[g_threadloc]);
+		ptr += strlen(ptr);
+		g_threadloc++;
+	}
+	*ptr = 0;
+}
+
+/* Returns 1 if the reply has already been sent */
+static int handle_query(char *str)
+{
 	switch(str[0])
 	{
 		case 'C': sprintf(output, "QC%08X", g_context.ctx.thid);
@@ -600,56 +1051,23 @@ static void handle_query(char *str)
 		case 'f': 
 				if(strncmp(str, "fThreadInfo", strlen("fThreadInfo")) == 0)
 				{
-					SceUID thread_temp[100];
-					thread_count = sceKernelGetThreadmanIdList(SCE_KERNEL_TMID_Thread, thread_temp, 100, &thread_count);
-					if(thread_count > 0)
-					{
-						SceKernelThreadInfo info;
-						int valid = 0;
-						int i;
-
-						for(i = 0; i < thread_count; i++)
-						{
-							memset(&info, 0, sizeof(info));
-							info.size = sizeof(info);
-
-							if(sceKernelReferThreadStatus(thread_temp[i], &info) == 0)
-							{
-								/* Check if this is a thread from our debugged application */
-								if(((u32) info.entry >= g_context.info.text_addr) 
-									&& ((u32) info.entry < (g_context.info.text_addr + g_context.info.text_size)))
-								{
-									threads[valid++] = thread_temp[i];
-								}
-							}
-						}
-
-						thread_count = valid;
-
-						if(thread_count > 0)
-						{
-							thread_loc = 0;
-							sprintf(output, "m%08X", threads[thread_loc]);
-							thread_loc++;
-						}
-					}
+					get_threads();
+					list_threads();
 				}
 				break;
 
 		case 's':
 				if(strncmp(str, "sThreadInfo", strlen("sThreadInfo")) == 0)
 				{
-					if(thread_loc < thread_count)
-					{
-						sprintf(output, "m%08X", threads[thread_loc]);
-						thread_loc++;
-					}
-					else
-					{
-						strcpy(output, "l");
-					}
+					list_threads();
 				}
 				break;
+		case 'X': if(strncmp(str, "Xfer:threads:read::", strlen("Xfer:threads:read::")) == 0)
+				  {
+					  handle_xfer_threads(str + strlen("Xfer:threads:read::"));
+					  return 1;
+				  }
+				  break;
 		case 'T': if(strncmp(str, "ThreadExtraInfo,", strlen("ThreadExtraInfo,")) == 0)
 				  {
 					SceKernelThreadInfo info;
@@ -676,6 +1094,12 @@ static void handle_query(char *str)
 					}
 				  }
 				  break;
+		case 'S': if(strncmp(str, "Supported", strlen("Supported")) == 0)
+				  {
+					  g_swbreak = (strstr(str, "swbreak+") != NULL);
+					  sprintf(output, "PacketSize=%x;binary-upload+;QStartNoAckMode+;swbreak+;qXfer:threads:read+", packet_size());
+				  }
+				  break;
 		case 'P':
 				break;
 		case 'O': if(strncmp(str, "Offsets", strlen("Offsets")) == 0)
@@ -702,9 +1126,11 @@ static void handle_query(char *str)
 				  }
 				  break;
 	};
+
+	return 0;
 }
 
-void handle_hwbp(char *str, int set)
+void handle_bp(char *str, int set)
 {
 	char *ptr;
 	unsigned int addr;
@@ -712,7 +1138,7 @@ void handle_hwbp(char *str, int set)
 	struct DebugEnv env;
 	int datatype = 0;
 
-	if(g_context.hw == 0)
+	if((g_context.hw == 0) && (str[0] != '0'))
 	{
 		/* We dont have the hardware debugger on our side */
 		return;
@@ -732,7 +1158,30 @@ void handle_hwbp(char *str, int set)
 		DEBUG_PRINTF("%c%c: addr 0x%08X, len 0x%08X\n", set ? 'Z' : 'z', str[0], addr, len);
 		switch(str[0])
 		{
-			case '0': break;  /* We dont support inbuilt software breaks */
+			case '0': /* Software breaks go into psplink's breakpoint table */
+					  if(set)
+					  {
+						  if(debugSetBP(addr, DEBUG_BP_GDB, 0))
+						  {
+							  strcpy(output, "OK");
+						  }
+						  else
+						  {
+							  strcpy(output, "E03");
+						  }
+					  }
+					  else
+					  {
+						  if(debugClearBP(addr))
+						  {
+							  strcpy(output, "OK");
+						  }
+						  else
+						  {
+							  strcpy(output, "E03");
+						  }
+					  }
+					  break;
 			case '1': if(set)
 					  {
 						  if(g_context.iaddr == 0)
@@ -771,15 +1220,11 @@ void handle_hwbp(char *str, int set)
 			case '4': datatype++;
 			case '2': datatype++;
 			case '3': datatype++;
+					  /* The watch manager owns the data break registers */
 					  if(set)
 					  {
-						  if(g_context.daddr == 0)
+						  if((g_context.daddr == 0) && (watchSet(addr, len, datatype, WATCH_GDB, 0) >= 0))
 						  {
-							  debugGetEnv(&env);
-							  env.DBA = addr;
-							  env.DBAM = 0;
-							  env.DBC = (datatype << 20) | 2;
-							  debugSetEnv(&env);
 							  g_context.daddr = addr;
 							  g_context.datatype = datatype;
 							  strcpy(output, "OK");
@@ -791,13 +1236,8 @@ void handle_hwbp(char *str, int set)
 					  }
 					  else
 					  {
-						  if(g_context.daddr != 0)
+						  if((g_context.daddr != 0) && (watchClear(addr, datatype)))
 						  {
-							  debugGetEnv(&env);
-							  env.DBA = 0;
-							  env.DBAM = 0;
-							  env.DBC = 0;
-							  debugSetEnv(&env);
 							  g_context.daddr = 0;
 							  g_context.datatype = 0;
 							  strcpy(output, "OK");
@@ -818,6 +1258,55 @@ void handle_hwbp(char *str, int set)
 	}
 }
 
+/* Register layout of the g/G packets, as groups of words in the context */
+static const struct
+{
+	unsigned int offset;
+	unsigned int count;
+} g_reggroups[] = {
+	{ offsetof(struct PsplinkContext, regs.r[0]), 32 },	 /* r0...r31 */
+	{ offsetof(struct PsplinkContext, regs.status), 6 },	 /* cp0 */
+	{ offsetof(struct PsplinkContext, regs.fpr[0]), 32 },	 /* f0...31 */
+	{ offsetof(struct PsplinkContext, regs.fsr), 2 },		 /* cp1 */
+	{ offsetof(struct PsplinkContext, regs.frame_ptr), 2 }, /* frp */
+	{ offsetof(struct PsplinkContext, regs.index), 16 },	 /* cp0 */
+};
+
+#define REG_GROUP_COUNT (sizeof(g_reggroups) / sizeof(g_reggroups[0]))
+#define REG_TOTAL_COUNT (32 + 6 + 32 + 2 + 2 + 16)
+
+/* Start the module if we haven't yet, otherwise continue at an optional address */
+static void resume_target(struct PsplinkContext *ctx, char *ptr)
+{
+	unsigned int addr;
+
+	if(!g_context.started)
+	{
+		int arglen = 0;
+		int status;
+		int i;
+
+		for(i = 0; i < g_context.argc; i++)
+		{
+			arglen += strlen(g_context.argv[i]) + 1;
+		}
+
+		/* Ensure any pending memory is flushed before we start the module */
+		sceKernelDcacheWritebackInvalidateAll();
+		sceKernelIcacheInvalidateAll();
+		sceKernelStartModule(g_context.uid, arglen, g_context.argv[0], &status, NULL);
+
+		g_context.started = 1;
+	}
+	else
+	{
+		if (hexToInt(&ptr, &addr))
+		{
+			ctx->regs.epc = addr;
+		}
+	}
+}
+
 int GdbHandleException (struct PsplinkContext *ctx)
 {
 	int ret = 1;
@@ -827,6 +1316,7 @@ int GdbHandleException (struct PsplinkContext *ctx)
 	unsigned int length;
 	char *ptr;
 	int bflag = 0;
+	int i;
 
 	DEBUG_PRINTF("In GDB Handle Exception\n");
 
@@ -868,6 +1358,8 @@ int GdbHandleException (struct PsplinkContext *ctx)
 	{
 		if(!getpacket(input))
 		{
+			g_noack = 0;
+			g_swbreak = 0;
 			ret = 0;
 			goto restart;
 		}
@@ -891,64 +1383,39 @@ int GdbHandleException (struct PsplinkContext *ctx)
 
 		case 'c':
 			ptr = &input[1];
-			if(!g_context.started)
-			{
-				int arglen = 0;
-				int status;
-				int i;
-
-				for(i = 0; i < g_context.argc; i++)
-				{
-					arglen += strlen(g_context.argv[i]) + 1;
-				}
-
-				/* Ensure any pending memory is flushed before we start the module */
-				sceKernelDcacheWritebackInvalidateAll();
-				sceKernelIcacheInvalidateAll();
-				sceKernelStartModule(g_context.uid, arglen, g_context.argv[0], &status, NULL);
-
-				g_context.started = 1;
-			}
-			else
-			{
-				if (hexToInt(&ptr, &addr))
-				{
-					ctx->regs.epc = addr;
-				}
-			}
-	  
+			resume_target(ctx, ptr);
 			goto restart;
 			break;
 
 		case 'D':
 			putpacket((unsigned char *) output);
 			attached = 0;
+			g_noack = 0;
+			g_swbreak = 0;
 			goto restart;
 			break;
 
 		case 'g':
 			ptr = output;
-			ptr = (char*) mem2hex((unsigned char *)&ctx->regs.r[0], ptr, 32*sizeof(u32)); /* r0...r31 */
-			ptr = (char*) mem2hex((unsigned char *)&ctx->regs.status, ptr, 6*sizeof(u32)); /* cp0 */
-			ptr = (char*) mem2hex((unsigned char *)&ctx->regs.fpr[0], ptr, 32*sizeof(u32)); /* f0...31 */
-			ptr = (char*) mem2hex((unsigned char *)&ctx->regs.fsr, ptr, 2*sizeof(u32)); /* cp1 */
-			ptr = (char*) mem2hex((unsigned char *)&ctx->regs.frame_ptr, ptr, 2*sizeof(u32)); /* frp */
-			ptr = (char*) mem2hex((unsigned char *)&ctx->regs.index, ptr, 16*sizeof(u32)); /* cp0 */
+			for(i = 0; i < REG_GROUP_COUNT; i++)
+			{
+				ptr = mem2hex((unsigned char *) ctx + g_reggroups[i].offset, ptr, g_reggroups[i].count*sizeof(u32));
+			}
 			break;
 
 		case 'G':
 			ptr = &input[1];
-			hex2mem(ptr, (char *)&ctx->regs.r[0], 32*sizeof(unsigned int), 0);
-			ptr += 32*(2*sizeof(unsigned int));
-			hex2mem(ptr, (char *)&ctx->regs.status, 6*sizeof(unsigned int), 0);
-			ptr += 6*(2*sizeof(unsigned int));
-			hex2mem(ptr, (char *)&ctx->regs.fpr[0], 32*sizeof(unsigned int), 0);
-			ptr += 32*(2*sizeof(unsigned int));
-			hex2mem(ptr, (char *)&ctx->regs.fsr, 2*sizeof(unsigned int), 0);
-			ptr += 2*(2*sizeof(unsigned int));
-			hex2mem(ptr, (char *)&ctx->regs.frame_ptr, 2*sizeof(unsigned int), 0);
-			ptr += 2*(2*sizeof(unsigned int));
-			hex2mem(ptr, (char *)&ctx->regs.index, 16*sizeof(unsigned int), 0);
+			if(strlen(ptr) < (REG_TOTAL_COUNT*2*sizeof(u32)))
+			{
+				strcpy(output, "E01");
+				break;
+			}
+
+			for(i = 0; i < REG_GROUP_COUNT; i++)
+			{
+				hex2mem(ptr, (unsigned char *) ctx + g_reggroups[i].offset, g_reggroups[i].count*sizeof(u32), 0);
+				ptr += g_reggroups[i].count*(2*sizeof(u32));
+			}
 			strcpy(output,"OK");
 			break;
 
@@ -961,8 +1428,55 @@ int GdbHandleException (struct PsplinkContext *ctx)
 			if (hexToInt(&ptr, &addr)
 				&& *ptr++ == ','
 				&& hexToInt(&ptr, &length)) {
-				if (mem2hex((unsigned char *)addr, output, length))
+				int count;
+
+				if(length > ((packet_size() - 1) / 2))
+				{
+					length = (packet_size() - 1) / 2;
+				}
+
+				count = GdbReadMemory(addr, g_membuf, length);
+				if (count > 0)
+				{
+					mem2hex(g_membuf, output, count);
+					break;
+				}
+				strcpy (output, "E03");
+			} else
+				strcpy(output,"E01");
+			break;
+
+		/*
+		 * xAA..AA,LLLL  Read LLLL bytes at address AA..AA as escaped binary
+		 */
+		case 'x':
+			ptr = &input[1];
+
+			if (hexToInt(&ptr, &addr)
+				&& *ptr++ == ','
+				&& hexToInt(&ptr, &length)) {
+				int count;
+				int outlen;
+
+				if(length > sizeof(g_membuf))
+				{
+					length = sizeof(g_membuf);
+				}
+
+				if(length == 0)
+				{
+					strcpy(output, "b");
 					break;
+				}
+
+				count = GdbReadMemory(addr, g_membuf, length);
+				if (count > 0)
+				{
+					output[0] = 'b';
+					mem2bin(g_membuf, (unsigned char *) &output[1], count, packet_size() - 1, &outlen);
+					putpacket_len((unsigned char *) output, outlen + 1);
+					continue;
+				}
 				strcpy (output, "E03");
 			} else
 				strcpy(output,"E01");
@@ -985,10 +1499,18 @@ int GdbHandleException (struct PsplinkContext *ctx)
 				&& *ptr++ == ','
 				&& hexToInt(&ptr, &length)
 				&& *ptr++ == ':') {
-				if (hex2mem(ptr, (char *)addr, length, bflag))
-					strcpy(output, "OK");
+				if(length > sizeof(g_membuf))
+				{
+					strcpy(output, "E02");
+				}
 				else
-					strcpy(output, "E03");
+				{
+					hex2mem(ptr, g_membuf, length, bflag);
+					if ((length == 0) || (GdbWriteMemory(g_membuf, addr, length) == length))
+						strcpy(output, "OK");
+					else
+						strcpy(output, "E03");
+				}
 			}
 			else
 				strcpy(output, "E02");
@@ -1005,13 +1527,46 @@ int GdbHandleException (struct PsplinkContext *ctx)
 					goto restart;
 					break;
 
-		case 'q': handle_query(&input[1]);
+		case 'q': if(handle_query(&input[1]))
+				  {
+					  continue;
+				  }
+				  break;
+
+		case 'Q': if(strcmp(&input[1], "StartNoAckMode") == 0)
+				  {
+					  /* The OK is still acknowledged, switch after it is sent */
+					  putpacket((unsigned char *) "OK");
+					  g_noack = 1;
+					  continue;
+				  }
+				  break;
+
+		case 'v': if(strcmp(&input[1], "Cont?") == 0)
+				  {
+					  strcpy(output, "vCont;c;C;s;S");
+				  }
+				  else if(strncmp(&input[1], "Cont;", 5) == 0)
+				  {
+					  /* Only the stopped thread can be resumed, so use the first action */
+					  switch(input[6])
+					  {
+						  case 'c':
+						  case 'C': resume_target(ctx, "");
+									goto restart;
+						  case 's':
+						  case 'S': step_generic(ctx, 0);
+									goto restart;
+						  default:  strcpy(output, "E01");
+									break;
+					  };
+				  }
 				  break;
 
-		case 'Z': handle_hwbp(&input[1], 1);
+		case 'Z': handle_bp(&input[1], 1);
 				  break;
 
-		case 'z': handle_hwbp(&input[1], 0);
+		case 'z': handle_bp(&input[1], 0);
 				  break;
 
 		/*
@@ -0,0 +1,168 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * host.c - Kernel and util.c functions used by memsearch.c, for the PC
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pspkernel.h>
+#include "util.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#define MAX_BLOCKS 16
+
+static void *g_blocks[MAX_BLOCKS];
+
+SceUID sceKernelAllocPartitionMemory(SceUID partitionid, const char *name, int type, SceSize size, void *addr)
+{
+	int i;
+
+	for(i = 0; i < MAX_BLOCKS; i++)
+	{
+		if(g_blocks[i] == NULL)
+		{
+			g_blocks[i] = malloc(size);
+			if(g_blocks[i] == NULL)
+			{
+				return -1;
+			}
+
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+int sceKernelFreePartitionMemory(SceUID blockid)
+{
+	if((blockid < 0) || (blockid >= MAX_BLOCKS) || (g_blocks[blockid] == NULL))
+	{
+		return -1;
+	}
+
+	free(g_blocks[blockid]);
+	g_blocks[blockid] = NULL;
+
+	return 0;
+}
+
+void *sceKernelGetBlockHeadAddr(SceUID blockid)
+{
+	if((blockid < 0) || (blockid >= MAX_BLOCKS))
+	{
+		return NULL;
+	}
+
+	return g_blocks[blockid];
+}
+
+int openfile(const char *filename, PspFile *pFile)
+{
+	memset(pFile, 0, sizeof(PspFile));
+
+	pFile->fd = open(filename, O_RDONLY | O_BINARY);
+	if(pFile->fd < 0)
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+int closefile(PspFile *pFile)
+{
+	if(pFile->fd < 0)
+	{
+		return 0;
+	}
+
+	close(pFile->fd);
+
+	return 1;
+}
+
+int fdgetc(PspFile *pFile)
+{
+	if(pFile->read_pos >= pFile->read_size)
+	{
+		pFile->read_size = read(pFile->fd, pFile->read_buf, MAX_BUFFER);
+		pFile->read_pos = 0;
+		if(pFile->read_size <= 0)
+		{
+			pFile->read_size = 0;
+			return -1;
+		}
+	}
+
+	return (unsigned char) pFile->read_buf[pFile->read_pos++];
+}
+
+int fdgets(PspFile *pFile, char *buf, int max)
+{
+	int pos = 0;
+
+	while(pos < (max-1))
+	{
+		int ch;
+
+		ch = fdgetc(pFile);
+		if(ch == -1)
+		{
+			break;
+		}
+
+		buf[pos++] = (char) ch;
+		if(ch == '\n')
+		{
+			break;
+		}
+	}
+
+	buf[pos] = 0;
+
+	return pos;
+}
+
+int is_hex(char ch)
+{
+	return ((ch >= '0') && (ch <= '9')) || ((ch >= 'A') && (ch <= 'F')) || ((ch >= 'a') && (ch <= 'f'));
+}
+
+int hex_to_int(char ch)
+{
+	if((ch >= '0') && (ch <= '9'))
+	{
+		return ch - '0';
+	}
+
+	if((ch >= 'A') && (ch <= 'F'))
+	{
+		return ch - 'A' + 10;
+	}
+
+	if((ch >= 'a') && (ch <= 'f'))
+	{
+		return ch - 'a' + 10;
+	}
+
+	return 0;
+}
+
+int is_aspace(int ch)
+{
+	return (ch == ' ') || (ch == '\t') || (ch == '\n') || (ch == '\r');
+}
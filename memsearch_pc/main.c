@@ -0,0 +1,330 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * main.c - Host side benchmark of the memory search functions
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <pspkernel.h>
+#include "memsearch.h"
+
+/* The size of user memory */
+#define BENCH_SIZE     (24*1024*1024)
+/* The find commands print this many matches at a time */
+#define BENCH_MATCHES  256
+#define BENCH_SIGS     100
+#define BENCH_SIGLEN   12
+#define BENCH_SIGFILE  "memsearch-bench.sig"
+
+struct FindBench
+{
+	const char *name;
+	const char *pattern;
+	const char *mask;
+	int len;
+	int align;
+};
+
+static const struct FindBench g_finds[] =
+{
+	{ "findstr 12 bytes", "sceKernelSem", NULL, 12, 1 },
+	{ "findstr 4 bytes", "abcd", NULL, 4, 1 },
+	{ "findhex masked 8 bytes", "\x00\x00\x02\x3c\x08\x00\xe0\x03", "\x00\x00\xff\xff\xff\xff\xff\xff", 8, 1 },
+	{ "findw 2 words", "\x08\x00\xe0\x03\x00\x00\x00\x00", NULL, 8, 4 },
+	{ "findh", "\x34\x12", NULL, 2, 2 },
+	{ NULL, NULL, NULL, 0, 0 }
+};
+
+/* memsearch.c works on u32 addresses like it does on the PSP, so the buffer is
+ * static and the program is linked so it lands in the low 4GiB */
+static unsigned char g_data[BENCH_SIZE];
+
+/* The search the find commands used before memsearch.c, from util.c */
+static int old_memcmp_mask(const unsigned char *data, const unsigned char *search, const unsigned char *mask, int len)
+{
+	int i;
+
+	if(mask == NULL)
+	{
+		return memcmp(data, search, len);
+	}
+
+	for(i = 0; i < len; i++)
+	{
+		if((data[i] & mask[i]) != search[i])
+		{
+			return (data[i] & mask[i]) - search[i];
+		}
+	}
+
+	return 0;
+}
+
+static const unsigned char *old_memmem_mask(const unsigned char *data, const unsigned char *mask, int len,
+		const unsigned char *search, int slen)
+{
+	int i;
+
+	for(i = 0; i < (len - slen + 1); i++)
+	{
+		if(old_memcmp_mask(data, search, mask, slen) == 0)
+		{
+			return data;
+		}
+		data++;
+	}
+
+	return NULL;
+}
+
+static double get_time(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (tv.tv_sec * 1000.0) + (tv.tv_usec / 1000.0);
+}
+
+/* Random bytes with every fourth one taken from a few values, which is about as
+ * repetitive as MIPS code */
+static void fill_data(unsigned int seed)
+{
+	int i;
+
+	srand(seed);
+	for(i = 0; i < BENCH_SIZE; i++)
+	{
+		if((i & 3) == 3)
+		{
+			g_data[i] = 0x24 + ((i >> 2) % 7);
+		}
+		else
+		{
+			g_data[i] = rand();
+		}
+	}
+}
+
+static void bench_find(const struct FindBench *find)
+{
+	struct MemSearch search;
+	u32 results[BENCH_MATCHES];
+	const unsigned char *data = g_data;
+	const unsigned char *p;
+	int left = BENCH_SIZE;
+	int oldcount = 0;
+	int count;
+	u32 next;
+	double start;
+	double newtime;
+	double oldtime;
+
+	memSearchInit(&search, find->pattern, find->mask, find->len, find->align);
+
+	start = get_time();
+	count = memSearch(&search, (u32) (uintptr_t) g_data, BENCH_SIZE, results, BENCH_MATCHES, &next);
+	newtime = get_time() - start;
+
+	start = get_time();
+	while((oldcount < BENCH_MATCHES) && (left > 0))
+	{
+		p = old_memmem_mask(data, (const unsigned char *) find->mask, left, (const unsigned char *) find->pattern, find->len);
+		if(p == NULL)
+		{
+			break;
+		}
+
+		if(((p - g_data) % find->align) == 0)
+		{
+			oldcount++;
+		}
+		p++;
+		left -= p - data;
+		data = p;
+	}
+	oldtime = get_time() - start;
+
+	printf("%-24s new %8.2fms old %8.2fms (%d matches", find->name, newtime, oldtime, count);
+	if(count != oldcount)
+	{
+		printf(", old found %d", oldcount);
+	}
+	printf(")\n");
+}
+
+/* Take the signatures from the data with every fourth byte as a wildcard so most of
+ * them match once, and scan for them in one pass and with one search each */
+static int bench_sigs(const char *file, int nsigs)
+{
+	struct MemSearch *searches;
+	struct MemSigSet *set;
+	struct MemSigMatch *matches;
+	u32 results[BENCH_MATCHES];
+	u32 addr;
+	u32 end;
+	u32 next;
+	int sigcount = 0;
+	int count = 0;
+	double start;
+	double sigtime;
+	double findtime;
+	FILE *fp;
+	int i;
+	int j;
+
+	searches = malloc(nsigs * sizeof(struct MemSearch));
+	matches = malloc(BENCH_MATCHES * sizeof(struct MemSigMatch));
+	fp = fopen(file, "w");
+	if((searches == NULL) || (matches == NULL) || (fp == NULL))
+	{
+		fprintf(stderr, "Error could not set up the signature benchmark\n");
+		free(searches);
+		free(matches);
+		if(fp)
+		{
+			fclose(fp);
+		}
+		return 0;
+	}
+
+	for(i = 0; i < nsigs; i++)
+	{
+		unsigned char pattern[BENCH_SIGLEN];
+		unsigned char mask[BENCH_SIGLEN];
+		const unsigned char *p;
+
+		p = &g_data[rand() % (BENCH_SIZE - BENCH_SIGLEN)];
+		fprintf(fp, "sig%d ", i);
+		for(j = 0; j < BENCH_SIGLEN; j++)
+		{
+			if((j % 4) == 1)
+			{
+				pattern[j] = 0;
+				mask[j] = 0;
+				fprintf(fp, "??");
+			}
+			else
+			{
+				pattern[j] = p[j];
+				mask[j] = 0xFF;
+				fprintf(fp, "%02X", p[j]);
+			}
+		}
+		fprintf(fp, "\n");
+		memSearchInit(&searches[i], pattern, mask, BENCH_SIGLEN, 1);
+	}
+	fclose(fp);
+
+	set = memSigLoad(file);
+	remove(file);
+	if(set == NULL)
+	{
+		free(searches);
+		free(matches);
+		return 0;
+	}
+
+	addr = (u32) (uintptr_t) g_data;
+	end = addr + BENCH_SIZE;
+
+	start = get_time();
+	while(addr < end)
+	{
+		sigcount += memSigScan(set, addr, end - addr, matches, BENCH_MATCHES, &next);
+		addr = next;
+	}
+	sigtime = get_time() - start;
+
+	start = get_time();
+	for(i = 0; i < nsigs; i++)
+	{
+		addr = (u32) (uintptr_t) g_data;
+		while(addr < end)
+		{
+			count += memSearch(&searches[i], addr, end - addr, results, BENCH_MATCHES, &next);
+			addr = next;
+		}
+	}
+	findtime = get_time() - start;
+
+	printf("%-24s one pass %8.2fms, one findhex each %8.2fms (%d matches", "sigscan", sigtime, findtime, sigcount);
+	if(sigcount != count)
+	{
+		printf(", findhex found %d", count);
+	}
+	printf(")\n");
+
+	memSigFree(set);
+	free(searches);
+	free(matches);
+
+	return 1;
+}
+
+static void print_help(void)
+{
+	fprintf(stderr, "Usage: memsearch-bench [options]\n");
+	fprintf(stderr, "Time the find and sigscan searches over 24MiB against the old byte at a time search\n\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "-n count : Number of signatures for sigscan (default %d)\n", BENCH_SIGS);
+	fprintf(stderr, "-s file  : Temporary signature file (default %s)\n", BENCH_SIGFILE);
+	fprintf(stderr, "-r seed  : Seed for the test data (default 1)\n");
+	fprintf(stderr, "-h       : Print this help\n");
+}
+
+int main(int argc, char **argv)
+{
+	const char *sigfile = BENCH_SIGFILE;
+	unsigned int seed = 1;
+	int nsigs = BENCH_SIGS;
+	int ch;
+	int i;
+
+	while((ch = getopt(argc, argv, "n:s:r:h")) != -1)
+	{
+		switch(ch)
+		{
+			case 'n': nsigs = atoi(optarg);
+					  break;
+			case 's': sigfile = optarg;
+					  break;
+			case 'r': seed = strtoul(optarg, NULL, 0);
+					  break;
+			default: print_help();
+					 return 1;
+		};
+	}
+
+	if(nsigs <= 0)
+	{
+		fprintf(stderr, "Error invalid number of signatures\n");
+		return 1;
+	}
+
+	if(((uintptr_t) g_data + BENCH_SIZE) > 0xFFFFFFFF)
+	{
+		fprintf(stderr, "Error the data buffer is not in the low 4GiB, link with -no-pie\n");
+		return 1;
+	}
+
+	fill_data(seed);
+
+	for(i = 0; g_finds[i].name; i++)
+	{
+		bench_find(&g_finds[i]);
+	}
+
+	return bench_sigs(sigfile, nsigs) ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * pspkernel.h - Just enough of the PSPSDK headers to build memsearch.c
+ * on the PC
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+
+#ifndef __PSPKERNEL_H__
+#define __PSPKERNEL_H__
+
+#include <stdint.h>
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef int      SceUID;
+typedef unsigned int SceSize;
+
+/* Only used by pointer in util.h */
+typedef struct SceKernelModuleInfo SceKernelModuleInfo;
+
+enum PspSysMemBlockTypes
+{
+	PSP_SMEM_Low = 0,
+	PSP_SMEM_High,
+	PSP_SMEM_Addr
+};
+
+SceUID sceKernelAllocPartitionMemory(SceUID partitionid, const char *name, int type, SceSize size, void *addr);
+int sceKernelFreePartitionMemory(SceUID blockid);
+void *sceKernelGetBlockHeadAddr(SceUID blockid);
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * pspsysmem_kernel.h - Stands in for the PSPSDK header on the PC, the
+ * partition memory calls are declared in pspkernel.h
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+
+#ifndef __PSPSYSMEM_KERNEL_H__
+#define __PSPSYSMEM_KERNEL_H__
+
+#include <pspkernel.h>
+
+#endif
@@ -55,12 +55,17 @@ int putDebugChar(unsigned char ch)
 	return -1;
 }
 
-int getDebugChar(unsigned char *ch)
+int maxPacketSize(void)
+{
+	/* TCP does our flow control */
+	return 0;
+}
+
+int readDebugData(void *data, int len)
 {
-	*ch = 0;
 	if(g_sock >= 0)
 	{
-		return sceNetInetRecv(g_sock, ch, 1, 0);
+		return sceNetInetRecv(g_sock, data, len, 0);
 	}
 
 	return -1;
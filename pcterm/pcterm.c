@@ -13,6 +13,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <fcntl.h>
@@ -40,12 +41,21 @@
 #define DEFAULT_SERIAL "/dev/ttyS0"
 #define DEFAULT_IP     "localhost"
 
+/* The psplink memory read channel, port offset and protocol as in usbhostfs.h */
+#define MEMORY_CHANNEL  7
+#define MEMREAD_MAGIC   0x782F0815
+#define MEMREAD_MAXSIZE (64*1024)
+#define MEMREAD_HEADER  12
+#define MEMREAD_TIMEOUT 5
+#define MEMDUMP_SIZE    256
+
 struct Args
 {
 	const char *ip;
 	const char *hist;
 	const char *log;
 	unsigned short port;
+	unsigned short memport;
 	unsigned int baud;
 	unsigned int realbaud;
 	int serialmode;
@@ -68,6 +78,7 @@ struct GlobalContext
 	fd_set readsave;
 	fd_set writesave;
 	int sock;
+	int memsock;
 	int log;
 	enum State state;
 	int promptwait;
@@ -76,6 +87,8 @@ struct GlobalContext
 
 struct GlobalContext g_context;
 
+void mem_command(char *line);
+
 int fixed_write(int s, const void *buf, int len)
 {
 	int written = 0;
@@ -150,6 +163,11 @@ void cli_handler(char *buf)
 			rl_callback_handler_install("", cli_handler);
 			return;
 		}
+		else if(rl_line_buffer[0] == '%')
+		{
+			mem_command(&rl_line_buffer[1]);
+			return;
+		}
 		else if(rl_line_buffer[0] == '!')
 		{
 			if(strncmp(&rl_line_buffer[1], "cd ", 3) == 0)
@@ -282,9 +300,9 @@ int parse_args(int argc, char **argv, struct Args *args)
 		int error = 0;
 
 #ifdef SERIAL_SUPPORT
-		ch = getopt(argc, argv, "sp:h:r:b:l:");
+		ch = getopt(argc, argv, "sp:m:h:r:b:l:");
 #else
-		ch = getopt(argc, argv, "p:h:r:");
+		ch = getopt(argc, argv, "p:m:h:r:");
 #endif
 		if(ch < 0)
 		{
@@ -295,6 +313,8 @@ int parse_args(int argc, char **argv, struct Args *args)
 		{
 			case 'p': args->port = atoi(optarg);
 					  break;
+			case 'm': args->memport = atoi(optarg);
+					  break;
 			case 'h': args->hist = optarg;
 					  break;
 			case 'r': args->retries = atoi(optarg);
@@ -325,6 +345,11 @@ int parse_args(int argc, char **argv, struct Args *args)
 	argc -= optind;
 	argv += optind;
 
+	if(args->memport == 0)
+	{
+		args->memport = args->port + MEMORY_CHANNEL;
+	}
+
 	if(argc < 1)
 	{
 		if(args->serialmode)
@@ -350,6 +375,7 @@ void print_help(void)
 	fprintf(stderr, "Usage: pcterm [options] ipaddr\n");
 	fprintf(stderr, "Options:\n");
 	fprintf(stderr, "-p port     : Specify the port number\n");
+	fprintf(stderr, "-m port     : Specify the memory channel port (default port+%d)\n", MEMORY_CHANNEL);
 	fprintf(stderr, "-h history  : Specify the history file (default ~/%s)\n", HISTORY_FILE);
 	fprintf(stderr, "-r retries  : Number of connection retries (default %d)\n", CONNECT_RETRIES);
 	fprintf(stderr, "-l logfile  : Write out all shell text to a log file\n");
@@ -393,6 +419,290 @@ int set_socknonblock(int sock, int block)
 	return fcntl(sock, F_SETFL, fopt);
 }
 
+static void put32(unsigned char *p, unsigned int val)
+{
+	p[0] = val;
+	p[1] = val >> 8;
+	p[2] = val >> 16;
+	p[3] = val >> 24;
+}
+
+static unsigned int get32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+int read_fully(int s, void *buf, int len)
+{
+	int readlen = 0;
+
+	while(readlen < len)
+	{
+		int ret;
+
+		ret = read(s, buf+readlen, len-readlen);
+		if(ret < 0)
+		{
+			if(errno != EINTR)
+			{
+				perror("read");
+				return -1;
+			}
+		}
+		else if(ret == 0)
+		{
+			return -1;
+		}
+		else
+		{
+			readlen += ret;
+		}
+	}
+
+	return readlen;
+}
+
+void mem_close(void)
+{
+	if(g_context.memsock >= 0)
+	{
+		close(g_context.memsock);
+		g_context.memsock = -1;
+	}
+}
+
+int mem_connect(void)
+{
+	struct sockaddr_in name;
+	struct timeval tv;
+	int flag = 1;
+
+	if(g_context.memsock >= 0)
+	{
+		return 1;
+	}
+
+	if(g_context.args.serialmode)
+	{
+		fprintf(stderr, "Memory reads are not available over serial\n");
+		return 0;
+	}
+
+	if(!init_sockaddr(&name, g_context.args.ip, g_context.args.memport))
+	{
+		return 0;
+	}
+
+	g_context.memsock = socket(PF_INET, SOCK_STREAM, 0);
+	if(g_context.memsock < 0)
+	{
+		perror("socket");
+		return 0;
+	}
+
+	if(connect(g_context.memsock, (struct sockaddr *) &name, sizeof(name)) < 0)
+	{
+		perror("connect");
+		mem_close();
+		return 0;
+	}
+
+	/* Do not hang the terminal if psplink is not answering */
+	tv.tv_sec = MEMREAD_TIMEOUT;
+	tv.tv_usec = 0;
+	setsockopt(g_context.memsock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(g_context.memsock, SOL_TCP, TCP_NODELAY, &flag, sizeof(int));
+
+	return 1;
+}
+
+/* Read memory over the memory channel, returns the number of readable bytes or -1 */
+int mem_read(unsigned int addr, unsigned char *data, unsigned int size)
+{
+	unsigned int total = 0;
+
+	if(!mem_connect())
+	{
+		return -1;
+	}
+
+	while(total < size)
+	{
+		unsigned char head[MEMREAD_HEADER];
+		unsigned int len;
+		unsigned int got;
+
+		len = (size - total) > MEMREAD_MAXSIZE ? MEMREAD_MAXSIZE : (size - total);
+		put32(&head[0], MEMREAD_MAGIC);
+		put32(&head[4], addr + total);
+		put32(&head[8], len);
+
+		if((fixed_write(g_context.memsock, head, sizeof(head)) != sizeof(head))
+				|| (read_fully(g_context.memsock, head, sizeof(head)) != sizeof(head))
+				|| (get32(&head[0]) != MEMREAD_MAGIC) || (get32(&head[4]) != (addr + total)))
+		{
+			fprintf(stderr, "Error reading memory at 0x%08X\n", addr + total);
+			mem_close();
+			return -1;
+		}
+
+		got = get32(&head[8]);
+		if((got > len) || (read_fully(g_context.memsock, &data[total], got) != got))
+		{
+			fprintf(stderr, "Error reading memory data at 0x%08X\n", addr + total);
+			mem_close();
+			return -1;
+		}
+
+		total += got;
+		if(got < len)
+		{
+			break;
+		}
+	}
+
+	return total;
+}
+
+void print_row(const unsigned char *row, int row_size, unsigned int addr, int type)
+{
+	int i;
+	int j;
+
+	printf("%08x - ", addr);
+	for(i = 0; i < 16; i += type)
+	{
+		for(j = type - 1; j >= 0; j--)
+		{
+			if((i + j) < row_size)
+			{
+				printf("%02X", row[i + j]);
+			}
+			else
+			{
+				printf("--");
+			}
+		}
+		printf(" ");
+	}
+
+	printf("- ");
+	for(i = 0; i < 16; i++)
+	{
+		printf("%c", ((i < row_size) && (row[i] >= 32) && (row[i] < 127)) ? row[i] : '.');
+	}
+	printf("\n");
+}
+
+void mem_dump(unsigned int addr, unsigned int size, int type)
+{
+	unsigned char *data;
+	int len;
+	int i;
+
+	data = malloc(size);
+	if(data == NULL)
+	{
+		fprintf(stderr, "Error could not allocate memory\n");
+		return;
+	}
+
+	len = mem_read(addr, data, size);
+	if(len == 0)
+	{
+		printf("Invalid memory address %x\n", addr);
+	}
+
+	for(i = 0; i < len; i += 16)
+	{
+		print_row(&data[i], (len - i) > 16 ? 16 : (len - i), addr + i, type);
+	}
+	free(data);
+}
+
+void mem_save(unsigned int addr, unsigned int size, const char *file)
+{
+	unsigned char *data;
+	int len;
+	FILE *fp;
+
+	data = malloc(size);
+	if(data == NULL)
+	{
+		fprintf(stderr, "Error could not allocate memory\n");
+		return;
+	}
+
+	len = mem_read(addr, data, size);
+	if(len > 0)
+	{
+		fp = fopen(file, "wb");
+		if(fp)
+		{
+			fwrite(data, 1, len, fp);
+			fclose(fp);
+			printf("Saved 0x%08X bytes to %s\n", len, file);
+		}
+		else
+		{
+			fprintf(stderr, "Could not open %s for writing\n", file);
+		}
+	}
+	free(data);
+}
+
+/* Local memory commands, the memory is fetched in binary and rendered here */
+void mem_command(char *line)
+{
+	static unsigned int addr = 0;
+	static unsigned int size = MEMDUMP_SIZE;
+	static int type = 1;
+	char *args[4];
+	int argc = 0;
+	char *tok;
+
+	tok = strtok(line, " \t");
+	while((tok) && (argc < 4))
+	{
+		args[argc++] = tok;
+		tok = strtok(NULL, " \t");
+	}
+
+	if((argc > 0) && (strcmp(args[0], "dump") == 0))
+	{
+		if(argc > 1)
+		{
+			addr = strtoul(args[1], NULL, 0);
+		}
+		else
+		{
+			addr += size;
+		}
+
+		if(argc > 2)
+		{
+			size = strtoul(args[2], NULL, 0);
+		}
+
+		if(argc > 3)
+		{
+			type = (args[3][0] == 'w') ? 4 : ((args[3][0] == 'h') ? 2 : 1);
+		}
+
+		mem_dump(addr, size, type);
+	}
+	else if((argc == 4) && (strcmp(args[0], "save") == 0))
+	{
+		mem_save(strtoul(args[1], NULL, 0), strtoul(args[2], NULL, 0), args[3]);
+	}
+	else
+	{
+		printf("Local memory commands:\n");
+		printf("%%dump [addr [size [b|h|w]]] : Dump memory, without an address continue from the last dump\n");
+		printf("%%save addr size file        : Save memory to a local file\n");
+	}
+}
+
 int read_socket(int sock)
 {
 	static char linebuf[16*1024];
@@ -731,6 +1041,7 @@ int main(int argc, char **argv)
 {
 	memset(&g_context, 0, sizeof(g_context));
 	g_context.sock = -1;
+	g_context.memsock = -1;
 	g_context.log  = -1;
 	if(parse_args(argc, argv, &g_context.args))
 	{
@@ -749,6 +1060,7 @@ int main(int argc, char **argv)
 		{
 			close(g_context.sock);
 		}
+		mem_close();
 		if(g_context.log >= 0)
 		{
 			close(g_context.log);
@@ -12,6 +12,7 @@
  */
 #include <pspkernel.h>
 #include <pspdebug.h>
+#include <pspsdk.h>
 #include <pspsysmem_kernel.h>
 #include <psputilsforkernel.h>
 #include <stdio.h>
@@ -22,19 +23,85 @@
 #include "disasm.h"
 #include "debug.h"
 #include "decodeaddr.h"
+#include "watch.h"
 
-#define MAX_BPS 16
 #define SW_BREAK_INST	0x0000000d
+/* Matches any break instruction whatever its code */
+#define BREAK_MASK		0xFC00003F
+/* Exception code of a break instruction and the cause bit set when it was in a delay slot */
+#define EXC_BREAK		9
+#define CAUSE_BD		0x80000000
+
+/* Breakpoints are allocated in chunks from kernel memory and indexed by a hash of their address */
+#define BP_HASH_SIZE   64
+#define BP_CHUNK_SIZE  32
+#define BP_MAX_CHUNKS  64
+#define BP_PARTITION   1
+
+/* Each thread in the middle of a step has its own record, the step breaks use two at most */
+#define STEP_MAX_THREADS 16
+#define STEP_MAX_BPS     (STEP_MAX_THREADS * 2)
+
+/* Breaks we took out recently, a thread which hit one before it went is resumed */
+#define BP_FREED_MAX     16
+
+/* Mask out top nibble so we match whether we end up in kmem,
+ * user mem or cached mem */
+#define BP_ADDR(addr) ((addr) & 0x0FFFFFFF)
+#define BP_HASH(addr) ((BP_ADDR(addr) >> 2) & (BP_HASH_SIZE - 1))
 
 struct BreakPoint
 {
+	/* Next in the hash chain, or the free list */
+	struct BreakPoint *pNext;
 	unsigned int address;
 	unsigned int oldinst;
 	int active;
+	/* Id used by the shell, chunk * BP_CHUNK_SIZE + slot */
+	int id;
+	unsigned int flags;
+	unsigned int hits;
+	/* Number of hits to ignore before we stop */
+	unsigned int count;
+	/* Threads stepping off it, the break goes back in once the last one is done */
+	int stepping;
 };
 
-static struct BreakPoint g_bps[MAX_BPS];
-static struct BreakPoint g_stepbp[2];
+/* A break planted to single step, shared by every thread stepping to the same place */
+struct StepBP
+{
+	unsigned int address;
+	/* The instruction underneath, which may be a breakpoint of our own */
+	unsigned int oldinst;
+	int refs;
+	/* Threads running the instruction underneath, it is planted again once they are done */
+	int lifted;
+};
+
+struct StepState
+{
+	/* Thread doing the step, 0 if the record is free */
+	SceUID thid;
+	/* Where the step breaks were planted, 0 if unused */
+	unsigned int addr[2];
+	/* Breakpoint we are stepping off, put back once the step is done */
+	struct BreakPoint *rearm;
+	/* Another thread's step break we had to lift to run the instruction under it */
+	unsigned int lifted;
+	/* Set when the step came from the shell, so we stop once it is done */
+	int user;
+	/* Stepping over an access to the hardware watch, which goes back in afterwards */
+	int watch;
+};
+
+static struct StepBP g_stepbp[STEP_MAX_BPS];
+static struct StepState g_steps[STEP_MAX_THREADS];
+static struct BreakPoint *g_bphash[BP_HASH_SIZE];
+static struct BreakPoint *g_bpchunks[BP_MAX_CHUNKS];
+static struct BreakPoint *g_bpfree = NULL;
+static int g_bpchunkcount = 0;
+static unsigned int g_bpfreed[BP_FREED_MAX];
+static int g_bpfreedpos = 0;
 extern const char *regName[32];
 
 /* Define some opcode stuff for the stepping function */
@@ -76,8 +143,254 @@ extern const char *regName[32];
 #define BCXT_OPCODE		0x101
 #define BCXTL_OPCODE	0x103
 
+static struct StepBP *find_stepbp(unsigned int address)
+{
+	int i;
+
+	address = BP_ADDR(address);
+	for(i = 0; i < STEP_MAX_BPS; i++)
+	{
+		if((g_stepbp[i].refs > 0) && (BP_ADDR(g_stepbp[i].address) == address))
+		{
+			return &g_stepbp[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Read the instruction at address as it is without any step break */
+static unsigned int get_inst(unsigned int address)
+{
+	struct StepBP *sb;
+
+	sb = find_stepbp(address);
+	if(sb)
+	{
+		return sb->oldinst;
+	}
+
+	return _lw(address);
+}
+
+/* Write an instruction, if a step break is planted there it goes underneath it instead */
+static void set_inst(unsigned int address, unsigned int inst)
+{
+	struct StepBP *sb;
+
+	sb = find_stepbp(address);
+	if(sb)
+	{
+		sb->oldinst = inst;
+		if(sb->lifted == 0)
+		{
+			return;
+		}
+	}
+
+	_sw(inst, address);
+}
+
+static void step_plant(struct StepState *st, int i, unsigned int address)
+{
+	struct StepBP *sb;
+
+	sb = find_stepbp(address);
+	if(sb == NULL)
+	{
+		int j;
+
+		for(j = 0; j < STEP_MAX_BPS; j++)
+		{
+			if(g_stepbp[j].refs == 0)
+			{
+				sb = &g_stepbp[j];
+				break;
+			}
+		}
+
+		/* Cannot happen, there are two for every step record */
+		if(sb == NULL)
+		{
+			return;
+		}
+
+		sb->address = address;
+		sb->oldinst = _lw(address);
+		sb->lifted = 0;
+		_sw(SW_BREAK_INST, address);
+	}
+
+	sb->refs++;
+	st->addr[i] = address;
+}
+
+/* Remember a break we took out, must be called with interrupts disabled */
+static void note_freed(unsigned int address)
+{
+	g_bpfreed[g_bpfreedpos] = BP_ADDR(address);
+	g_bpfreedpos = (g_bpfreedpos + 1) % BP_FREED_MAX;
+}
+
+static int was_freed(unsigned int address)
+{
+	int i;
+
+	for(i = 0; i < BP_FREED_MAX; i++)
+	{
+		if((g_bpfreed[i] != 0) && (g_bpfreed[i] == BP_ADDR(address)))
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void step_unplant(unsigned int address)
+{
+	struct StepBP *sb;
+
+	sb = find_stepbp(address);
+	if(sb)
+	{
+		sb->refs--;
+		if(sb->refs == 0)
+		{
+			_sw(sb->oldinst, sb->address);
+			note_freed(sb->address);
+		}
+	}
+}
+
+/* Put the real instruction back under a step break so this thread can run it */
+static void step_lift(struct StepState *st, unsigned int address)
+{
+	struct StepBP *sb;
+
+	sb = find_stepbp(address);
+	if(sb)
+	{
+		if(sb->lifted == 0)
+		{
+			_sw(sb->oldinst, sb->address);
+		}
+		sb->lifted++;
+		st->lifted = address;
+	}
+}
+
+static void step_unlift(unsigned int address)
+{
+	struct StepBP *sb;
+
+	sb = find_stepbp(address);
+	if((sb) && (sb->lifted > 0))
+	{
+		sb->lifted--;
+		if(sb->lifted == 0)
+		{
+			_sw(SW_BREAK_INST, sb->address);
+		}
+	}
+}
+
+static struct StepState *find_step(SceUID thid)
+{
+	int i;
+
+	for(i = 0; i < STEP_MAX_THREADS; i++)
+	{
+		if(g_steps[i].thid == thid)
+		{
+			return &g_steps[i];
+		}
+	}
+
+	return NULL;
+}
+
+static int step_owns(struct StepState *st, unsigned int address)
+{
+	address = BP_ADDR(address);
+
+	return ((st->addr[0]) && (BP_ADDR(st->addr[0]) == address))
+		|| ((st->addr[1]) && (BP_ADDR(st->addr[1]) == address));
+}
+
+/* Remove the thread's step breaks and put back what it stepped off, returns 1 if
+ * the step came from the shell */
+static int step_finish(struct StepState *st)
+{
+	int user;
+
+	if(st->addr[0])
+	{
+		step_unplant(st->addr[0]);
+	}
+
+	if(st->addr[1])
+	{
+		step_unplant(st->addr[1]);
+	}
+
+	if(st->rearm)
+	{
+		st->rearm->stepping--;
+		if(st->rearm->stepping == 0)
+		{
+			set_inst(st->rearm->address, SW_BREAK_INST);
+		}
+	}
+
+	if(st->lifted)
+	{
+		step_unlift(st->lifted);
+	}
+
+	if(st->watch)
+	{
+		watchRearm();
+	}
+
+	user = st->user;
+	memset(st, 0, sizeof(struct StepState));
+
+	return user;
+}
+
+/* Records are only freed when their step completes, so drop any left by threads which have gone */
+static void step_reclaim(void)
+{
+	SceKernelThreadInfo info;
+	int i;
+	int intc;
+
+	for(i = 0; i < STEP_MAX_THREADS; i++)
+	{
+		SceUID thid = g_steps[i].thid;
+
+		if(thid == 0)
+		{
+			continue;
+		}
+
+		memset(&info, 0, sizeof(info));
+		info.size = sizeof(info);
+		if(sceKernelReferThreadStatus(thid, &info) < 0)
+		{
+			intc = pspSdkDisableInterrupts();
+			if(g_steps[i].thid == thid)
+			{
+				step_finish(&g_steps[i]);
+			}
+			pspSdkEnableInterrupts(intc);
+		}
+	}
+}
+
 /* Generic step command , if skip then will try to skip over jals */
-static void step_generic(PsplinkRegBlock *regs, int skip)
+static void step_generic(struct StepState *st, PsplinkRegBlock *regs, int skip)
 {
 	u32 opcode;
 	u32 epc;
@@ -191,41 +504,87 @@ static void step_generic(PsplinkRegBlock *regs, int skip)
 
 	if(link && skip)
 	{
-		g_stepbp[1].address = epc + 8;
-		g_stepbp[1].oldinst = _lw(epc + 8);
-		g_stepbp[1].active = 1;
-		_sw(SW_BREAK_INST, epc + 8);
+		step_plant(st, 1, epc + 8);
 	}
 	else if(branch)
 	{
-		g_stepbp[0].address = targetpc;
-		g_stepbp[0].oldinst = _lw(targetpc);
-		g_stepbp[0].active = 1;
-		_sw(SW_BREAK_INST, targetpc);
+		step_plant(st, 0, targetpc);
 			
 		if((cond) && (targetpc != (epc + 8)))
 		{
-			g_stepbp[1].address = epc + 8;
-			g_stepbp[1].oldinst = _lw(epc + 8);
-			g_stepbp[1].active = 1;
-			_sw(SW_BREAK_INST, epc + 8);
+			step_plant(st, 1, epc + 8);
 		}
 
 	}
 	else
 	{
-		g_stepbp[0].address = targetpc;
-		g_stepbp[0].active = 1;
-		g_stepbp[0].oldinst = _lw(targetpc);
-		_sw(SW_BREAK_INST, targetpc);
+		step_plant(st, 0, targetpc);
 	}
 }
 
+static struct BreakPoint *find_bp(unsigned int address);
+
+/* Start a step of the thread over the instruction at its epc. Any break we have planted
+ * there is taken out for the thread and put back once it has stepped off, must be called
+ * with interrupts disabled */
+static struct StepState *step_thread(SceUID thid, PsplinkRegBlock *regs, int skip)
+{
+	struct StepState *st;
+	struct BreakPoint *pBp;
+
+	/* A step which never completed, the thread was moved somewhere else */
+	st = find_step(thid);
+	if(st)
+	{
+		step_finish(st);
+	}
+
+	st = find_step(0);
+	if(st == NULL)
+	{
+		return NULL;
+	}
+
+	st->thid = thid;
+	pBp = find_bp(regs->epc);
+	if(pBp)
+	{
+		pBp->stepping++;
+		st->rearm = pBp;
+		set_inst(pBp->address, pBp->oldinst);
+	}
+	step_lift(st, regs->epc);
+	step_generic(st, regs, skip);
+
+	return st;
+}
+
 void debugStep(int skip)
 {
 	if(g_currex)
 	{
-		step_generic(&g_currex->regs, skip);
+		struct StepState *st;
+		int intc;
+
+		if(find_step(0) == NULL)
+		{
+			step_reclaim();
+		}
+
+		intc = pspSdkDisableInterrupts();
+		st = step_thread(g_currex->thid, &g_currex->regs, skip);
+		if(st)
+		{
+			st->user = 1;
+		}
+		pspSdkEnableInterrupts(intc);
+
+		if(st == NULL)
+		{
+			printf("Error, too many threads are stepping\n");
+			return;
+		}
+
 		sceKernelDcacheWritebackInvalidateAll();
 		sceKernelIcacheInvalidateAll();
 		exceptionResume();
@@ -238,49 +597,181 @@ void debugStep(int skip)
 
 static struct BreakPoint *find_bp(unsigned int address)
 {
-	int i;
+	struct BreakPoint *pBp;
 
-	/* Mask out top nibble so we match whether we end up in kmem,
-	 * user mem or cached mem */
-	address &= 0x0FFFFFFF;
-	for(i = 0; i < MAX_BPS; i++)
+	address = BP_ADDR(address);
+	pBp = g_bphash[BP_HASH(address)];
+	while(pBp)
 	{
-		if((g_bps[i].active) && ((g_bps[i].address & 0x0FFFFFFF) == address))
+		if(BP_ADDR(pBp->address) == address)
 		{
-			return &g_bps[i];
+			return pBp;
 		}
+		pBp = pBp->pNext;
 	}
 
 	return NULL;
 }
 
+static int alloc_bpchunk(void)
+{
+	SceUID uid;
+	struct BreakPoint *pChunk;
+	int i;
+
+	if(g_bpchunkcount >= BP_MAX_CHUNKS)
+	{
+		return 0;
+	}
+
+	uid = sceKernelAllocPartitionMemory(BP_PARTITION, "breakpoints", PSP_SMEM_Low, 
+			BP_CHUNK_SIZE * sizeof(struct BreakPoint), NULL);
+	if(uid < 0)
+	{
+		printf("Error could not allocate breakpoint memory %08X\n", uid);
+		return 0;
+	}
+
+	pChunk = (struct BreakPoint *) sceKernelGetBlockHeadAddr(uid);
+	memset(pChunk, 0, BP_CHUNK_SIZE * sizeof(struct BreakPoint));
+	for(i = BP_CHUNK_SIZE - 1; i >= 0; i--)
+	{
+		pChunk[i].id = (g_bpchunkcount * BP_CHUNK_SIZE) + i;
+		pChunk[i].pNext = g_bpfree;
+		g_bpfree = &pChunk[i];
+	}
+
+	g_bpchunks[g_bpchunkcount++] = pChunk;
+
+	return 1;
+}
+
 static struct BreakPoint *find_freebp(void)
 {
+	struct BreakPoint *pBp;
+
+	if((g_bpfree == NULL) && (!alloc_bpchunk()))
+	{
+		return NULL;
+	}
+
+	pBp = g_bpfree;
+	g_bpfree = pBp->pNext;
+	pBp->pNext = NULL;
+
+	return pBp;
+}
+
+static struct BreakPoint *find_bpid(int id)
+{
+	struct BreakPoint *pBp;
+
+	if((id < 0) || (id >= (g_bpchunkcount * BP_CHUNK_SIZE)))
+	{
+		return NULL;
+	}
+
+	pBp = &g_bpchunks[id / BP_CHUNK_SIZE][id % BP_CHUNK_SIZE];
+	if(!pBp->active)
+	{
+		return NULL;
+	}
+
+	return pBp;
+}
+
+/* Unlink a breakpoint, put back the instruction and return it to the free list */
+static void free_bp(struct BreakPoint *pBp)
+{
+	struct BreakPoint **pPrev;
+	int intc;
 	int i;
-	for(i = 0; i < MAX_BPS; i++)
+
+	intc = pspSdkDisableInterrupts();
+	/* If a thread is stepping off it then the original instruction is already in place */
+	if(pBp->stepping == 0)
+	{
+		set_inst(pBp->address, pBp->oldinst);
+	}
+	note_freed(pBp->address);
+
+	pPrev = &g_bphash[BP_HASH(pBp->address)];
+	while(*pPrev)
 	{
-		if(!g_bps[i].active)
+		if(*pPrev == pBp)
 		{
-			return &g_bps[i];
+			*pPrev = pBp->pNext;
+			break;
 		}
+		pPrev = &(*pPrev)->pNext;
 	}
 
-	return NULL;
+	/* The steps still finish, there is just nothing to put back */
+	for(i = 0; i < STEP_MAX_THREADS; i++)
+	{
+		if(g_steps[i].rearm == pBp)
+		{
+			g_steps[i].rearm = NULL;
+		}
+	}
+
+	pBp->active = 0;
+	pBp->stepping = 0;
+	pBp->pNext = g_bpfree;
+	g_bpfree = pBp;
+	pspSdkEnableInterrupts(intc);
 }
 
-int debugSetBP(unsigned int address)
+int debugSetBP(unsigned int address, unsigned int flags, unsigned int count)
 {
-	if(find_bp(address) == NULL)
+	struct BreakPoint *pBp;
+
+	if(!(flags & (DEBUG_BP_GDB | DEBUG_BP_SHELL)))
 	{
-		struct BreakPoint *pBp;
+		flags |= DEBUG_BP_SHELL;
+	}
+
+	if((address & 3) || (memValidate(address, MEM_ATTRIB_WRITE | MEM_ATTRIB_WORD | MEM_ATTRIB_EXEC) < sizeof(u32)))
+	{
+		printf("Error, invalid address for breakpoint 0x%08X\n", address);
+		return 0;
+	}
+
+	pBp = find_bp(address);
+	if(pBp != NULL)
+	{
+		/* Already set by the other owner, share it. Setting it again is fine, gdb
+		 * repeats its requests after a retransmit or a reconnect */
+		pBp->flags |= flags;
+		if(flags & DEBUG_BP_SHELL)
+		{
+			pBp->hits = 0;
+			pBp->count = count;
+		}
 
+		return 1;
+	}
+	else
+	{
 		pBp = find_freebp();
 		if(pBp != NULL)
 		{
-			pBp->oldinst = _lw(address);
-			_sw(SW_BREAK_INST, address);
+			int intc;
+
+			intc = pspSdkDisableInterrupts();
+			pBp->oldinst = get_inst(address);
 			pBp->address = address;
+			pBp->flags = flags;
+			pBp->hits = 0;
+			pBp->count = count;
 			pBp->active = 1;
+			pBp->stepping = 0;
+
+			pBp->pNext = g_bphash[BP_HASH(address)];
+			g_bphash[BP_HASH(address)] = pBp;
+			set_inst(address, SW_BREAK_INST);
+			pspSdkEnableInterrupts(intc);
+
 			sceKernelDcacheWritebackInvalidateAll();
 			sceKernelIcacheInvalidateAll();
 
@@ -295,17 +786,62 @@ int debugSetBP(unsigned int address)
 	return 0;
 }
 
+int debugClearBP(unsigned int address)
+{
+	struct BreakPoint *pBp;
+
+	/* Nothing to clear is not an error, gdb may repeat the request */
+	pBp = find_bp(address);
+	if((pBp == NULL) || (!(pBp->flags & DEBUG_BP_GDB)))
+	{
+		return 1;
+	}
+
+	/* Leave it for the shell if it set one here as well */
+	pBp->flags &= ~DEBUG_BP_GDB;
+	if(pBp->flags & DEBUG_BP_SHELL)
+	{
+		return 1;
+	}
+
+	free_bp(pBp);
+	sceKernelDcacheWritebackInvalidateAll();
+	sceKernelIcacheInvalidateAll();
+
+	return 1;
+}
+
+int debugFindBP(unsigned int address)
+{
+	struct BreakPoint *pBp;
+
+	pBp = find_bp(address);
+	if(pBp)
+	{
+		return pBp->flags | DEBUG_BP_ACTIVE;
+	}
+
+	return 0;
+}
+
 int debugDeleteBp(int i)
 {
-	if((i >= 0) && (i < MAX_BPS))
+	struct BreakPoint *pBp;
+
+	pBp = find_bpid(i);
+	if(pBp)
 	{
-		if(g_bps[i].active)
+		/* Leave it for gdb if it set one here as well */
+		if(pBp->flags & DEBUG_BP_GDB)
 		{
-			_sw(g_bps[i].oldinst, g_bps[i].address);
-			g_bps[i].active = 0;
-			sceKernelDcacheWritebackInvalidateAll();
-			sceKernelIcacheInvalidateAll();
+			pBp->flags &= ~DEBUG_BP_SHELL;
+			pBp->count = 0;
+			return 1;
 		}
+
+		free_bp(pBp);
+		sceKernelDcacheWritebackInvalidateAll();
+		sceKernelIcacheInvalidateAll();
 	}
 
 	return 1;
@@ -316,82 +852,168 @@ void debugPrintBPS(void)
 	int i;
 
 	printf("Breakpoint List:\n");
-	for(i = 0; i < MAX_BPS; i++)
+	for(i = 0; i < (g_bpchunkcount * BP_CHUNK_SIZE); i++)
 	{
-		if(g_bps[i].active)
+		struct BreakPoint *pBp;
+
+		pBp = find_bpid(i);
+		if(pBp)
 		{
-			printf("%-2d: Address %08X - Old Instruction %08X\n", i, g_bps[i].address, g_bps[i].oldinst);
+			printf("%-2d: Address %08X - Old Instruction %08X - Hits %d", i, pBp->address, pBp->oldinst, pBp->hits);
+			if(pBp->count)
+			{
+				printf(" - Ignore %d", pBp->count);
+			}
+			if(pBp->flags & DEBUG_BP_GDB)
+			{
+				printf(" - GDB");
+			}
+			printf("\n");
 		}
 	}
 }
 
-int check_bp(unsigned int address)
+static void print_bp(PsplinkRegBlock *pRegs, unsigned int address)
 {
-	if((g_stepbp[0].active) && (g_stepbp[0].address == address))
-	{
-		return 1;
-	}
+	unsigned int regmask;
 
-	if((g_stepbp[1].active) && (g_stepbp[1].address == address))
-	{
-		return 1;
-	}
+	struct BreakPoint *pBp;
+	unsigned int inst;
 
-	if(find_bp(address))
+	/* Show what is really there rather than any break we have left in place */
+	pBp = find_bp(address);
+	inst = pBp ? pBp->oldinst : get_inst(address);
+	printf("%s\n", disasmInstruction(inst, address, &pRegs->r[0], &regmask));
+	if(regmask)
 	{
-		return 1;
+		int i;
+		for(i = 1; i < 32; i++)
+		{
+			if(regmask & (1 << i))
+			{
+				printf("$%s = 0x%08X\n", regName[i], pRegs->r[i]);
+			}
+		}
 	}
-
-	return 0;
 }
 
-int debugHandleException(PsplinkRegBlock *pRegs)
+int debugHandleException(struct PsplinkContext *ctx)
 {
+	PsplinkRegBlock *pRegs = &ctx->regs;
 	unsigned int address;
 	struct BreakPoint *pBp;
+	struct StepState *st;
+	int nostep = 0;
+	int intc;
 	int ret = 0;
-	unsigned int regmask;
 
 	address = pRegs->epc;
 
-	if(check_bp(address))
+	if(find_step(0) == NULL)
 	{
-		/* Recover step break points */
-		if(g_stepbp[0].active)
+		step_reclaim();
+	}
+
+	if((pRegs->type == PSPLINK_EXTYPE_DEBUG) && (ctx->drcntl & DEBUG_DRCNTL_DATA))
+	{
+		ret = watchHandleHit(address);
+		if(ret == 2)
 		{
-			_sw(g_stepbp[0].oldinst, g_stepbp[0].address);
-			g_stepbp[0].active = 0;
+			intc = pspSdkDisableInterrupts();
+			st = step_thread(ctx->thid, pRegs, 0);
+			if(st)
+			{
+				st->watch = 1;
+			}
+			else
+			{
+				/* Stop it instead, the access traps again once it is resumed */
+				watchRearm();
+				nostep = 1;
+				ret = 1;
+			}
+			pspSdkEnableInterrupts(intc);
+			sceKernelDcacheWritebackInvalidateAll();
+			sceKernelIcacheInvalidateAll();
 		}
 
-		if(g_stepbp[1].active)
+		if(nostep)
 		{
-			_sw(g_stepbp[1].oldinst, g_stepbp[1].address);
-			g_stepbp[1].active = 0;
+			printf("Error, too many threads are stepping, stopping thread 0x%08X\n", ctx->thid);
 		}
 
-		pBp = find_bp(address);
-		if(pBp != NULL)
+		return ret;
+	}
+
+	intc = pspSdkDisableInterrupts();
+	st = find_step(ctx->thid);
+	pBp = find_bp(address);
+	if((st) && (step_owns(st, address)))
+	{
+		/* Our step is done, only stop if the shell asked for it */
+		ret = step_finish(st) ? 1 : 2;
+	}
+	else if((pBp == NULL) && (find_stepbp(address)))
+	{
+		/* Another thread's step break, run the instruction under it and carry on */
+		ret = 2;
+		if(step_thread(ctx->thid, pRegs, 0) == NULL)
 		{
-			_sw(pBp->oldinst, pBp->address);
-			pBp->active = 0;
+			nostep = 1;
+			ret = 1;
 		}
+	}
+	else if((pBp == NULL) && (pRegs->type == PSPLINK_EXTYPE_NORMAL) && (((pRegs->cause >> 2) & 31) == EXC_BREAK)
+			&& (!(pRegs->cause & CAUSE_BD)) && (was_freed(address)) && ((_lw(address) & BREAK_MASK) != SW_BREAK_INST))
+	{
+		/* Our break was taken out before we got here, run what is there now */
+		ret = 2;
+	}
 
-		sceKernelDcacheWritebackInvalidateAll();
-		sceKernelIcacheInvalidateAll();
-		printf("%s\n", disasmInstruction(_lw(address), address, &pRegs->r[0], &regmask));
-		if(regmask)
+	if(pBp != NULL)
+	{
+		pBp->hits++;
+		if((pBp->flags & DEBUG_BP_SHELL) && (pBp->hits > pBp->count))
 		{
-			int i;
-			for(i = 1; i < 32; i++)
+			ret = 1;
+			if(pBp->flags & DEBUG_BP_GDB)
 			{
-				if(regmask & (1 << i))
-				{
-					printf("$%s = 0x%08X\n", regName[i], pRegs->r[i]);
-				}
+				/* gdb still wants it, it is stepped over when the thread is resumed */
+				pBp->flags &= ~DEBUG_BP_SHELL;
+				pBp->count = 0;
+			}
+			else
+			{
+				free_bp(pBp);
+			}
+		}
+		else if(ret != 1)
+		{
+			/* Not stopping here, step over it and rearm it afterwards */
+			ret = 2;
+			if(step_thread(ctx->thid, pRegs, 0) == NULL)
+			{
+				nostep = 1;
+				ret = 1;
 			}
 		}
+	}
+	pspSdkEnableInterrupts(intc);
+
+	if(ret != 0)
+	{
+		sceKernelDcacheWritebackInvalidateAll();
+		sceKernelIcacheInvalidateAll();
+	}
 
-		ret = 1;
+	if(nostep)
+	{
+		printf("Error, too many threads are stepping, stopping thread 0x%08X\n", ctx->thid);
+	}
+
+	if(ret == 1)
+	{
+		print_bp(pRegs, address);
 	}
 
 	return ret;
@@ -30,11 +30,30 @@ struct DebugEnv
 };
 
 
+/* Breakpoint flags, the shell and the gdb stub can both own the same address */
+/* Owned by the gdb stub, other threads just step over it */
+#define DEBUG_BP_GDB    0x0001
+/* Owned by the shell, stops the thread once the ignore count runs out */
+#define DEBUG_BP_SHELL  0x0002
+/* Returned by debugFindBP for any set breakpoint */
+#define DEBUG_BP_ACTIVE 0x8000
+
+/* DRCNTL bit set by a data break */
+#define DEBUG_DRCNTL_DATA (1 << 12)
+
 void debugPrintBPS(void);
 int debugDeleteBp(int i);
-int debugSetBP(unsigned int address);
+/* Set a breakpoint, ignoring the first count hits. Adds the owner if the address already has one,
+ * returns 0 only if it could not be set */
+int debugSetBP(unsigned int address, unsigned int flags, unsigned int count);
+/* Drop the gdb stub's claim on the breakpoint at address, it is removed once nobody owns it.
+ * Succeeds if gdb had no breakpoint there */
+int debugClearBP(unsigned int address);
+/* Returns the flags of the breakpoint at address or'ed with DEBUG_BP_ACTIVE, 0 if none */
+int debugFindBP(unsigned int address);
 void debugStep(int skip);
-int debugHandleException(PsplinkRegBlock *pRegs);
+/* Returns 0 if not ours, 1 to stop the thread or 2 to resume it straight away */
+int debugHandleException(struct PsplinkContext *ctx);
 void debugPrintHWRegs(void);
 void debugEnableHW(void);
 void debugDisableHW(void);
@@ -13,6 +13,7 @@
 
 #include <pspkernel.h>
 #include <pspsdk.h>
+#include <pspsysmem_kernel.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -36,23 +37,33 @@ struct mem_entry
 
 static struct mem_entry g_memareas[] = 
 {
-	{ 0x00010000, (16 * 1024), MEM_ATTRIB_ALL, "Scratchpad", 0 },
-	{ 0x40010000, (16 * 1024), MEM_ATTRIB_ALL, "Scratchpad (uncached)", 0 },
-	{ 0x04000000, (2 * 1024 * 1024), MEM_ATTRIB_ALL, "VRAM", 0 },
-	{ 0x44000000, (2 * 1024 * 1024), MEM_ATTRIB_ALL, "VRAM (uncached)", 0 },
-	{ 0x08800000, (24 * 1024 * 1024), MEM_ATTRIB_ALL, "User memory", 0 },
-	{ 0x48800000, (24 * 1024 * 1024), MEM_ATTRIB_ALL, "User memory (uncached)", 0 },
-	{ 0x88000000, (4 * 1024 * 1024), MEM_ATTRIB_ALL, "Kernel memory (low)", 0 },
-	{ 0xA8000000, (4 * 1024 * 1024), MEM_ATTRIB_ALL, "Kernel memory (low uncached)", 0 },
+	{ 0x00010000, (16 * 1024), MEM_ATTRIB_RWX | MEM_ATTRIB_USER, "Scratchpad", 0 },
+	{ 0x40010000, (16 * 1024), MEM_ATTRIB_RWX | MEM_ATTRIB_USER | MEM_ATTRIB_UNCACHED, "Scratchpad (uncached)", 0 },
+	{ 0x04000000, (2 * 1024 * 1024), MEM_ATTRIB_RWX | MEM_ATTRIB_USER, "VRAM", 0 },
+	{ 0x44000000, (2 * 1024 * 1024), MEM_ATTRIB_RWX | MEM_ATTRIB_USER | MEM_ATTRIB_UNCACHED, "VRAM (uncached)", 0 },
+	{ 0x08800000, (24 * 1024 * 1024), MEM_ATTRIB_RWX | MEM_ATTRIB_USER, "User memory", 0 },
+	{ 0x48800000, (24 * 1024 * 1024), MEM_ATTRIB_RWX | MEM_ATTRIB_USER | MEM_ATTRIB_UNCACHED, "User memory (uncached)", 0 },
+	{ 0x88000000, (4 * 1024 * 1024), MEM_ATTRIB_RWX, "Kernel memory (low)", 0 },
+	{ 0xA8000000, (4 * 1024 * 1024), MEM_ATTRIB_RWX | MEM_ATTRIB_UNCACHED, "Kernel memory (low uncached)", 0 },
 	/* Don't use the following 2 on a 1.5, just crashes the psp */
-	{ 0x88400000, (4 * 1024 * 1024), MEM_ATTRIB_ALL, "Kernel memory (mid v1.0 only)", 1 },
-	{ 0xC8400000, (4 * 1024 * 1024), MEM_ATTRIB_ALL, "Kernel memory (mid v1.0 only uncached)", 1 },
-	{ 0x88800000, (24 * 1024 * 1024), MEM_ATTRIB_ALL, "Kernel memory (high)", 0 },
-	{ 0xA8800000, (24 * 1024 * 1024), MEM_ATTRIB_ALL, "Kernel memory (high uncached)", 0 },
-	{ 0xBFC00000, (1 * 1024 * 1024), MEM_ATTRIB_ALL, "Internal RAM", 0 },
+	{ 0x88400000, (4 * 1024 * 1024), MEM_ATTRIB_RWX, "Kernel memory (mid v1.0 only)", 1 },
+	{ 0xC8400000, (4 * 1024 * 1024), MEM_ATTRIB_RWX | MEM_ATTRIB_UNCACHED, "Kernel memory (mid v1.0 only uncached)", 1 },
+	{ 0x88800000, (24 * 1024 * 1024), MEM_ATTRIB_RWX, "Kernel memory (high)", 0 },
+	{ 0xA8800000, (24 * 1024 * 1024), MEM_ATTRIB_RWX | MEM_ATTRIB_UNCACHED, "Kernel memory (high uncached)", 0 },
+	{ 0xBFC00000, (1 * 1024 * 1024), MEM_ATTRIB_RWX | MEM_ATTRIB_UNCACHED, "Internal RAM", 0 },
 	{ 0, 0, 0, NULL }
 };
 
+/* The region map is the table above split up by the sysmem partitions, sorted by
+ * address so it can be binary searched. It is rebuilt into the spare buffer and
+ * swapped in so queries only need to hold off interrupts for the search */
+#define MEM_MAX_REGIONS 64
+#define MEM_MAX_PARTITIONS 8
+
+static struct MemRegion g_regionbuf[2][MEM_MAX_REGIONS];
+static struct MemRegion *g_regions = g_regionbuf[0];
+static int g_regioncount = 0;
+
 enum Operator
 {
 	OP_START,
@@ -162,14 +173,36 @@ static int deref_addr(unsigned int *val, int deref)
 	return 1;
 }
 
-static int get_modaddr(char *name, unsigned int *val)
+/* Kinds of lookup held in the cache */
+#define LOOKUP_MODULE 1
+#define LOOKUP_THREAD 2
+
+/* Module and thread lookups are remembered between evaluations. An entry is
+ * only used if it belongs to the current generation and its uid still exists */
+#define LOOKUP_CACHE_SIZE 16
+#define LOOKUP_KEY_MAX    64
+
+struct LookupCache
+{
+	int type;
+	SceUID uid;
+	u32 val;
+	u32 gen;
+	u32 stamp;
+	char key[LOOKUP_KEY_MAX];
+};
+
+static struct LookupCache g_lookups[LOOKUP_CACHE_SIZE];
+static u32 g_lookupgen = 1;
+static u32 g_lookupstamp = 0;
+
+static int get_modaddr(char *name, SceUID *puid, unsigned int *val)
 {
 	char *pcolon;
 	char *pcomma;
 	SceKernelModuleInfo info;
 	SceModule *pMod;
 	SceUID uid = 0;
-	int ret = 0;
 
 	pcolon = strchr(name, ':');
 	if(pcolon)
@@ -197,11 +230,8 @@ static int get_modaddr(char *name, unsigned int *val)
 
 	if(!psplinkReferModule(uid, &info))
 	{
-		if(ret < 0)
-		{
-			printf("Error, could not get module info\n");
-			return 0;
-		}
+		printf("Error, could not get module info\n");
+		return 0;
 	}
 
 	if((pcolon == NULL) || (strcmp(pcolon, "text") == 0))
@@ -268,10 +298,12 @@ static int get_modaddr(char *name, unsigned int *val)
 		return 0;
 	}
 
+	*puid = uid;
+
 	return 1;
 }
 
-static int get_threadaddr(char *name, unsigned int *val)
+static int get_threadaddr(char *name, SceUID *puid, unsigned int *val)
 {
 	char *pcolon;
 	SceKernelThreadInfo info;
@@ -322,6 +354,103 @@ static int get_threadaddr(char *name, unsigned int *val)
 		return 0;
 	}
 
+	*puid = uid;
+
+	return 1;
+}
+
+/* Get a module or thread address, using the lookup cache where possible */
+static int lookup_addr(int type, char *key, unsigned int *val)
+{
+	struct LookupCache entry;
+	int intc;
+	int found = 0;
+	int cache;
+	int slot;
+	int i;
+	int ret;
+
+	intc = pspSdkDisableInterrupts();
+	for(i = 0; i < LOOKUP_CACHE_SIZE; i++)
+	{
+		if((g_lookups[i].type == type) && (g_lookups[i].gen == g_lookupgen) 
+				&& (strcmp(g_lookups[i].key, key) == 0))
+		{
+			g_lookups[i].stamp = ++g_lookupstamp;
+			memcpy(&entry, &g_lookups[i], sizeof(entry));
+			found = 1;
+			break;
+		}
+	}
+	pspSdkEnableInterrupts(intc);
+
+	if(found)
+	{
+		if(type == LOOKUP_MODULE)
+		{
+			found = sceKernelFindModuleByUID(entry.uid) != NULL;
+		}
+		else
+		{
+			found = sceKernelGetThreadmanIdType(entry.uid) == SCE_KERNEL_TMID_Thread;
+		}
+
+		if(found)
+		{
+			*val = entry.val;
+			return 1;
+		}
+	}
+
+	/* The lookup splits the key up so keep a copy of it first */
+	cache = strlen(key) < LOOKUP_KEY_MAX;
+	if(cache)
+	{
+		strcpy(entry.key, key);
+	}
+
+	/* Take the generation first so an invalidate during the lookup is not lost */
+	entry.gen = g_lookupgen;
+	if(type == LOOKUP_MODULE)
+	{
+		ret = get_modaddr(key, &entry.uid, &entry.val);
+	}
+	else
+	{
+		ret = get_threadaddr(key, &entry.uid, &entry.val);
+	}
+
+	if(!ret)
+	{
+		return 0;
+	}
+
+	*val = entry.val;
+	if(cache)
+	{
+		entry.type = type;
+
+		intc = pspSdkDisableInterrupts();
+		/* Reuse the entry for this key, otherwise the least recently used */
+		slot = 0;
+		for(i = 0; i < LOOKUP_CACHE_SIZE; i++)
+		{
+			if((g_lookups[i].type == type) && (strcmp(g_lookups[i].key, entry.key) == 0))
+			{
+				slot = i;
+				break;
+			}
+
+			if(g_lookups[i].stamp < g_lookups[slot].stamp)
+			{
+				slot = i;
+			}
+		}
+		entry.stamp = ++g_lookupstamp;
+		memcpy(&g_lookups[slot], &entry, sizeof(entry));
+		pspSdkEnableInterrupts(intc);
+	}
+
 	return 1;
 }
 
@@ -389,7 +518,7 @@ static int parse_line(char *line, unsigned int *val)
 			}
 
 			*endp = 0;
-			if(!get_modaddr(line, &temp))
+			if(!lookup_addr(LOOKUP_MODULE, line, &temp))
 			{
 				return 0;
 			}
@@ -410,7 +539,7 @@ static int parse_line(char *line, unsigned int *val)
 
 			*endp = 0;
 			/* Decode the module name */
-			if(!get_threadaddr(line, &temp))
+			if(!lookup_addr(LOOKUP_THREAD, line, &temp))
 			{
 				return 0;
 			}
@@ -640,30 +769,181 @@ int memDecode(const char *line, u32 *val)
 	return parse_line(line_buf, val);
 }
 
-int memValidate(u32 addr, u32 attrib)
+void memInvalidateLookups(void)
 {
+	g_lookupgen++;
+}
+
+/* Split the region containing a partition so the partition has its own entry */
+static int insert_partition(struct MemRegion *map, int count, int pid, u32 addr, u32 size)
+{
+	int i;
+
+	for(i = 0; i < count; i++)
+	{
+		u32 end = map[i].addr + map[i].size;
+		u32 start;
+
+		/* Match on the physical address so the partition shows up in every mirror */
+		start = (map[i].addr & 0xE0000000) | (addr & 0x1FFFFFFF);
+		if((start < map[i].addr) || (start >= end) || (size > (end - start)))
+		{
+			continue;
+		}
+
+		if((count + 2) > MEM_MAX_REGIONS)
+		{
+			break;
+		}
+
+		if(start > map[i].addr)
+		{
+			memmove(&map[i+1], &map[i], (count - i) * sizeof(struct MemRegion));
+			map[i].size = start - map[i].addr;
+			map[i+1].addr = start;
+			map[i+1].size = end - start;
+			count++;
+			i++;
+		}
+
+		if((start + size) < end)
+		{
+			memmove(&map[i+1], &map[i], (count - i) * sizeof(struct MemRegion));
+			map[i].size = size;
+			map[i+1].addr = start + size;
+			map[i+1].size = end - (start + size);
+			count++;
+		}
+
+		map[i].partition = pid;
+		i++;
+	}
+
+	return count;
+}
+
+void memRefreshRegions(void)
+{
+	struct MemRegion *map;
 	const struct mem_entry *entry;
-	int size_left = 0;
+	int count = 0;
+	int intc;
+	int i;
+
+	map = (g_regions == g_regionbuf[0]) ? g_regionbuf[1] : g_regionbuf[0];
+
+	/* Insertion sort the fixed areas, there are only a handful of them */
+	for(entry = g_memareas; entry->size != 0; entry++)
+	{
+		if((entry->v1only) && (!g_isv1))
+		{
+			continue;
+		}
+
+		i = count;
+		while((i > 0) && (map[i-1].addr > entry->addr))
+		{
+			map[i] = map[i-1];
+			i--;
+		}
+
+		map[i].addr = entry->addr;
+		map[i].size = entry->size;
+		map[i].attrib = entry->attrib;
+		map[i].partition = 0;
+		map[i].desc = entry->desc;
+		count++;
+	}
+
+	for(i = 1; i <= MEM_MAX_PARTITIONS; i++)
+	{
+		PspSysmemPartitionInfo info;
+
+		memset(&info, 0, sizeof(info));
+		info.size = sizeof(info);
+		if((sceKernelQueryMemoryPartitionInfo(i, &info) < 0) || (info.memsize == 0))
+		{
+			continue;
+		}
+
+		count = insert_partition(map, count, i, info.startaddr, info.memsize);
+	}
+
+	intc = pspSdkDisableInterrupts();
+	g_regions = map;
+	g_regioncount = count;
+	pspSdkEnableInterrupts(intc);
+}
+
+/* Binary search for the region containing addr, call with interrupts disabled */
+static int find_region(u32 addr)
+{
+	int first = 0;
+	int last = g_regioncount - 1;
+
+	while(first <= last)
+	{
+		int mid = (first + last) / 2;
+
+		if(addr < g_regions[mid].addr)
+		{
+			last = mid - 1;
+		}
+		else if(addr >= (g_regions[mid].addr + g_regions[mid].size))
+		{
+			first = mid + 1;
+		}
+		else
+		{
+			return mid;
+		}
+	}
+
+	return -1;
+}
 
-	entry = g_memareas;
+int memFindRegion(u32 addr, struct MemRegion *region)
+{
+	int intc;
+	int i;
 
-	while(entry->size != 0)
+	intc = pspSdkDisableInterrupts();
+	i = find_region(addr);
+	if(i >= 0)
 	{
-		if((addr >= entry->addr) && (addr < (entry->addr + (u32) entry->size)))
+		memcpy(region, &g_regions[i], sizeof(struct MemRegion));
+	}
+	pspSdkEnableInterrupts(intc);
+
+	return i >= 0;
+}
+
+int memValidate(u32 addr, u32 attrib)
+{
+	int size_left = 0;
+	int intc;
+	int i;
+
+	intc = pspSdkDisableInterrupts();
+	i = find_region(addr);
+	/* Only pass through areas with valid attributes (e.g. write or execute) */
+	if((i >= 0) && ((g_regions[i].attrib & attrib) == attrib))
+	{
+		size_left = g_regions[i].size - (int) (addr - g_regions[i].addr);
+
+		/* Carry on through the rest of the fixed area it was split from */
+		for(i++; i < g_regioncount; i++)
 		{
-			/* Only pass through areas with valid attributes (e.g. write or execute) */
-			if((entry->attrib & attrib) == attrib)
+			if((g_regions[i].desc != g_regions[i-1].desc)
+					|| ((g_regions[i].attrib & attrib) != attrib))
 			{
-				if((!entry->v1only) || (g_isv1))
-				{
-					size_left = entry->size - (int) (addr - entry->addr);
-				}
+				break;
 			}
-			break;
-		}
 
-		entry++;
+			size_left += g_regions[i].size;
+		}
 	}
+	pspSdkEnableInterrupts(intc);
 
 	if((g_protoff) && (size_left == 0))
 	{
@@ -674,19 +954,52 @@ int memValidate(u32 addr, u32 attrib)
 	return size_left;
 }
 
+static void print_region(const struct MemRegion *region)
+{
+	printf("Base 0x%08X - Size 0x%08X - %s", region->addr, region->size, region->desc);
+	if(region->partition)
+	{
+		printf(" (partition %d)", region->partition);
+	}
+	printf("\n");
+}
+
 void memPrintRegions(void)
 {
+	struct MemRegion map[MEM_MAX_REGIONS];
+	int count;
+	int intc;
 	int i;
+
+	intc = pspSdkDisableInterrupts();
+	count = g_regioncount;
+	memcpy(map, g_regions, count * sizeof(struct MemRegion));
+	pspSdkEnableInterrupts(intc);
+
 	printf("Memory Regions:\n");
-	i = 0;
-	while(g_memareas[i].addr)
+	for(i = 0; i < count; i++)
 	{
-		if((!g_memareas[i].v1only) || (g_isv1))
-		{
-			printf("Region %2d: Base 0x%08X - Size 0x%08X - %s\n", i,
-				g_memareas[i].addr, g_memareas[i].size, g_memareas[i].desc);
-		}
-		i++;
+		printf("Region %2d: ", i);
+		print_region(&map[i]);
+	}
+}
+
+void memPrintRegion(u32 addr)
+{
+	struct MemRegion region;
+
+	if(memFindRegion(addr, &region))
+	{
+		printf("0x%08X: ", addr);
+		print_region(&region);
+		printf("Access %c%c%c%s%s\n", (region.attrib & MEM_ATTRIB_READ) ? 'r' : '-',
+				(region.attrib & MEM_ATTRIB_WRITE) ? 'w' : '-', (region.attrib & MEM_ATTRIB_EXEC) ? 'x' : '-',
+				(region.attrib & MEM_ATTRIB_USER) ? " user" : " kernel", 
+				(region.attrib & MEM_ATTRIB_UNCACHED) ? " uncached" : "");
+	}
+	else
+	{
+		printf("0x%08X is not in a known memory region\n", addr);
 	}
 }
 
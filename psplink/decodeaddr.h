@@ -21,11 +21,30 @@
 #define MEM_ATTRIB_HALF  (1 << 4)
 #define MEM_ATTRIB_WORD  (1 << 5)
 #define MEM_ATTRIB_DBL   (1 << 6)
+#define MEM_ATTRIB_USER  (1 << 7)
+#define MEM_ATTRIB_UNCACHED (1 << 8)
+#define MEM_ATTRIB_RWX   (MEM_ATTRIB_READ | MEM_ATTRIB_WRITE | MEM_ATTRIB_EXEC | MEM_ATTRIB_BYTE \
+						 | MEM_ATTRIB_HALF | MEM_ATTRIB_WORD | MEM_ATTRIB_DBL)
 #define MEM_ATTRIB_ALL	 0xFFFFFFFF
 
+/* An entry in the memory region map */
+struct MemRegion
+{
+	u32 addr;
+	u32 size;
+	u32 attrib;
+	/* Sysmem partition id, 0 if not in a partition */
+	int partition;
+	const char *desc;
+};
+
 int memDecode(const char *line, u32 *val);
+void memInvalidateLookups(void);
 int memValidate(u32 addr, u32 attrib);
+int memFindRegion(u32 addr, struct MemRegion *region);
+void memRefreshRegions(void);
 void memPrintRegions(void);
+void memPrintRegion(u32 addr);
 void memSetProtoff(int protoff);
 
 #endif
@@ -66,12 +66,23 @@
 #define VS(op)   ((op >> 8) & 0x7F)
 #define VT(op)   ((op >> 16) & 0x7F)
 
+/* Instruction flags, anything not flagged is worked out from the format */
+/* First operand is an Rt which is read rather than written */
+#define INSTR_RT_SRC  0x01
+/* Writes the return address */
+#define INSTR_LINK    0x02
+/* Branch likely, delay slot is nullified if not taken */
+#define INSTR_LIKELY  0x04
+/* Branch which is always taken */
+#define INSTR_ALWAYS  0x08
+
 struct Instruction
 {
 	const char *name;
 	unsigned int opcode;
 	unsigned int mask;
 	const char *fmt;
+	unsigned int flags;
 };
 
 struct Instruction macro[] = 
@@ -82,15 +93,15 @@ struct Instruction macro[] =
 	{ "li",			0x34000000, 0xFFE00000, "%t, %I"	},
 	{ "move", 		0x00000021, 0xFC1F07FF, "%d, %s"	},
 	{ "move",   	0x00000025, 0xFC1F07FF, "%d, %s"	},
-	{ "b",			0x10000000, 0xFFFF0000, "%O"		},
-	{ "b",			0x04010000, 0xFFFF0000, "%O"		},
-	{ "bal",		0x04110000, 0xFFFF0000, "%O"		},
+	{ "b",			0x10000000, 0xFFFF0000, "%O", INSTR_ALWAYS	},
+	{ "b",			0x04010000, 0xFFFF0000, "%O", INSTR_ALWAYS	},
+	{ "bal",		0x04110000, 0xFFFF0000, "%O", INSTR_ALWAYS | INSTR_LINK	},
 	{ "bnez",		0x14000000, 0xFC1F0000,	"%s, %O"	},
-	{ "bnezl",		0x54000000, 0xFC1F0000,	"%s, %O"	},
+	{ "bnezl",		0x54000000, 0xFC1F0000,	"%s, %O", INSTR_LIKELY	},
 	{ "neg",		0x00000022, 0xFFE007FF,	"%d, %t"	},
 	{ "negu",		0x00000023, 0xFFE007FF,	"%d, %t"	},
 	{ "not",		0x00000027, 0xFC1F07FF,	"%d, %s"	},
-	{ "jalr",		0x0000F809, 0xFC1FFFFF,	"%J"},
+	{ "jalr",		0x0000F809, 0xFC1FFFFF,	"%J", INSTR_LINK},
 };
 
 struct Instruction inst[] = 
@@ -103,27 +114,27 @@ struct Instruction inst[] =
 	{ "and",		0x00000024, 0xFC0007FF,	"%d, %s, %t"},
 	{ "andi",		0x30000000, 0xFC000000,	"%t, %s, %I"},
 	{ "beq",		0x10000000, 0xFC000000,	"%s, %t, %O"},
-	{ "beql",		0x50000000, 0xFC000000,	"%s, %t, %O"},
+	{ "beql",		0x50000000, 0xFC000000,	"%s, %t, %O", INSTR_LIKELY},
 	{ "bgez",		0x04010000, 0xFC1F0000,	"%s, %O"},
-	{ "bgezal",		0x04110000, 0xFC1F0000,	"%s, %0"},
-	{ "bgezl",		0x04030000, 0xFC1F0000,	"%s, %O"},
+	{ "bgezal",		0x04110000, 0xFC1F0000,	"%s, %O", INSTR_LINK},
+	{ "bgezl",		0x04030000, 0xFC1F0000,	"%s, %O", INSTR_LIKELY},
 	{ "bgtz",		0x1C000000, 0xFC1F0000,	"%s, %O"},
-	{ "bgtzl",		0x5C000000, 0xFC1F0000,	"%s, %O"},
+	{ "bgtzl",		0x5C000000, 0xFC1F0000,	"%s, %O", INSTR_LIKELY},
 	{ "bitrev",		0x7C000520, 0xFFE007FF, "%d, %t"},
 	{ "blez",		0x18000000, 0xFC1F0000,	"%s, %O"},
-	{ "blezl",		0x58000000, 0xFC1F0000,	"%s, %O"},
+	{ "blezl",		0x58000000, 0xFC1F0000,	"%s, %O", INSTR_LIKELY},
 	{ "bltz",		0x04000000, 0xFC1F0000,	"%s, %O"},
-	{ "bltzl",		0x04020000, 0xFC1F0000,	"%s, %O"},
-	{ "bltzal",		0x04100000, 0xFC1F0000,	"%s, %O"},
-	{ "bltzall",	0x04120000, 0xFC1F0000,	"%s, %O"},
+	{ "bltzl",		0x04020000, 0xFC1F0000,	"%s, %O", INSTR_LIKELY},
+	{ "bltzal",		0x04100000, 0xFC1F0000,	"%s, %O", INSTR_LINK},
+	{ "bltzall",	0x04120000, 0xFC1F0000,	"%s, %O", INSTR_LINK | INSTR_LIKELY},
 	{ "bne",		0x14000000, 0xFC000000,	"%s, %t, %O"},
-	{ "bnel",		0x54000000, 0xFC000000,	"%s, %t, %O"},
+	{ "bnel",		0x54000000, 0xFC000000,	"%s, %t, %O", INSTR_LIKELY},
 	{ "break",		0x0000000D, 0xFC00003F,	"%c"},
 	{ "cache",		0xbc000000, 0xfc000000, "%k, %o"},
 	{ "cfc0",		0x40400000, 0xFFE007FF,	"%t, %p"},
 	{ "clo",		0x00000017, 0xFC1F07FF, "%d, %s"},
 	{ "clz",		0x00000016, 0xFC1F07FF, "%d, %s"},
-	{ "ctc0",		0x40C00000, 0xFFE007FF,	"%t, %p"},
+	{ "ctc0",		0x40C00000, 0xFFE007FF,	"%t, %p", INSTR_RT_SRC},
 	{ "max",		0x0000002C, 0xFC0007FF, "%d, %s, %t"},
 	{ "min",		0x0000002D, 0xFC0007FF, "%d, %s, %t"},
 	{ "dbreak",		0x7000003F, 0xFFFFFFFF,	""},
@@ -135,13 +146,13 @@ struct Instruction inst[] =
 	{ "ins",		0x7C000004, 0xFC00003F, "%t, %s, %a, %n"},
 	{ "j",			0x08000000, 0xFC000000,	"%j"},
 	{ "jr",			0x00000008, 0xFC1FFFFF,	"%J"},
-	{ "jalr",		0x00000009, 0xFC1F07FF,	"%J, %d"},
-	{ "jal",		0x0C000000, 0xFC000000,	"%j"},
+	{ "jalr",		0x00000009, 0xFC1F07FF,	"%J, %d", INSTR_LINK},
+	{ "jal",		0x0C000000, 0xFC000000,	"%j", INSTR_LINK},
 	{ "lb",			0x80000000, 0xFC000000,	"%t, %o"},
 	{ "lbu",		0x90000000, 0xFC000000,	"%t, %o"},
 	{ "lh",			0x84000000, 0xFC000000,	"%t, %o"},
 	{ "lhu",		0x94000000, 0xFC000000,	"%t, %o"},
-	{ "ll",			0xC0000000, 0xFC000000,	"%t, %O"},
+	{ "ll",			0xC0000000, 0xFC000000,	"%t, %o"},
 	{ "lui",		0x3C000000, 0xFFE00000,	"%t, %I"},
 	{ "lw",			0x8C000000, 0xFC000000,	"%t, %o"},
 	{ "lwl",		0x88000000, 0xFC000000,	"%t, %o"},
@@ -157,9 +168,9 @@ struct Instruction inst[] =
 	{ "movz",		0x0000000A, 0xFC0007FF, "%d, %s, %t"},
 	{ "msub",		0x0000002e, 0xfc00ffff, "%d, %t"},
 	{ "msubu",		0x0000002f, 0xfc00ffff, "%d, %t"},
-	{ "mtc0",		0x40800000, 0xFFE007FF,	"%t, %0"},
-	{ "mtdr",		0x7080003D, 0xFFE007FF,	"%t, %r"},
-	{ "mtic",		0x70000026, 0xFFE007FF, "%t, %p"},
+	{ "mtc0",		0x40800000, 0xFFE007FF,	"%t, %0", INSTR_RT_SRC},
+	{ "mtdr",		0x7080003D, 0xFFE007FF,	"%t, %r", INSTR_RT_SRC},
+	{ "mtic",		0x70000026, 0xFFE007FF, "%t, %p", INSTR_RT_SRC},
 	{ "halt",       0x70000000, 0xFFFFFFFF, "" },
 	{ "mthi",		0x00000011, 0xFC1FFFFF,	"%s"},
 	{ "mtlo",		0x00000013, 0xFC1FFFFF,	"%s"},
@@ -172,8 +183,8 @@ struct Instruction inst[] =
 	{ "rotv",		0x00000046, 0xFC0007FF, "%d, %t, %s"},
 	{ "seb",		0x7C000420, 0xFFE007FF,	"%d, %t"},
 	{ "seh",		0x7C000620, 0xFFE007FF,	"%d, %t"},
-	{ "sb",			0xA0000000, 0xFC000000,	"%t, %o"},
-	{ "sh",			0xA4000000, 0xFC000000,	"%t, %o"},
+	{ "sb",			0xA0000000, 0xFC000000,	"%t, %o", INSTR_RT_SRC},
+	{ "sh",			0xA4000000, 0xFC000000,	"%t, %o", INSTR_RT_SRC},
 	{ "sllv",		0x00000004, 0xFC0007FF,	"%d, %t, %s"},
 	{ "sll",		0x00000000, 0xFFE0003F,	"%d, %t, %a"},
 	{ "slt",		0x0000002A, 0xFC0007FF,	"%d, %s, %t"},
@@ -184,9 +195,9 @@ struct Instruction inst[] =
 	{ "srav",		0x00000007, 0xFC0007FF,	"%d, %t, %s"},
 	{ "srlv",		0x00000006, 0xFC0007FF,	"%d, %t, %s"},
 	{ "srl",		0x00000002, 0xFFE0003F,	"%d, %t, %a"},
-	{ "sw",			0xAC000000, 0xFC000000,	"%t, %o"},
-	{ "swl",		0xA8000000, 0xFC000000,	"%t, %o"},
-	{ "swr",		0xB8000000, 0xFC000000,	"%t, %o"},
+	{ "sw",			0xAC000000, 0xFC000000,	"%t, %o", INSTR_RT_SRC},
+	{ "swl",		0xA8000000, 0xFC000000,	"%t, %o", INSTR_RT_SRC},
+	{ "swr",		0xB8000000, 0xFC000000,	"%t, %o", INSTR_RT_SRC},
 	{ "sub",		0x00000022, 0xFC0007FF,	"%d, %s, %t"},
 	{ "subu",		0x00000023, 0xFC0007FF,	"%d, %s, %t"},
 	{ "sync",		0x0000000F, 0xFFFFFFFF,	""},
@@ -200,9 +211,9 @@ struct Instruction inst[] =
 	{"abs.s",	0x46000005, 0xFFFF003F, "%D, %S"},
 	{"add.s",	0x46000000, 0xFFE0003F,	"%D, %S, %T"},
 	{"bc1f",	0x45000000, 0xFFFF0000,	"%O"},
-	{"bc1fl",	0x45020000, 0xFFFF0000,	"%O"},
+	{"bc1fl",	0x45020000, 0xFFFF0000,	"%O", INSTR_LIKELY},
 	{"bc1t",	0x45010000, 0xFFFF0000,	"%O"},
-	{"bc1tl",	0x45030000, 0xFFFF0000,	"%O"},
+	{"bc1tl",	0x45030000, 0xFFFF0000,	"%O", INSTR_LIKELY},
 	{"c.f.s",	0x46000030, 0xFFE007FF, "%S, %T"},
 	{"c.un.s",	0x46000031, 0xFFE007FF, "%S, %T"},
 	{"c.eq.s",	0x46000032, 0xFFE007FF, "%S, %T"},
@@ -221,7 +232,7 @@ struct Instruction inst[] =
 	{"c.ngt.s",	0x4600003F, 0xFFE007FF, "%S, %T"},
 	{"ceil.w.s",0x4600000E, 0xFFFF003F, "%D, %S"},
 	{"cfc1",	0x44400000, 0xFFE007FF, "%t, %p"},
-	{"ctc1",	0x44c00000, 0xFFE007FF, "%t, %p"},
+	{"ctc1",	0x44c00000, 0xFFE007FF, "%t, %p", INSTR_RT_SRC},
 	{"cvt.s.w",	0x46800020, 0xFFFF003F, "%D, %S"},
 	{"cvt.w.s",	0x46000024, 0xFFFF003F, "%D, %S"},
 	{"div.s",	0x46000003, 0xFFE0003F, "%D, %S, %T"},
@@ -229,7 +240,7 @@ struct Instruction inst[] =
 	{"lwc1",	0xc4000000, 0xFC000000, "%T, %o"},
 	{"mfc1",	0x44000000, 0xFFE007FF, "%t, %1"},
 	{"mov.s",	0x46000006, 0xFFFF003F, "%D, %S"},
-	{"mtc1",	0x44800000, 0xFFE007FF, "%t, %1"},
+	{"mtc1",	0x44800000, 0xFFE007FF, "%t, %1", INSTR_RT_SRC},
 	{"mul.s",	0x46000002, 0xFFE0003F, "%D, %S, %T"},
 	{"neg.s",	0x46000007, 0xFFFF003F, "%D, %S"},
 	{"round.w.s",0x4600000C, 0xFFFF003F,"%D, %S"},
@@ -240,9 +251,9 @@ struct Instruction inst[] =
 	
 	/* VPU instructions */
 	{ "bvf",	 0x49000000, 0xFFE30000, "%Z, %O" },
-	{ "bvfl",	 0x49020000, 0xFFE30000, "%Z, %O" },
+	{ "bvfl",	 0x49020000, 0xFFE30000, "%Z, %O", INSTR_LIKELY },
 	{ "bvt",	 0x49010000, 0xFFE30000, "%Z, %O" },
-	{ "bvtl",	 0x49030000, 0xFFE30000, "%Z, %O" },
+	{ "bvtl",	 0x49030000, 0xFFE30000, "%Z, %O", INSTR_LIKELY },
 	{ "lv.q",	 0xD8000000, 0xFC000002, "%Xq, %Y" },
 	{ "lv.s",	 0xC8000000, 0xFC000000, "%Xs, %Y" },
 	{ "lvl.q",	 0xD4000000, 0xFC000002, "%Xq, %Y" },
@@ -545,9 +556,39 @@ static int g_symaddr = 0;
 static int g_macro = 0;
 static int g_printreal = 0;
 static int g_printregs = 0;
-static int g_regmask = 0;
 static SymResolve g_symresolver = NULL;
 
+/* Decode tree, built on first use from the instruction tables. Each node 
+ * switches on a bit field which every remaining candidate fully decodes,
+ * leaves hold the candidates in table order so the last match still wins */
+#define DECODE_MAX_BITS    6
+#define DECODE_MAX_LEAF    4
+#define DECODE_MAX_NODES   1536
+#define DECODE_MAX_LIST    512
+#define DECODE_MAX_SCRATCH 1024
+
+struct DecodeNode
+{
+	unsigned char shift;
+	/* Width of the field, 0 for a leaf */
+	unsigned char bits;
+	/* Number of candidates in a leaf */
+	unsigned short count;
+	/* First child node, or first candidate for a leaf */
+	unsigned short index;
+};
+
+static struct DecodeNode g_decodenodes[DECODE_MAX_NODES];
+static unsigned short g_decodelist[DECODE_MAX_LIST];
+/* Candidate lists while building, each level is stacked above its parent */
+static unsigned short g_decodescratch[DECODE_MAX_SCRATCH];
+static int g_nodecount = 0;
+static int g_listcount = 0;
+/* Set once disasmInit has built the tree, until then or if it ran out of space we scan linearly */
+static int g_decodetree = 0;
+static int g_macroroot = 0;
+static int g_instroot = 0;
+
 struct DisasmOpt
 {
 	char opt;
@@ -649,7 +690,7 @@ void disasmPrintOpts(void)
 	}
 }
 
-static char *print_cpureg(int reg, char *output)
+static char *print_cpureg(int reg, char *output, unsigned int *regmask)
 {
 	int len;
 
@@ -664,7 +705,7 @@ static char *print_cpureg(int reg, char *output)
 
 	if(g_printregs)
 	{
-		g_regmask |= (1 << reg);
+		*regmask |= (1 << reg);
 	}
 
 	return output + len;
@@ -729,7 +770,7 @@ static char *print_jump(unsigned int addr, char *output)
 	return output + len;
 }
 
-static char *print_ofs(int ofs, int reg, char *output, unsigned int *realregs)
+static char *print_ofs(int ofs, int reg, char *output, unsigned int *realregs, unsigned int *regmask)
 {
 	int len;
 
@@ -751,21 +792,14 @@ static char *print_ofs(int ofs, int reg, char *output, unsigned int *realregs)
 		}
 
 		output += len;
-		output = print_cpureg(reg, output);
+		output = print_cpureg(reg, output, regmask);
 		*output++ = ')';
 	}
 
 	return output;
 }
 
-static char *print_pcofs(int ofs, unsigned int PC, char *output)
-{
-	ofs = (ofs + 1) * 4;
-
-	return print_jump(PC + ofs, output);
-}
-
-static char *print_jumpr(int reg, char *output, unsigned int *realregs)
+static char *print_jumpr(int reg, char *output, unsigned int *realregs, unsigned int *regmask)
 {
 	if((g_printreal) && (realregs))
 	{
@@ -773,7 +807,7 @@ static char *print_jumpr(int reg, char *output, unsigned int *realregs)
 	}
 	else
 	{
-		return print_cpureg(reg, output);
+		return print_cpureg(reg, output, regmask);
 	}
 }
 
@@ -943,81 +977,242 @@ static char *print_vfpureg(int reg, char type, char *output)
 	return output;
 }
 
-static void decode_args(unsigned int opcode, unsigned int PC, const char *fmt, char *output, unsigned int *realregs)
+/* Pull the operands out of the opcode in format order, and work out the register usage */
+static void decode_operands(unsigned int opcode, unsigned int PC, const struct Instruction *ix, struct DisasmResult *res)
 {
+	const char *fmt = ix->fmt;
 	int i = 0;
 	int vmmul = 0;
+	int first = 1;
 
 	while(fmt[i])
 	{
 		if(fmt[i] == '%')
 		{
+			struct DisasmOperand *op;
+
 			i++;
+			if(fmt[i] == 0)
+			{
+				break;
+			}
+
+			if(fmt[i] == '?')
+			{
+				vmmul = 1;
+				i++;
+				continue;
+			}
+
+			if(res->opcount >= DISASM_MAX_OPERANDS)
+			{
+				break;
+			}
+
+			op = &res->ops[res->opcount++];
+			op->type = fmt[i];
+			op->size = 0;
+			op->reg = 0;
+			op->value = 0;
+
 			switch(fmt[i])
 			{
-				case 'd': output = print_cpureg(RD(opcode), output);
+				case 'd': op->reg = RD(opcode);
+						  res->writemask |= (1 << op->reg);
 						  break;
-				case 't': output = print_cpureg(RT(opcode), output);
+				case 't': op->reg = RT(opcode);
+						  if((first) && !(ix->flags & INSTR_RT_SRC))
+						  {
+							  res->writemask |= (1 << op->reg);
+						  }
+						  else
+						  {
+							  res->readmask |= (1 << op->reg);
+						  }
 						  break;
-				case 's': output = print_cpureg(RS(opcode), output);
+				case 's': op->reg = RS(opcode);
+						  res->readmask |= (1 << op->reg);
 						  break;
-				case 'i': output = print_imm(IMM(opcode), output);
+				case 'i': op->value = IMM(opcode);
 						  break;
-				case 'I': output = print_hex(IMMU(opcode), output);
+				case 'I': op->value = IMMU(opcode);
 						  break;
-				case 'o': output = print_ofs(IMM(opcode), RS(opcode), output, realregs);
+				case 'o':
+				case 'V': op->value = IMM(opcode);
+						  op->reg = RS(opcode);
+						  res->readmask |= (1 << op->reg);
 						  break;
-				case 'O': output = print_pcofs(IMM(opcode), PC, output);
+				case 'Y': op->value = IMM(opcode) & ~3;
+						  op->reg = RS(opcode);
+						  res->readmask |= (1 << op->reg);
 						  break;
-				case 'V': output = print_ofs(IMM(opcode), RS(opcode), output, realregs);
+				case 'O': op->value = IMM(opcode);
+						  res->target = PC + ((op->value + 1) * 4);
+						  res->flags |= DISASM_FLAG_BRANCH;
+						  if(!(ix->flags & INSTR_ALWAYS))
+						  {
+							  res->flags |= DISASM_FLAG_COND;
+						  }
 						  break;
-				case 'j': output = print_jump(JUMP(opcode, PC), output);
+				case 'j': op->value = JUMP(opcode, PC);
+						  res->target = op->value;
+						  res->flags |= DISASM_FLAG_JUMP;
 						  break;
-				case 'J': output = print_jumpr(RS(opcode), output, realregs);
+				case 'J': op->reg = RS(opcode);
+						  res->readmask |= (1 << op->reg);
+						  res->flags |= DISASM_FLAG_JUMPREG;
 						  break;
-				case 'a': output = print_int(SA(opcode), output);
+				case 'a': op->value = SA(opcode);
 						  break;
-				case '0': output = print_cop0(RD(opcode), output);
+				case '0':
+				case '1':
+				case 'p':
+				case 'r': op->reg = RD(opcode);
 						  break;
-				case '1': output = print_cop1(RD(opcode), output);
+				case 'k': op->value = RT(opcode);
 						  break;
-				case 'p': *output++ = '$';
-						  output = print_int(RD(opcode), output);
+				case 'D': op->reg = FD(opcode);
 						  break;
-				case 'k': output = print_hex(RT(opcode), output);
+				case 'T': op->reg = FT(opcode);
 						  break;
-				case 'D': output = print_fpureg(FD(opcode), output);
+				case 'S': op->reg = FS(opcode);
 						  break;
-				case 'T': output = print_fpureg(FT(opcode), output);
+				case 'n': op->value = RD(opcode) + 1;
 						  break;
-				case 'S': output = print_fpureg(FS(opcode), output);
+				case 'x': op->reg = VT(opcode);
+						  op->size = fmt[i+1];
 						  break;
-				case 'r': output = print_debugreg(RD(opcode), output);
+				case 'y': op->reg = VS(opcode);
+						  if(vmmul) { if(op->reg & 0x20) { op->reg &= 0x5F; } else { op->reg |= 0x20; } }
+						  op->size = fmt[i+1];
 						  break;
-				case 'n': output = print_int(RD(opcode) + 1, output);
+				case 'z': op->reg = VD(opcode);
+						  op->size = fmt[i+1];
 						  break;
-				case 'x': if(fmt[i+1]) { output = print_vfpureg(VT(opcode), fmt[i+1], output); i++; }break;
-				case 'y': if(fmt[i+1]) { 
-							  int reg = VS(opcode);
-							  if(vmmul) { if(reg & 0x20) { reg &= 0x5F; } else { reg |= 0x20; } }
-							  output = print_vfpureg(reg, fmt[i+1], output); i++; 
-							  }
-							  break;
-				case 'z': if(fmt[i+1]) { output = print_vfpureg(VD(opcode), fmt[i+1], output); i++; }break;
-				case 'v': break;
-				case 'X': if(fmt[i+1]) { output = print_vfpureg(VO(opcode), fmt[i+1], output); i++; }
+				case 'X': op->reg = VO(opcode);
+						  op->size = fmt[i+1];
 						  break;
-				case 'Z': output = print_imm(VCC(opcode), output);
+				case 'Z': op->value = VCC(opcode);
 						  break;
-				case 'c': output = print_hex(CODE(opcode), output);
+				case 'c':
+				case 'C': op->value = CODE(opcode);
 						  break;
-				case 'C': output = print_syscall(CODE(opcode), output);
+				default: break;
+			};
+
+			/* VFPU operands carry their size in the format */
+			if((op->size) && (strchr("xyzX", op->type)))
+			{
+				i++;
+			}
+
+			first = 0;
+			i++;
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	if(ix->flags & INSTR_LINK)
+	{
+		res->flags |= DISASM_FLAG_LINK;
+		/* jalr has an explicit link register, the rest use $ra */
+		if(!(res->writemask & ~1))
+		{
+			res->writemask |= (1 << 31);
+		}
+	}
+
+	if(ix->flags & INSTR_LIKELY)
+	{
+		res->flags |= DISASM_FLAG_LIKELY;
+	}
+
+	/* Writes to $zero go nowhere */
+	res->writemask &= ~1;
+}
+
+/* Print the operands of a decoded instruction following its format */
+static void format_args(const struct DisasmResult *res, const char *fmt, char *output, unsigned int *realregs, unsigned int *regmask)
+{
+	int i = 0;
+	int n = 0;
+
+	while(fmt[i])
+	{
+		if(fmt[i] == '%')
+		{
+			const struct DisasmOperand *op;
+
+			i++;
+			if((fmt[i] == 0) || (fmt[i] == '?'))
+			{
+				if(fmt[i] == 0)
+				{
+					break;
+				}
+				i++;
+				continue;
+			}
+
+			if(n >= res->opcount)
+			{
+				break;
+			}
+
+			op = &res->ops[n++];
+			switch(op->type)
+			{
+				case 'd':
+				case 't':
+				case 's': output = print_cpureg(op->reg, output, regmask);
+						  break;
+				case 'i': output = print_imm(op->value, output);
+						  break;
+				case 'I': output = print_hex(op->value, output);
+						  break;
+				case 'o':
+				case 'V':
+				case 'Y': output = print_ofs(op->value, op->reg, output, realregs, regmask);
+						  break;
+				case 'O': output = print_jump(res->target, output);
+						  break;
+				case 'j': output = print_jump(op->value, output);
+						  break;
+				case 'J': output = print_jumpr(op->reg, output, realregs, regmask);
+						  break;
+				case 'a': output = print_int(op->value, output);
+						  break;
+				case '0': output = print_cop0(op->reg, output);
+						  break;
+				case '1': output = print_cop1(op->reg, output);
+						  break;
+				case 'p': *output++ = '$';
+						  output = print_int(op->reg, output);
+						  break;
+				case 'k': output = print_hex(op->value, output);
+						  break;
+				case 'D':
+				case 'T':
+				case 'S': output = print_fpureg(op->reg, output);
 						  break;
-				case 'Y': output = print_ofs(IMM(opcode) & ~3, RS(opcode), output, realregs);
+				case 'r': output = print_debugreg(op->reg, output);
 						  break;
-				case '?': vmmul = 1;
+				case 'n': output = print_int(op->value, output);
+						  break;
+				case 'x':
+				case 'y':
+				case 'z':
+				case 'X': if(op->size) { output = print_vfpureg(op->reg, op->size, output); i++; }
+						  break;
+				case 'Z': output = print_imm(op->value, output);
+						  break;
+				case 'c': output = print_hex(op->value, output);
+						  break;
+				case 'C': output = print_syscall(op->value, output);
 						  break;
-				case 0: goto end;
 				default: break;
 			};
 			i++;
@@ -1027,69 +1222,335 @@ static void decode_args(unsigned int opcode, unsigned int PC, const char *fmt, c
 			*output++ = fmt[i++];
 		}
 	}
-end:
 
 	*output = 0;
 }
 
-const char *disasmInstruction(unsigned int opcode, unsigned int PC, unsigned int *realregs, unsigned int *regmask)
+/* Find the widest run of set bits in mask, limited to DECODE_MAX_BITS */
+static int decode_field(unsigned int mask, int *shift)
 {
-	static char code[256];
-	char addr[128];
-	int size;
-	int i;
-	struct Instruction *ix = NULL;
+	int best = 0;
+	int i = 0;
 
-	sprintf(addr, "0x%08X", PC);
-	if((g_symresolver) && (g_symaddr))
+	while(i < 32)
 	{
-		char addrtemp[128];
-		/* Symbol resolver shouldn't touch addr unless it finds symbol */
-		if(g_symresolver(PC, addrtemp, sizeof(addrtemp)))
+		int len = 0;
+
+		while(((i + len) < 32) && (mask & (1U << (i + len))))
 		{
-			sprintf(addr, "%-20s", addrtemp);
+			len++;
 		}
+
+		if(len > best)
+		{
+			best = len;
+			*shift = i;
+		}
+
+		i += len + 1;
+	}
+
+	if(best > DECODE_MAX_BITS)
+	{
+		/* Take the top of the run, opcode fields tend to be at the top */
+		*shift += best - DECODE_MAX_BITS;
+		best = DECODE_MAX_BITS;
 	}
 
-	g_regmask = 0;
-	sprintf(code, "%s: %08X - Unknown", addr, opcode);
+	return best;
+}
 
-	if(!g_macro)
+/* Fill in node for the count candidates at the top of the scratch list, returns 0 if out of space */
+static int decode_build(const struct Instruction *table, int node, int start, int count, unsigned int used)
+{
+	unsigned int common = ~used;
+	int bits = 0;
+	int shift = 0;
+	int i;
+
+	for(i = 0; i < count; i++)
 	{
-		size = sizeof(macro) / sizeof(struct Instruction);
-		for(i = 0; i < size; i++)
+		common &= table[g_decodescratch[start + i]].mask;
+	}
+
+	if(count > DECODE_MAX_LEAF)
+	{
+		bits = decode_field(common, &shift);
+	}
+
+	if(bits == 0)
+	{
+		if((g_listcount + count) > DECODE_MAX_LIST)
 		{
-			if((opcode & macro[i].mask) == macro[i].opcode)
+			return 0;
+		}
+
+		g_decodenodes[node].bits = 0;
+		g_decodenodes[node].count = count;
+		g_decodenodes[node].index = g_listcount;
+		memcpy(&g_decodelist[g_listcount], &g_decodescratch[start], count * sizeof(unsigned short));
+		g_listcount += count;
+	}
+	else
+	{
+		unsigned int field;
+		int first;
+
+		if((g_nodecount + (1 << bits)) > DECODE_MAX_NODES)
+		{
+			return 0;
+		}
+
+		first = g_nodecount;
+		g_nodecount += (1 << bits);
+		g_decodenodes[node].shift = shift;
+		g_decodenodes[node].bits = bits;
+		g_decodenodes[node].count = 0;
+		g_decodenodes[node].index = first;
+		used |= ((1 << bits) - 1) << shift;
+
+		for(field = 0; field < (1 << bits); field++)
+		{
+			int subcount = 0;
+
+			if((start + count + count) > DECODE_MAX_SCRATCH)
 			{
-				ix = &macro[i];
+				return 0;
+			}
+
+			/* Copy this field's candidates above ours in the scratch list, keeping the order */
+			for(i = 0; i < count; i++)
+			{
+				unsigned short index = g_decodescratch[start + i];
+
+				if(((table[index].opcode >> shift) & ((1 << bits) - 1)) == field)
+				{
+					g_decodescratch[start + count + subcount++] = index;
+				}
+			}
+
+			if(!decode_build(table, first + field, start + count, subcount, used))
+			{
+				return 0;
 			}
 		}
 	}
 
-	if(!ix)
+	return 1;
+}
+
+/* Returns the root node for the table or -1 */
+static int decode_table(const struct Instruction *table, int size)
+{
+	int root;
+	int i;
+
+	if((size > DECODE_MAX_SCRATCH) || (g_nodecount >= DECODE_MAX_NODES))
+	{
+		return -1;
+	}
+
+	for(i = 0; i < size; i++)
+	{
+		g_decodescratch[i] = i;
+	}
+
+	root = g_nodecount++;
+	if(!decode_build(table, root, 0, size, 0))
+	{
+		return -1;
+	}
+
+	return root;
+}
+
+void disasmInit(void)
+{
+	if(g_decodetree)
+	{
+		return;
+	}
+
+	g_nodecount = 0;
+	g_listcount = 0;
+	g_macroroot = decode_table(macro, sizeof(macro) / sizeof(struct Instruction));
+	g_instroot = decode_table(inst, sizeof(inst) / sizeof(struct Instruction));
+	if((g_macroroot >= 0) && (g_instroot >= 0))
+	{
+		g_decodetree = 1;
+	}
+}
+
+static struct Instruction *decode_find(struct Instruction *table, int size, int root, unsigned int opcode)
+{
+	const struct DecodeNode *node;
+	int i;
+
+	if(!g_decodetree)
 	{
-		size = sizeof(inst) / sizeof(struct Instruction);
+		struct Instruction *ix = NULL;
+
 		for(i = 0; i < size; i++)
 		{
-			if((opcode & inst[i].mask) == inst[i].opcode)
+			if((opcode & table[i].mask) == table[i].opcode)
 			{
-				ix = &inst[i];
+				ix = &table[i];
 			}
 		}
+
+		return ix;
+	}
+
+	node = &g_decodenodes[root];
+	while(node->bits)
+	{
+		node = &g_decodenodes[node->index + ((opcode >> node->shift) & ((1 << node->bits) - 1))];
+	}
+
+	for(i = node->count - 1; i >= 0; i--)
+	{
+		struct Instruction *ix = &table[g_decodelist[node->index + i]];
+
+		if((opcode & ix->mask) == ix->opcode)
+		{
+			return ix;
+		}
 	}
 
+	return NULL;
+}
+
+static const struct Instruction *get_instruction(int id)
+{
+	if(id < 0)
+	{
+		return NULL;
+	}
+
+	if(id & DISASM_ID_MACRO)
+	{
+		id &= ~DISASM_ID_MACRO;
+		if(id < (sizeof(macro) / sizeof(struct Instruction)))
+		{
+			return &macro[id];
+		}
+	}
+	else if(id < (sizeof(inst) / sizeof(struct Instruction)))
+	{
+		return &inst[id];
+	}
+
+	return NULL;
+}
+
+const char *disasmGetName(int id)
+{
+	const struct Instruction *ix;
+
+	ix = get_instruction(id);
 	if(ix)
 	{
-		char args[128];
+		return ix->name;
+	}
+
+	return NULL;
+}
+
+int disasmDecode(unsigned int opcode, unsigned int PC, struct DisasmResult *res)
+{
+	struct Instruction *ix = NULL;
 
-		decode_args(opcode, PC, ix->fmt, args, realregs);
-		sprintf(code, "%s: %08X - %-10s %s", addr, opcode, ix->name, args);
+	memset(res, 0, sizeof(struct DisasmResult));
+	res->opcode = opcode;
+	res->pc = PC;
+	res->id = DISASM_ID_UNKNOWN;
 
-		if(regmask) 
+	if(!g_macro)
+	{
+		ix = decode_find(macro, sizeof(macro) / sizeof(struct Instruction), g_macroroot, opcode);
+		if(ix)
+		{
+			res->id = (ix - macro) | DISASM_ID_MACRO;
+		}
+	}
+
+	if(!ix)
+	{
+		ix = decode_find(inst, sizeof(inst) / sizeof(struct Instruction), g_instroot, opcode);
+		if(ix)
 		{
-			*regmask = g_regmask;
+			res->id = ix - inst;
 		}
 	}
 
-	return code;
+	if(ix == NULL)
+	{
+		return 0;
+	}
+
+	res->name = ix->name;
+	decode_operands(opcode, PC, ix, res);
+
+	return 1;
+}
+
+int disasmRange(const unsigned int *code, unsigned int PC, int count, struct DisasmResult *res)
+{
+	int i;
+
+	for(i = 0; i < count; i++)
+	{
+		disasmDecode(code[i], PC, &res[i]);
+		PC += 4;
+	}
+
+	return i;
+}
+
+const char *disasmFormat(const struct DisasmResult *res, unsigned int *realregs, char *output, unsigned int *regmask)
+{
+	const struct Instruction *ix;
+	char addr[128];
+	unsigned int mask = 0;
+
+	sprintf(addr, "0x%08X", res->pc);
+	if((g_symresolver) && (g_symaddr))
+	{
+		char addrtemp[128];
+		/* Symbol resolver shouldn't touch addr unless it finds symbol */
+		if(g_symresolver(res->pc, addrtemp, sizeof(addrtemp)))
+		{
+			sprintf(addr, "%-20s", addrtemp);
+		}
+	}
+
+	ix = get_instruction(res->id);
+	if(ix)
+	{
+		char args[128];
+
+		format_args(res, ix->fmt, args, realregs, &mask);
+		sprintf(output, "%s: %08X - %-10s %s", addr, res->opcode, ix->name, args);
+	}
+	else
+	{
+		sprintf(output, "%s: %08X - Unknown", addr, res->opcode);
+	}
+
+	if(regmask) 
+	{
+		*regmask = mask;
+	}
+
+	return output;
+}
+
+const char *disasmInstruction(unsigned int opcode, unsigned int PC, unsigned int *realregs, unsigned int *regmask)
+{
+	static char code[DISASM_MAX_TEXT];
+	struct DisasmResult res;
+
+	disasmDecode(opcode, PC, &res);
+
+	return disasmFormat(&res, realregs, code, regmask);
 }
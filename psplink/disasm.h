@@ -35,6 +35,70 @@ const char *disasmGetOpts(void);
 void disasmPrintOpts(void);
 const char *disasmInstruction(unsigned int opcode, unsigned int PC, unsigned int *realregs, unsigned int *regmask);
 
+/* Id of an unrecognised instruction */
+#define DISASM_ID_UNKNOWN   -1
+/* Set in the id of macro instructions */
+#define DISASM_ID_MACRO     0x8000
+
+#define DISASM_MAX_OPERANDS 4
+/* Size of buffer needed by disasmFormat */
+#define DISASM_MAX_TEXT     256
+
+/* Control flow flags */
+/* PC relative branch, target is valid */
+#define DISASM_FLAG_BRANCH  0x01
+/* Absolute jump, target is valid */
+#define DISASM_FLAG_JUMP    0x02
+/* Jump to a register */
+#define DISASM_FLAG_JUMPREG 0x04
+/* Conditional, may fall through */
+#define DISASM_FLAG_COND    0x08
+/* Writes the return address */
+#define DISASM_FLAG_LINK    0x10
+/* Branch likely */
+#define DISASM_FLAG_LIKELY  0x20
+
+struct DisasmOperand
+{
+	/* Format code of the operand (see disasm.c) */
+	char type;
+	/* Size code for VFPU registers */
+	char size;
+	/* Register number, or the base register of a memory offset */
+	short reg;
+	/* Immediate, offset or code value */
+	int value;
+};
+
+struct DisasmResult
+{
+	unsigned int opcode;
+	unsigned int pc;
+	/* Instruction id, DISASM_ID_UNKNOWN if not decoded */
+	int id;
+	const char *name;
+	unsigned int flags;
+	/* Branch or jump target if DISASM_FLAG_BRANCH or DISASM_FLAG_JUMP */
+	unsigned int target;
+	/* CPU registers read and written */
+	unsigned int readmask;
+	unsigned int writemask;
+	int opcount;
+	struct DisasmOperand ops[DISASM_MAX_OPERANDS];
+};
+
+/* Build the decode tables, call once before any threads use the disassembler. Decoding
+ * still works without it, just more slowly */
+void disasmInit(void);
+/* Decode an instruction without formatting it, returns 1 if it was recognised */
+int disasmDecode(unsigned int opcode, unsigned int PC, struct DisasmResult *res);
+/* Decode count words of code starting at PC into res, returns the number decoded */
+int disasmRange(const unsigned int *code, unsigned int PC, int count, struct DisasmResult *res);
+/* Format a decoded instruction into output (DISASM_MAX_TEXT bytes), regmask gets the registers printed */
+const char *disasmFormat(const struct DisasmResult *res, unsigned int *realregs, char *output, unsigned int *regmask);
+/* Get the mnemonic for an instruction id */
+const char *disasmGetName(int id);
+
 /* Symbol resolver function type */
 typedef int (*SymResolve)(unsigned int addr, char *output, int size);
 /* Set the symbol resolver function */
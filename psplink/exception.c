@@ -23,7 +23,7 @@
 #include "sio.h"
 
 struct PsplinkContext *g_currex = NULL;
-struct PsplinkContext *g_list = NULL;
+struct PsplinkContextPool *g_pool = NULL;
 extern struct GlobalContext g_context;
 
 #define MAT_NUM(x) ((x) / 16)
@@ -59,7 +59,7 @@ const char codeDebug[7] = { 'X', 'S', 'B', '?', '?', 'I', 'D' };
 
 int psplinkRegisterExceptions(void *def, void *debug, void *ctx)
 {
-	g_list = ctx;
+	g_pool = ctx;
 	sceKernelRegisterDefaultExceptionHandler(def);
 	sceKernelRegisterPriorityExceptionHandler(24, 1, debug);
 
@@ -164,6 +164,26 @@ static const char *exception_cause(struct PsplinkContext *pCtx)
 	return excause;
 }
 
+/* Get context ex while it is in use, or the current context if ex is out of range */
+static struct PsplinkContext *get_context(int ex)
+{
+	struct PsplinkContext *ctx;
+
+	if((ex < 0) || (ex >= PSPLINK_MAX_CONTEXT))
+	{
+		return g_currex;
+	}
+
+	if((g_pool == NULL) || ((ex / PSPLINK_CONTEXT_CHUNK) >= g_pool->nchunks))
+	{
+		return NULL;
+	}
+
+	ctx = &g_pool->chunks[ex / PSPLINK_CONTEXT_CHUNK][ex % PSPLINK_CONTEXT_CHUNK];
+
+	return ctx->valid ? ctx : NULL;
+}
+
 /* Print the current exception */
 void exceptionPrint(int ex)
 {
@@ -171,19 +191,9 @@ void exceptionPrint(int ex)
 	SceKernelModuleInfo mod;
 	SceKernelThreadInfo thread;
 	u32 addr;
-	struct PsplinkContext *ctx = NULL;
+	struct PsplinkContext *ctx;
 
-	if((ex >= 0) && (ex < PSPLINK_MAX_CONTEXT))
-	{
-		if((g_list) && (g_list[ex].valid))
-		{
-			ctx = &g_list[ex];
-		}
-	}
-	else
-	{
-		ctx = g_currex;
-	}
+	ctx = get_context(ex);
 
 	if(ctx)
 	{
@@ -246,16 +256,20 @@ void exceptionList(void)
 {
 	int i;
 
-	if(g_list)
+	if(g_pool)
 	{
-		for(i = 0; i < PSPLINK_MAX_CONTEXT; i++)
+		for(i = 0; i < (g_pool->nchunks * PSPLINK_CONTEXT_CHUNK); i++)
 		{
-			if(g_list[i].valid)
+			struct PsplinkContext *ctx;
+
+			ctx = get_context(i);
+			if(ctx)
 			{
-				printf("Exception %-2d: EPC 0x%08X, Cause %s\n", i, g_list[i].regs.epc, 
-						exception_cause(&g_list[i]));
+				printf("Exception %-3d: EPC 0x%08X, Thread 0x%08X, Cause %s\n", i, ctx->regs.epc, 
+						ctx->thid, exception_cause(ctx));
 			}
 		}
+		printf("%d of %d contexts free\n", g_pool->nfree, g_pool->nchunks * PSPLINK_CONTEXT_CHUNK);
 	}
 	else
 	{
@@ -282,19 +296,9 @@ void exceptionPrintFPURegs(float *pFpu, unsigned int fsr, unsigned int fir)
 
 void exceptionFpuPrint(int ex)
 {
-	struct PsplinkContext *ctx = NULL;
+	struct PsplinkContext *ctx;
 
-	if((ex >= 0) && (ex < PSPLINK_MAX_CONTEXT))
-	{
-		if((g_list) && (g_list[ex].valid))
-		{
-			ctx = &g_list[ex];
-		}
-	}
-	else
-	{
-		ctx = g_currex;
-	}
+	ctx = get_context(ex);
 
 	if(ctx)
 	{
@@ -396,19 +400,9 @@ void exceptionPrintVFPURegs(float *pFpu, int mode)
 
 void exceptionVfpuPrint(int ex, int mode)
 {
-	struct PsplinkContext *ctx = NULL;
+	struct PsplinkContext *ctx;
 
-	if((ex >= 0) && (ex < PSPLINK_MAX_CONTEXT))
-	{
-		if((g_list) && (g_list[ex].valid))
-		{
-			ctx = &g_list[ex];
-		}
-	}
-	else
-	{
-		ctx = g_currex;
-	}
+	ctx = get_context(ex);
 
 	if(ctx)
 	{
@@ -452,16 +446,27 @@ void psplinkHandleException(struct PsplinkContext *ctx)
 {
 	u32 k1;
 	int intex;
+	int ret;
+	struct PsplinkContext *oldex;
 
 	k1 = psplinkSetK1(0);
 
+	oldex = g_currex;
 	g_currex = ctx;
 
 	/* If this was not an exception caused by us then just dump the registers to screen */
-	if(!debugHandleException(&g_currex->regs))
+	ret = debugHandleException(ctx);
+	if(ret == 0)
 	{
 		exceptionPrint(-1);
 	}
+	else if(ret == 2)
+	{
+		/* Breakpoint we are not stopping on, return straight to the thread */
+		g_currex = oldex;
+		psplinkSetK1(k1);
+		return;
+	}
 
 	psplinkSetK1(k1);
 
@@ -471,6 +476,7 @@ void psplinkHandleException(struct PsplinkContext *ctx)
 	if(!intex)
 	{
 		/* Sleep thread */
+		ctx->parked = 1;
 		sceKernelSleepThread();
 	}
 }
@@ -479,18 +485,51 @@ void exceptionResume(void)
 {
 	if(g_currex)
 	{
+		g_currex->parked = 0;
 		sceKernelWakeupThread(g_currex->thid);
 		g_currex = NULL;
 	}
 }
 
+/* Wake every parked thread in one pass, each puts its own context back on the free list
+ * as it resumes */
+int exceptionResumeAll(void)
+{
+	int count = 0;
+	int i;
+
+	if(g_pool == NULL)
+	{
+		return 0;
+	}
+
+	for(i = 0; i < (g_pool->nchunks * PSPLINK_CONTEXT_CHUNK); i++)
+	{
+		struct PsplinkContext *ctx;
+
+		ctx = get_context(i);
+		if((ctx) && (ctx->parked))
+		{
+			ctx->parked = 0;
+			sceKernelWakeupThread(ctx->thid);
+			count++;
+		}
+	}
+	g_currex = NULL;
+
+	return count;
+}
+
 void exceptionSetCtx(int ex)
 {
+	struct PsplinkContext *ctx;
+
 	if((ex >= 0) && (ex < PSPLINK_MAX_CONTEXT))
 	{
-		if((g_list) && (g_list[ex].valid))
+		ctx = get_context(ex);
+		if(ctx)
 		{
-			g_currex = &g_list[ex];
+			g_currex = ctx;
 		}
 	}
 }
@@ -18,6 +18,7 @@ void exceptionFpuPrint(int ex);
 void exceptionVfpuPrint(int ex, int mode);
 u32 *exceptionGetReg(const char *reg);
 void exceptionResume(void);
+int exceptionResumeAll(void);
 void exceptionPrintFPURegs(float *pFpu, unsigned int fsr, unsigned int fir);
 void exceptionPrintCPURegs(u32 *pRegs);
 void exceptionList(void);
@@ -38,6 +38,7 @@
 #include "disasm.h"
 #include "symbols.h"
 #include "libs.h"
+#include "decodeaddr.h"
 
 PSP_MODULE_INFO("PSPLINK", 0x1000, 1, 1);
 
@@ -333,8 +334,11 @@ void initialise(SceSize args, void *argp)
 	struct SavedContext *save = (struct SavedContext *) SAVED_ADDR;
 
 	map_firmwarerev();
+	memRefreshRegions();
 	memset(&g_context, 0, sizeof(g_context));
 	exceptionInit();
+	disasmInit();
+	symbolInit();
 	g_context.netshelluid = -1;
 	g_context.conshelluid = -1;
 	g_context.thevent = -1;
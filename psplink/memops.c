@@ -0,0 +1,211 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * memops.c - PSPLINK large block memory fill and copy
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+#include <pspkernel.h>
+#include <psputilsforkernel.h>
+#include <stdio.h>
+#include <string.h>
+#include "util.h"
+#include "libs.h"
+#include "memops.h"
+
+/* Copies smaller than this are not worth the cache maintenance a DMA needs */
+#define MEMCOPY_DMA_MIN   (16*1024)
+#define MEMCOPY_DMA_CHUNK (1024*1024)
+
+static void store_width(u32 addr, u32 val, int width)
+{
+	switch(width)
+	{
+		case 1: _sb(val, addr);
+				break;
+		case 2: _sh(val, addr);
+				break;
+		default: _sw(val, addr);
+				 break;
+	};
+}
+
+/* Fill size bytes with val as bytes, halves or words, addr must be aligned to width */
+void memFill(u32 addr, u32 size, u32 val, int width)
+{
+	u32 start = addr;
+	u32 pattern;
+	u32 *p;
+
+	switch(width)
+	{
+		case 1: pattern = (val & 0xFF) * 0x01010101;
+				break;
+		case 2: pattern = (val & 0xFFFF) * 0x00010001;
+				break;
+		default: pattern = val;
+				 width = 4;
+				 break;
+	};
+
+	size -= size % width;
+	while((addr & 3) && (size > 0))
+	{
+		store_width(addr, val, width);
+		addr += width;
+		size -= width;
+	}
+
+	/* A cache line of word stores at a time */
+	p = (u32 *) addr;
+	while(size >= 64)
+	{
+		p[0] = pattern; p[1] = pattern; p[2] = pattern; p[3] = pattern;
+		p[4] = pattern; p[5] = pattern; p[6] = pattern; p[7] = pattern;
+		p[8] = pattern; p[9] = pattern; p[10] = pattern; p[11] = pattern;
+		p[12] = pattern; p[13] = pattern; p[14] = pattern; p[15] = pattern;
+		p += 16;
+		size -= 64;
+	}
+
+	while(size >= 4)
+	{
+		*p++ = pattern;
+		size -= 4;
+	}
+
+	addr = (u32) p;
+	while(size > 0)
+	{
+		store_width(addr, val, width);
+		addr += width;
+		size -= width;
+	}
+
+	/* So the GE and other bus masters see the result */
+	sceKernelDcacheWritebackRange((void *) start, addr - start);
+}
+
+/* Copy with word loads and stores when both sides are aligned and a forward copy is safe */
+static void cpu_copy(u32 dest, u32 src, u32 size)
+{
+	const u32 *s;
+	u32 *d;
+
+	if((((dest | src) & 3) != 0) || ((dest > src) && (dest < (src + size))))
+	{
+		memmove((void *) dest, (void *) src, size);
+		return;
+	}
+
+	s = (const u32 *) src;
+	d = (u32 *) dest;
+	while(size >= 16)
+	{
+		u32 a = s[0];
+		u32 b = s[1];
+		u32 c = s[2];
+		u32 e = s[3];
+
+		d[0] = a;
+		d[1] = b;
+		d[2] = c;
+		d[3] = e;
+		s += 4;
+		d += 4;
+		size -= 16;
+	}
+
+	memmove(d, s, size);
+}
+
+/* Main RAM and VRAM can be reached by the DMA controller, scratchpad cannot */
+static int dma_capable(u32 addr, u32 size)
+{
+	u32 phys = addr & 0x1FFFFFFF;
+
+	if((phys >= 0x08000000) && (phys < 0x0C000000))
+	{
+		return size <= (0x0C000000 - phys);
+	}
+
+	if((phys >= 0x04000000) && (phys < 0x04200000))
+	{
+		return size <= (0x04200000 - phys);
+	}
+
+	return 0;
+}
+
+/* The cached, uncached and kernel views of memory are aliases, so compare physical addresses */
+static int mem_overlap(u32 dest, u32 src, u32 size)
+{
+	u32 pdest = dest & 0x1FFFFFFF;
+	u32 psrc = src & 0x1FFFFFFF;
+
+	return ((pdest + size) > psrc) && ((psrc + size) > pdest);
+}
+
+static int dma_copy(u32 dest, u32 src, u32 size)
+{
+	int (*dmacmemcpy)(void *dest, const void *src, SceSize size);
+	u32 done;
+
+	/* sceDmacMemcpy */
+	dmacmemcpy = (void *) libsFindExportByNid(refer_module_by_name("sceDMAManager", NULL), "sceDmac", 0x617F3FE6);
+	if(dmacmemcpy == NULL)
+	{
+		return 0;
+	}
+
+	/* The source must be in memory and the destination must not have lines in the cache
+	 * which could later be written back over the copy */
+	sceKernelDcacheWritebackRange((void *) src, size);
+	sceKernelDcacheWritebackInvalidateRange((void *) dest, size);
+
+	for(done = 0; done < size; done += MEMCOPY_DMA_CHUNK)
+	{
+		u32 len;
+
+		len = (size - done) > MEMCOPY_DMA_CHUNK ? MEMCOPY_DMA_CHUNK : (size - done);
+		if(dmacmemcpy((void *) (dest + done), (void *) (src + done), len) < 0)
+		{
+			/* Nothing has been read back into the cache, so the CPU can finish off */
+			cpu_copy(dest + done, src + done, size - done);
+			sceKernelDcacheWritebackRange((void *) (dest + done), size - done);
+			break;
+		}
+	}
+
+	return 1;
+}
+
+/* Copy memory, large word aligned copies which do not overlap go through the DMA controller.
+ * Returns 1 if the DMA controller was used */
+int memCopy(u32 dest, u32 src, u32 size)
+{
+	u32 head;
+
+	if((size >= MEMCOPY_DMA_MIN) && (((dest | src) & 3) == 0)
+			&& (dma_capable(dest, size)) && (dma_capable(src, size))
+			&& (!mem_overlap(dest, src, size)))
+	{
+		head = size & ~3;
+		if(dma_copy(dest, src, head))
+		{
+			cpu_copy(dest + head, src + head, size - head);
+			sceKernelDcacheWritebackRange((void *) (dest + head), size - head);
+			return 1;
+		}
+	}
+
+	cpu_copy(dest, src, size);
+	sceKernelDcacheWritebackRange((void *) dest, size);
+
+	return 0;
+}
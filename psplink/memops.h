@@ -0,0 +1,20 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * memops.h - PSPLINK large block memory fill and copy
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+
+#ifndef __MEMOPS_H__
+#define __MEMOPS_H__
+
+void memFill(u32 addr, u32 size, u32 val, int width);
+int memCopy(u32 dest, u32 src, u32 size);
+
+#endif
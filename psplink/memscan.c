@@ -0,0 +1,379 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * memscan.c - PSPLINK incremental memory value scanner
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+#include <pspkernel.h>
+#include <pspsysmem_kernel.h>
+#include <stdio.h>
+#include <string.h>
+#include "memscan.h"
+
+#define SCAN_PARTITION 1
+
+/* The candidates, either a bitmap over every slot of the region or a sorted list of
+ * slot indexes, whichever is smaller. values holds the previous value of each candidate
+ * in slot order, or is NULL when they all had the value in uniform */
+struct ScanSet
+{
+	SceUID block;
+	int bitmap;
+	u32 *slots;
+	void *values;
+	u32 uniform;
+	int count;
+};
+
+static struct ScanSet g_scan = { -1, 0, NULL, NULL, 0, 0 };
+static u32 g_scanaddr = 0;
+static u32 g_scanslots = 0;
+/* Size of each value in bytes, 0 when no scan is in progress */
+static int g_scanwidth = 0;
+
+static u32 read_value(const void *base, int index)
+{
+	switch(g_scanwidth)
+	{
+		case 1: return ((const u8 *) base)[index];
+		case 2: return ((const u16 *) base)[index];
+		default: return ((const u32 *) base)[index];
+	};
+}
+
+static void write_value(void *base, int index, u32 val)
+{
+	switch(g_scanwidth)
+	{
+		case 1: ((u8 *) base)[index] = val;
+				break;
+		case 2: ((u16 *) base)[index] = val;
+				break;
+		default: ((u32 *) base)[index] = val;
+				 break;
+	};
+}
+
+static u32 bitmap_words(void)
+{
+	return (g_scanslots + 31) / 32;
+}
+
+static int set_alloc(struct ScanSet *set, int bitmap, int count, int values)
+{
+	u32 size;
+
+	memset(set, 0, sizeof(struct ScanSet));
+	set->block = -1;
+	set->bitmap = bitmap;
+
+	size = bitmap ? (bitmap_words() * sizeof(u32)) : (count * sizeof(u32));
+	if(values)
+	{
+		size += count * g_scanwidth;
+	}
+
+	if(size == 0)
+	{
+		return 1;
+	}
+
+	set->block = sceKernelAllocPartitionMemory(SCAN_PARTITION, "MemScan", PSP_SMEM_Low, size, NULL);
+	if(set->block < 0)
+	{
+		return 0;
+	}
+
+	set->slots = sceKernelGetBlockHeadAddr(set->block);
+	if(bitmap)
+	{
+		memset(set->slots, 0, bitmap_words() * sizeof(u32));
+	}
+
+	if(values)
+	{
+		set->values = set->slots + (bitmap ? bitmap_words() : count);
+	}
+
+	return 1;
+}
+
+static void set_free(struct ScanSet *set)
+{
+	if(set->block >= 0)
+	{
+		sceKernelFreePartitionMemory(set->block);
+	}
+	set->block = -1;
+	set->slots = NULL;
+	set->values = NULL;
+	set->count = 0;
+}
+
+static void set_add(struct ScanSet *set, u32 slot, u32 val)
+{
+	if(set->bitmap)
+	{
+		set->slots[slot >> 5] |= 1 << (slot & 31);
+	}
+	else
+	{
+		set->slots[set->count] = slot;
+	}
+
+	if(set->values)
+	{
+		write_value(set->values, set->count, val);
+	}
+	set->count++;
+}
+
+/* Get the slot of candidate index, the bitmap is walked from cursor which must start at 0 */
+static int set_next(const struct ScanSet *set, int index, u32 *cursor, u32 *slot)
+{
+	u32 s;
+	u32 bits;
+
+	if(index >= set->count)
+	{
+		return 0;
+	}
+
+	if(!set->bitmap)
+	{
+		*slot = set->slots[index];
+		return 1;
+	}
+
+	s = *cursor;
+	while((bits = set->slots[s >> 5] >> (s & 31)) == 0)
+	{
+		s = (s | 31) + 1;
+	}
+
+	while((bits & 1) == 0)
+	{
+		bits >>= 1;
+		s++;
+	}
+
+	*slot = s;
+	*cursor = s + 1;
+
+	return 1;
+}
+
+/* Switch a bitmap to a list once the list would be smaller */
+static void set_compact(struct ScanSet *set)
+{
+	struct ScanSet list;
+	u32 cursor = 0;
+	u32 slot;
+	int i;
+
+	if((!set->bitmap) || (set->count >= bitmap_words()))
+	{
+		return;
+	}
+
+	if(!set_alloc(&list, 0, set->count, set->values != NULL))
+	{
+		/* Keep the bitmap */
+		return;
+	}
+
+	list.uniform = set->uniform;
+	for(i = 0; set_next(set, i, &cursor, &slot); i++)
+	{
+		set_add(&list, slot, set->values ? read_value(set->values, i) : 0);
+	}
+
+	set_free(set);
+	*set = list;
+}
+
+static int scan_test(enum MemScanCond cond, u32 cur, u32 prev, u32 val)
+{
+	switch(cond)
+	{
+		case MEMSCAN_CHANGED: return cur != prev;
+		case MEMSCAN_UNCHANGED: return cur == prev;
+		case MEMSCAN_INCREASED: return cur > prev;
+		case MEMSCAN_DECREASED: return cur < prev;
+		case MEMSCAN_EQUAL: return cur == val;
+		case MEMSCAN_NOTEQUAL: return cur != val;
+		case MEMSCAN_GREATER: return cur > val;
+		case MEMSCAN_LESS: return cur < val;
+		default: return 0;
+	};
+}
+
+int memScanFirst(u32 addr, u32 size, int width, const u32 *val)
+{
+	const void *base;
+	u32 aligned;
+	u32 slot;
+	int count;
+
+	memScanReset();
+
+	if((width != 1) && (width != 2) && (width != 4))
+	{
+		printf("Error invalid scan width %d\n", width);
+		return -1;
+	}
+
+	aligned = (addr + width - 1) & ~(width - 1);
+	if((aligned - addr) >= size)
+	{
+		printf("Error scan region too small\n");
+		return -1;
+	}
+
+	g_scanwidth = width;
+	g_scanaddr = aligned;
+	g_scanslots = (size - (aligned - addr)) / width;
+	base = (const void *) g_scanaddr;
+
+	if(val == NULL)
+	{
+		/* Unknown value, every slot is a candidate and needs its value kept */
+		if(!set_alloc(&g_scan, 1, g_scanslots, 1))
+		{
+			printf("Error could not allocate scan memory, use a smaller region or a first value\n");
+			g_scanwidth = 0;
+			return -1;
+		}
+
+		for(slot = 0; slot < g_scanslots; slot++)
+		{
+			set_add(&g_scan, slot, read_value(base, slot));
+		}
+	}
+	else
+	{
+		/* Count first so the smaller representation can be picked, no values are needed
+		 * as every candidate has the first value */
+		count = 0;
+		for(slot = 0; slot < g_scanslots; slot++)
+		{
+			if(read_value(base, slot) == *val)
+			{
+				count++;
+			}
+		}
+
+		if(!set_alloc(&g_scan, (u32) count >= bitmap_words(), count, 0))
+		{
+			printf("Error could not allocate scan memory for %d candidates\n", count);
+			g_scanwidth = 0;
+			return -1;
+		}
+
+		g_scan.uniform = *val;
+		for(slot = 0; slot < g_scanslots; slot++)
+		{
+			/* Memory may have changed since counting, a list cannot grow */
+			if((read_value(base, slot) == *val) && ((g_scan.bitmap) || (g_scan.count < count)))
+			{
+				set_add(&g_scan, slot, *val);
+			}
+		}
+	}
+
+	set_compact(&g_scan);
+
+	return g_scan.count;
+}
+
+int memScanNext(enum MemScanCond cond, u32 val)
+{
+	struct ScanSet next;
+	const void *base;
+	u32 cursor = 0;
+	u32 slot;
+	int values;
+	int i;
+
+	if(g_scanwidth == 0)
+	{
+		printf("Error no scan in progress\n");
+		return -1;
+	}
+
+	/* Survivors of an equal scan all have the same value, as do unchanged uniform ones */
+	values = (cond != MEMSCAN_EQUAL) && ((cond != MEMSCAN_UNCHANGED) || (g_scan.values != NULL));
+	if(!set_alloc(&next, g_scan.bitmap, g_scan.count, values))
+	{
+		printf("Error could not allocate scan memory for %d candidates\n", g_scan.count);
+		return -1;
+	}
+
+	next.uniform = (cond == MEMSCAN_EQUAL) ? val : g_scan.uniform;
+	base = (const void *) g_scanaddr;
+	for(i = 0; set_next(&g_scan, i, &cursor, &slot); i++)
+	{
+		u32 cur;
+		u32 prev;
+
+		cur = read_value(base, slot);
+		prev = g_scan.values ? read_value(g_scan.values, i) : g_scan.uniform;
+		if(scan_test(cond, cur, prev, val))
+		{
+			set_add(&next, slot, cur);
+		}
+	}
+
+	set_free(&g_scan);
+	g_scan = next;
+	set_compact(&g_scan);
+
+	return g_scan.count;
+}
+
+int memScanCount(void)
+{
+	return g_scanwidth ? g_scan.count : 0;
+}
+
+int memScanWidth(void)
+{
+	return g_scanwidth;
+}
+
+int memScanGet(int start, u32 *addrs, u32 *prev, int max)
+{
+	u32 cursor = 0;
+	u32 slot;
+	int count = 0;
+	int i;
+
+	if(g_scanwidth == 0)
+	{
+		return 0;
+	}
+
+	for(i = 0; (count < max) && (set_next(&g_scan, i, &cursor, &slot)); i++)
+	{
+		if(i >= start)
+		{
+			addrs[count] = g_scanaddr + (slot * g_scanwidth);
+			prev[count] = g_scan.values ? read_value(g_scan.values, i) : g_scan.uniform;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+void memScanReset(void)
+{
+	set_free(&g_scan);
+	g_scanwidth = 0;
+}
@@ -0,0 +1,37 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * memscan.h - PSPLINK incremental memory value scanner
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+
+#ifndef __MEMSCAN_H__
+#define __MEMSCAN_H__
+
+/* Conditions for a next scan, the first four compare against the previous value */
+enum MemScanCond
+{
+	MEMSCAN_CHANGED,
+	MEMSCAN_UNCHANGED,
+	MEMSCAN_INCREASED,
+	MEMSCAN_DECREASED,
+	MEMSCAN_EQUAL,
+	MEMSCAN_NOTEQUAL,
+	MEMSCAN_GREATER,
+	MEMSCAN_LESS,
+};
+
+int memScanFirst(u32 addr, u32 size, int width, const u32 *val);
+int memScanNext(enum MemScanCond cond, u32 val);
+int memScanCount(void);
+int memScanWidth(void);
+int memScanGet(int start, u32 *addrs, u32 *prev, int max);
+void memScanReset(void);
+
+#endif
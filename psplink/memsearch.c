@@ -0,0 +1,727 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * memsearch.c - PSPLINK memory search functions
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+
+#include <pspkernel.h>
+#include <pspsysmem_kernel.h>
+#include <stdio.h>
+#include <string.h>
+#include "memsearch.h"
+#include "util.h"
+
+/* Lets gcc use lwl/lwr for loads which may not be aligned */
+struct unaligned_u32
+{
+	u32 val;
+} __attribute__((packed));
+
+#define LOAD_U32(p) (((const struct unaligned_u32 *) (p))->val)
+
+int memSearchInit(struct MemSearch *search, const void *pattern, const void *mask, int len, int align)
+{
+	unsigned char *p;
+	unsigned char *m;
+	int i;
+	int c;
+
+	if((len <= 0) || (len > MEMSEARCH_MAX_PATTERN) || ((align != 1) && (align != 2) && (align != 4)))
+	{
+		return 0;
+	}
+
+	memset(search, 0, sizeof(struct MemSearch));
+	p = (unsigned char *) search->pattern;
+	m = (unsigned char *) search->mask;
+	memcpy(p, pattern, len);
+	if(mask)
+	{
+		memcpy(m, mask, len);
+		search->masked = 1;
+	}
+	else
+	{
+		memset(m, 0xFF, len);
+	}
+	search->len = len;
+	search->align = align;
+
+	/* Shift so the last byte of the window lines up with the last place in the
+	 * pattern (excluding the end) it could match, masked bytes match many values */
+	memset(search->skip, len, sizeof(search->skip));
+	for(i = 0; i < (len - 1); i++)
+	{
+		if(m[i] == 0xFF)
+		{
+			search->skip[p[i]] = len - 1 - i;
+		}
+		else
+		{
+			for(c = 0; c < 256; c++)
+			{
+				if((c & m[i]) == p[i])
+				{
+					search->skip[c] = len - 1 - i;
+				}
+			}
+		}
+	}
+
+	return 1;
+}
+
+/* Compare (data & mask) with pattern a word at a time, then the tail */
+static int match_masked(const unsigned char *data, const u32 *pattern, const u32 *mask, int len)
+{
+	const unsigned char *p;
+	const unsigned char *m;
+	int i;
+
+	for(i = 0; (i + 4) <= len; i += 4)
+	{
+		if((LOAD_U32(&data[i]) & mask[i / 4]) != pattern[i / 4])
+		{
+			return 0;
+		}
+	}
+
+	p = (const unsigned char *) pattern;
+	m = (const unsigned char *) mask;
+	for(; i < len; i++)
+	{
+		if((data[i] & m[i]) != p[i])
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int match_at(const struct MemSearch *search, const unsigned char *data)
+{
+	if(!search->masked)
+	{
+		return memcmp(data, search->pattern, search->len) == 0;
+	}
+
+	return match_masked(data, search->pattern, search->mask, search->len);
+}
+
+/* Boyer-Moore-Horspool over every byte offset */
+static int search_bytes(const struct MemSearch *search, const unsigned char *data, const unsigned char *end, 
+		u32 *results, int max, u32 *next)
+{
+	const unsigned char *p = (const unsigned char *) search->pattern;
+	const unsigned char *m = (const unsigned char *) search->mask;
+	unsigned char last = p[search->len - 1];
+	unsigned char lastmask = m[search->len - 1];
+	int last_pos = search->len - 1;
+	int count = 0;
+
+	end -= search->len;
+	while(data <= end)
+	{
+		unsigned char c = data[last_pos];
+
+		if(((c & lastmask) == last) && (match_at(search, data)))
+		{
+			results[count++] = (u32) data;
+			if(count == max)
+			{
+				*next = (u32) data + 1;
+				break;
+			}
+		}
+
+		data += search->skip[c];
+	}
+
+	return count;
+}
+
+/* Aligned search, filtering on the first word, half word or byte of the pattern */
+static int search_aligned(const struct MemSearch *search, const unsigned char *data, const unsigned char *end, 
+		u32 *results, int max, u32 *next)
+{
+	u32 first;
+	u32 firstmask;
+	int width;
+	int count = 0;
+
+	data = (const unsigned char *) (((u32) data + search->align - 1) & ~(search->align - 1));
+	end -= search->len;
+
+	width = search->len >= 4 ? search->align : search->len >= 2 ? 2 : 1;
+	if(width == 4)
+	{
+		first = search->pattern[0];
+		firstmask = search->mask[0];
+	}
+	else if(width == 2)
+	{
+		/* The first half word is the low half of the first word, we are little endian */
+		first = search->pattern[0] & 0xFFFF;
+		firstmask = search->mask[0] & 0xFFFF;
+	}
+	else
+	{
+		first = *((const unsigned char *) search->pattern);
+		firstmask = *((const unsigned char *) search->mask);
+	}
+
+	for(; data <= end; data += search->align)
+	{
+		u32 val;
+
+		if(width == 4)
+		{
+			val = *((const u32 *) data);
+		}
+		else if(width == 2)
+		{
+			val = *((const u16 *) data);
+		}
+		else
+		{
+			val = *data;
+		}
+
+		if(((val & firstmask) == first) && (match_at(search, data)))
+		{
+			results[count++] = (u32) data;
+			if(count == max)
+			{
+				*next = (u32) data + search->align;
+				break;
+			}
+		}
+	}
+
+	return count;
+}
+
+/* Search size bytes from addr, storing up to max match addresses in results. If
+ * the buffer fills, next is set to where to carry on, otherwise to the end */
+int memSearch(const struct MemSearch *search, u32 addr, u32 size, u32 *results, int max, u32 *next)
+{
+	const unsigned char *data = (const unsigned char *) addr;
+	const unsigned char *end = data + size;
+
+	*next = addr + size;
+	if((max <= 0) || (size < search->len))
+	{
+		return 0;
+	}
+
+	if(search->align == 1)
+	{
+		return search_bytes(search, data, end, results, max, next);
+	}
+
+	return search_aligned(search, data, end, results, max, next);
+}
+
+/* Signatures are found with an Aho-Corasick automaton built over the longest run
+ * of fully masked bytes in each one (its anchor), each anchor hit is then checked
+ * against the whole signature with its mask */
+#define SIG_ANCHOR_MAX 16
+#define SIG_LINE_MAX   512
+
+struct SigEntry
+{
+	char name[MEMSIG_MAX_NAME];
+	int len;
+	/* Offset and length of the anchor */
+	int anchor;
+	int anchorlen;
+	/* Next signature with an anchor ending on the same node, plus one */
+	int next;
+	u32 pattern[MEMSIG_MAX_PATTERN / 4];
+	u32 mask[MEMSIG_MAX_PATTERN / 4];
+};
+
+struct SigNode
+{
+	/* Indexes of first child, next sibling, failure node and next node down the
+	 * failure chain which has output, 0 being the root */
+	unsigned short child;
+	unsigned short sibling;
+	unsigned short fail;
+	unsigned short dict;
+	/* First signature ending here, plus one */
+	unsigned short out;
+	unsigned char ch;
+};
+
+struct MemSigSet
+{
+	SceUID block;
+	int nsigs;
+	int nnodes;
+	struct SigEntry *sigs;
+	struct SigNode *nodes;
+	/* Transitions from the root are looked up directly */
+	unsigned short root[256];
+};
+
+static int sig_line(char *line, char **fields, int max)
+{
+	int count = 0;
+
+	while(*line)
+	{
+		while(is_aspace(*line))
+		{
+			*line++ = 0;
+		}
+
+		if((*line == 0) || (*line == '#'))
+		{
+			*line = 0;
+			break;
+		}
+
+		if(count == max)
+		{
+			return -1;
+		}
+
+		fields[count++] = line;
+		while((*line) && (!is_aspace(*line)))
+		{
+			line++;
+		}
+	}
+
+	return count;
+}
+
+/* Decode a hex string where ?? matches any byte */
+static int sig_hex(const char *str, unsigned char *data, unsigned char *mask)
+{
+	int len = 0;
+
+	while(str[0] && str[1])
+	{
+		if(len == MEMSIG_MAX_PATTERN)
+		{
+			return 0;
+		}
+
+		if((str[0] == '?') && (str[1] == '?'))
+		{
+			data[len] = 0;
+			mask[len] = 0;
+		}
+		else if((is_hex(str[0])) && (is_hex(str[1])))
+		{
+			data[len] = (hex_to_int(str[0]) << 4) | hex_to_int(str[1]);
+			mask[len] = 0xFF;
+		}
+		else
+		{
+			return 0;
+		}
+
+		len++;
+		str += 2;
+	}
+
+	return str[0] ? 0 : len;
+}
+
+static int sig_parse(char *line, struct SigEntry *sig)
+{
+	char *fields[3];
+	unsigned char data[MEMSIG_MAX_PATTERN];
+	unsigned char mask[MEMSIG_MAX_PATTERN];
+	unsigned char extra[MEMSIG_MAX_PATTERN];
+	int count;
+	int len;
+	int run;
+	int i;
+
+	count = sig_line(line, fields, 3);
+	if(count < 2)
+	{
+		return 0;
+	}
+
+	len = sig_hex(fields[1], data, mask);
+	if(len == 0)
+	{
+		return 0;
+	}
+
+	if(count == 3)
+	{
+		if(sig_hex(fields[2], extra, mask) != len)
+		{
+			return 0;
+		}
+
+		/* Pattern bits outside the mask can never match */
+		for(i = 0; i < len; i++)
+		{
+			mask[i] = extra[i];
+			data[i] &= mask[i];
+		}
+	}
+
+	memset(sig, 0, sizeof(struct SigEntry));
+	strncpy(sig->name, fields[0], MEMSIG_MAX_NAME - 1);
+	sig->len = len;
+
+	/* Pick the longest run of fully masked bytes as the anchor */
+	run = 0;
+	for(i = 0; i < len; i++)
+	{
+		run = (mask[i] == 0xFF) ? run + 1 : 0;
+		if((run > sig->anchorlen) && (sig->anchorlen < SIG_ANCHOR_MAX))
+		{
+			sig->anchorlen = run > SIG_ANCHOR_MAX ? SIG_ANCHOR_MAX : run;
+			sig->anchor = i + 1 - sig->anchorlen;
+		}
+	}
+
+	if(sig->anchorlen == 0)
+	{
+		return 0;
+	}
+
+	memcpy(sig->pattern, data, len);
+	memcpy(sig->mask, mask, len);
+
+	return 1;
+}
+
+static int sig_child(const struct MemSigSet *set, int node, unsigned char ch)
+{
+	int child;
+
+	if(node == 0)
+	{
+		return set->root[ch];
+	}
+
+	for(child = set->nodes[node].child; child != 0; child = set->nodes[child].sibling)
+	{
+		if(set->nodes[child].ch == ch)
+		{
+			return child;
+		}
+	}
+
+	return 0;
+}
+
+static void sig_insert(struct MemSigSet *set, int sig)
+{
+	const unsigned char *anchor;
+	int node = 0;
+	int i;
+
+	anchor = (const unsigned char *) set->sigs[sig].pattern + set->sigs[sig].anchor;
+	for(i = 0; i < set->sigs[sig].anchorlen; i++)
+	{
+		int child;
+
+		child = sig_child(set, node, anchor[i]);
+		if(child == 0)
+		{
+			child = set->nnodes++;
+			memset(&set->nodes[child], 0, sizeof(struct SigNode));
+			set->nodes[child].ch = anchor[i];
+			if(node == 0)
+			{
+				set->root[anchor[i]] = child;
+			}
+			else
+			{
+				set->nodes[child].sibling = set->nodes[node].child;
+				set->nodes[node].child = child;
+			}
+		}
+		node = child;
+	}
+
+	set->sigs[sig].next = set->nodes[node].out;
+	set->nodes[node].out = sig + 1;
+}
+
+/* Breadth first pass to fill in the failure and dictionary links */
+static void sig_link(struct MemSigSet *set, unsigned short *queue)
+{
+	int head = 0;
+	int tail = 0;
+	int c;
+
+	for(c = 0; c < 256; c++)
+	{
+		if(set->root[c])
+		{
+			queue[tail++] = set->root[c];
+		}
+	}
+
+	while(head < tail)
+	{
+		int node = queue[head++];
+		int child;
+
+		for(child = set->nodes[node].child; child != 0; child = set->nodes[child].sibling)
+		{
+			int fail = set->nodes[node].fail;
+			int next;
+
+			while(((next = sig_child(set, fail, set->nodes[child].ch)) == 0) && (fail != 0))
+			{
+				fail = set->nodes[fail].fail;
+			}
+
+			set->nodes[child].fail = next;
+			set->nodes[child].dict = set->nodes[next].out ? next : set->nodes[next].dict;
+			queue[tail++] = child;
+		}
+	}
+}
+
+static int sig_count(const char *file)
+{
+	PspFile f;
+	char line[SIG_LINE_MAX];
+	char *fields[3];
+	int count = 0;
+
+	if(!openfile(file, &f))
+	{
+		return -1;
+	}
+
+	while(fdgets(&f, line, sizeof(line)))
+	{
+		if(sig_line(line, fields, 3) > 0)
+		{
+			count++;
+		}
+	}
+	closefile(&f);
+
+	return count;
+}
+
+struct MemSigSet *memSigLoad(const char *file)
+{
+	struct MemSigSet *set;
+	PspFile f;
+	char line[SIG_LINE_MAX];
+	SceUID block;
+	int maxsigs;
+	int maxnodes;
+	int size;
+	int lineno = 0;
+
+	maxsigs = sig_count(file);
+	if(maxsigs < 0)
+	{
+		printf("Error could not open signature file %s\n", file);
+		return NULL;
+	}
+
+	maxnodes = (maxsigs * SIG_ANCHOR_MAX) + 1;
+	if(maxnodes > 0xFFFF)
+	{
+		printf("Error too many signatures in %s\n", file);
+		return NULL;
+	}
+
+	/* The queue used while linking goes after the nodes */
+	size = sizeof(struct MemSigSet) + (maxsigs * sizeof(struct SigEntry)) 
+		+ (maxnodes * (sizeof(struct SigNode) + sizeof(unsigned short)));
+	block = sceKernelAllocPartitionMemory(1, "SigScan", PSP_SMEM_Low, size, NULL);
+	if(block < 0)
+	{
+		printf("Error could not allocate memory buffer %08X\n", block);
+		return NULL;
+	}
+
+	set = sceKernelGetBlockHeadAddr(block);
+	memset(set, 0, sizeof(struct MemSigSet));
+	set->block = block;
+	set->sigs = (struct SigEntry *) (set + 1);
+	set->nodes = (struct SigNode *) (set->sigs + maxsigs);
+	memset(&set->nodes[0], 0, sizeof(struct SigNode));
+	set->nnodes = 1;
+
+	if(openfile(file, &f))
+	{
+		while((set->nsigs < maxsigs) && (fdgets(&f, line, sizeof(line))))
+		{
+			char *fields[3];
+			char copy[SIG_LINE_MAX];
+
+			lineno++;
+			strcpy(copy, line);
+			if(sig_line(copy, fields, 3) <= 0)
+			{
+				continue;
+			}
+
+			if(!sig_parse(line, &set->sigs[set->nsigs]))
+			{
+				printf("Invalid signature on line %d, need name hex [mask] with at least one unmasked byte\n", lineno);
+				continue;
+			}
+
+			sig_insert(set, set->nsigs);
+			set->nsigs++;
+		}
+		closefile(&f);
+	}
+
+	sig_link(set, (unsigned short *) (set->nodes + maxnodes));
+
+	return set;
+}
+
+void memSigFree(struct MemSigSet *set)
+{
+	if(set)
+	{
+		sceKernelFreePartitionMemory(set->block);
+	}
+}
+
+int memSigCount(const struct MemSigSet *set)
+{
+	return set->nsigs;
+}
+
+const char *memSigName(const struct MemSigSet *set, int sig)
+{
+	return set->sigs[sig].name;
+}
+
+static int match_before(u32 addr, int sig, const struct MemSigMatch *match)
+{
+	return (addr < match->addr) || ((addr == match->addr) && (sig < match->sig));
+}
+
+/* Scan size bytes from addr for every signature in one pass. results gets the matches
+ * ordered by address then signature. If there were more than max, next is set to the
+ * lowest address of those left out and scanning again from there finds the rest, otherwise
+ * it is set to the end */
+int memSigScan(const struct MemSigSet *set, u32 addr, u32 size, struct MemSigMatch *results, int max, u32 *next)
+{
+	const unsigned char *data = (const unsigned char *) addr;
+	const unsigned char *end = data + size;
+	const unsigned char *p;
+	struct MemSigMatch cut;
+	int state = 0;
+	int count = 0;
+	int full = 0;
+
+	if(max <= 0)
+	{
+		*next = addr;
+		return 0;
+	}
+
+	cut.addr = addr + size;
+	cut.sig = 0;
+	for(p = data; p < end; p++)
+	{
+		int node;
+
+		/* Once full we only carry on while a match could still come before the cut */
+		if((full) && (((u32) p + 1) > (cut.addr + MEMSIG_MAX_PATTERN)))
+		{
+			break;
+		}
+
+		while(((node = sig_child(set, state, *p)) == 0) && (state != 0))
+		{
+			state = set->nodes[state].fail;
+		}
+		state = node;
+
+		node = set->nodes[state].out ? state : set->nodes[state].dict;
+		for(; node != 0; node = set->nodes[node].dict)
+		{
+			int sig;
+
+			for(sig = set->nodes[node].out; sig != 0; sig = set->sigs[sig-1].next)
+			{
+				const struct SigEntry *entry = &set->sigs[sig-1];
+				const unsigned char *start = p + 1 - entry->anchorlen - entry->anchor;
+				int i;
+
+				if((start < data) || (entry->len > (end - start)) || (!match_masked(start, entry->pattern, entry->mask, entry->len)))
+				{
+					continue;
+				}
+
+				/* Keep the results sorted, once full the last one makes way for anything before it */
+				if(count == max)
+				{
+					full = 1;
+					if(!match_before((u32) start, sig - 1, &results[max-1]))
+					{
+						if(match_before((u32) start, sig - 1, &cut))
+						{
+							cut.addr = (u32) start;
+							cut.sig = sig - 1;
+						}
+						continue;
+					}
+
+					cut = results[max-1];
+					count--;
+				}
+
+				for(i = count; (i > 0) && (match_before((u32) start, sig - 1, &results[i-1])); i--)
+				{
+					results[i] = results[i-1];
+				}
+				results[i].addr = (u32) start;
+				results[i].sig = sig - 1;
+				count++;
+			}
+		}
+	}
+
+	*next = addr + size;
+	if(full)
+	{
+		int keep = count;
+
+		/* Anything at the cut address is found again when scanning from there */
+		while((keep > 0) && (results[keep-1].addr >= cut.addr))
+		{
+			keep--;
+		}
+
+		if(keep > 0)
+		{
+			count = keep;
+			*next = cut.addr;
+		}
+		else
+		{
+			/* More than max signatures match at one address, the rest of them are skipped
+			 * so the caller still moves on */
+			*next = cut.addr + 1;
+		}
+	}
+
+	return count;
+}
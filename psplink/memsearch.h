@@ -0,0 +1,53 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * memsearch.h - PSPLINK memory search functions
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+
+#ifndef __MEMSEARCH_H__
+#define __MEMSEARCH_H__
+
+#define MEMSEARCH_MAX_PATTERN 128
+
+/* A prepared search pattern, matches where (data & mask) == pattern */
+struct MemSearch
+{
+	u32 pattern[MEMSEARCH_MAX_PATTERN / 4];
+	u32 mask[MEMSEARCH_MAX_PATTERN / 4];
+	int len;
+	/* Only match at multiples of align (1, 2 or 4) */
+	int align;
+	int masked;
+	/* Horspool shift for each value of the last byte in the window */
+	unsigned char skip[256];
+};
+
+int memSearchInit(struct MemSearch *search, const void *pattern, const void *mask, int len, int align);
+int memSearch(const struct MemSearch *search, u32 addr, u32 size, u32 *results, int max, u32 *next);
+
+#define MEMSIG_MAX_NAME    32
+#define MEMSIG_MAX_PATTERN 64
+
+/* A set of signatures scanned for in a single pass */
+struct MemSigSet;
+
+struct MemSigMatch
+{
+	u32 addr;
+	int sig;
+};
+
+struct MemSigSet *memSigLoad(const char *file);
+void memSigFree(struct MemSigSet *set);
+int memSigCount(const struct MemSigSet *set);
+const char *memSigName(const struct MemSigSet *set, int sig);
+int memSigScan(const struct MemSigSet *set, u32 addr, u32 size, struct MemSigMatch *results, int max, u32 *next);
+
+#endif
@@ -27,6 +27,7 @@
 #include <pspthreadman_kernel.h>
 #include <psppower.h>
 #include <stdint.h>
+#include <usbhostfs.h>
 #include "memoryUID.h"
 #include "psplink.h"
 #include "psplinkcnf.h"
@@ -47,6 +48,12 @@
 #include "disasm.h"
 #include "apihook.h"
 #include "tty.h"
+#include "memsearch.h"
+#include "memscan.h"
+#include "snapshot.h"
+#include "memops.h"
+#include "xfer.h"
+#include "watch.h"
 
 #define MAX_SHELL_VAR      128
 #define SHELL_PROMPT	"psplink %d>"
@@ -1105,6 +1112,7 @@ static int modunld_cmd(int argc, char **argv)
 
 		uid_ret = sceKernelUnloadModule(uid);
 		printf("Module Unload 0x%08X\n", uid_ret);
+		memInvalidateLookups();
 
 		ret = CMD_OK;
 	}
@@ -1131,6 +1139,7 @@ static int modstun_cmd(int argc, char **argv)
 		stop = sceKernelStopModule(uid, 0, NULL, &status, NULL);
 		unld = sceKernelUnloadModule(uid);
 		printf("Module Stop/Unload 0x%08X/0x%08X Status 0x%08X\n", stop, unld, status);
+		memInvalidateLookups();
 
 		ret = CMD_OK;
 	}
@@ -1365,6 +1374,7 @@ static int modload_cmd(int argc, char **argv)
 	if(handlepath(g_context.currdir, argv[0], path, TYPE_FILE, 1))
 	{
 		modid = sceKernelLoadModule(path, 0, NULL);
+		memInvalidateLookups();
 		if(!psplinkReferModule(modid, &info))
 		{
 			printf("Module Load '%s' UID: 0x%08X\n", path, modid);
@@ -1515,6 +1525,7 @@ static int kill_cmd(int argc, char **argv)
 				printf("Error could not unload module\n");
 				break;
 			}
+			memInvalidateLookups();
 
 			ret = CMD_OK;
 		}
@@ -1959,7 +1970,6 @@ static int cp_cmd(int argc, char **argv)
 
 	char fsrc[MAXPATHLEN];
 	char fdst[MAXPATHLEN];
-	char buff[2048];
 
 	source = argv[0];
 	destination = argv[1];
@@ -2002,19 +2012,12 @@ static int cp_cmd(int argc, char **argv)
 		return CMD_ERROR;
 	}
 
-	while(1) {
-		n = sceIoRead(in, buff, 2048);
-
-		if(n <= 0)
-			break;
-		
-		sceIoWrite(out, buff, n);
-	}
+	n = xferFileToFile(in, out);
 	
 	sceIoClose(in);
 	sceIoClose(out);
 
-	return CMD_OK;
+	return n < 0 ? CMD_ERROR : CMD_OK;
 }
 
 static int remap_cmd(int argc, char **argv)
@@ -2073,7 +2076,23 @@ static int meminfo_cmd(int argc, char **argv)
 
 static int memreg_cmd(int argc, char **argv)
 {
-	memPrintRegions();
+	u32 addr;
+
+	if(argc > 0)
+	{
+		if(!memDecode(argv[0], &addr))
+		{
+			return CMD_ERROR;
+		}
+
+		memPrintRegion(addr);
+	}
+	else
+	{
+		memRefreshRegions();
+		memPrintRegions();
+	}
+
 	return CMD_OK;
 }
 
@@ -2103,81 +2122,63 @@ static int memblocks_cmd(int argc, char **argv)
 #define MAX_MEMDUMP_SIZE 256
 #define MEMDUMP_TYPE_BYTE 1
 #define MEMDUMP_TYPE_HALF 2
-#define MEMDUMP_TYPE_WORD 3
+#define MEMDUMP_TYPE_WORD 4
 
-/* Print a row of a memory dump, up to row_size */
-static void print_row(const u32* row, s32 row_size, u32 addr, int type)
-{
-	char buffer[128];
-	char *p = buffer;
-	int i = 0;
+static const char g_hexupper[] = "0123456789ABCDEF";
+static const char g_hexlower[] = "0123456789abcdef";
 
-	sprintf(p, "%08x - ", addr);
-	p += strlen(p);
+static char *format_hex(char *p, u32 val, int digits, const char *table)
+{
+	int i;
 
-	if(type == MEMDUMP_TYPE_WORD)
+	for(i = digits - 1; i >= 0; i--)
 	{
-		for(i = 0; i < 16; i+=4)
-		{
-			if(i < row_size)
-			{
-				sprintf(p, "%02X%02X%02X%02X ", row[i+3], row[i+2], row[i+1], row[i]);
-			}
-			else
-			{
-				sprintf(p, "-------- ");
-			}
-			p += strlen(p);
-		}
+		p[i] = table[val & 0xF];
+		val >>= 4;
 	}
-	else if(type == MEMDUMP_TYPE_HALF)
-	{
-		for(i = 0; i < 16; i+=2)
-		{
-			if(i < row_size)
-			{
-				sprintf(p, "%02X%02X ", row[i+1], row[i]);
-			}
-			else
-			{
-				sprintf(p, "---- ");
-			}
 
-			p += strlen(p);
-		}
-	}
-	else
+	return p + digits;
+}
+
+/* Print a row of a memory dump, up to row_size, type is the size of each group in bytes */
+static void print_row(const u8 *row, int row_size, u32 addr, int type)
+{
+	char buffer[128];
+	char *p = buffer;
+	int i;
+	int j;
+
+	p = format_hex(p, addr, 8, g_hexlower);
+	*p++ = ' ';
+	*p++ = '-';
+	*p++ = ' ';
+
+	for(i = 0; i < 16; i += type)
 	{
-		for(i = 0; i < 16; i++)
+		/* Groups are little endian */
+		for(j = type - 1; j >= 0; j--)
 		{
-			if(i < row_size)
+			if((i + j) < row_size)
 			{
-				sprintf(p, "%02X ", row[i]);
+				p = format_hex(p, row[i + j], 2, g_hexupper);
 			}
 			else
 			{
-				sprintf(p, "-- ");
+				*p++ = '-';
+				*p++ = '-';
 			}
-
-			p += strlen(p);
 		}
+		*p++ = ' ';
 	}
 
-	sprintf(p, "- ");
-	p += strlen(p);
+	*p++ = '-';
+	*p++ = ' ';
 
 	for(i = 0; i < 16; i++)
 	{
-		if(i < row_size)
+		if((i < row_size) && (row[i] >= 32) && (row[i] < 127))
 		{
-			if((row[i] >= 32) && (row[i] < 127))
-			{
-				*p++ = row[i];
-			}
-			else
-			{
-				*p++ =  '.';
-			}
+			*p++ = row[i];
 		}
 		else
 		{
@@ -2193,8 +2194,9 @@ static void print_row(const u32* row, s32 row_size, u32 addr, int type)
 static void print_memdump(u32 addr, s32 size, int type)
 {
 	int size_left;
-	u32 row[16];
+	u8 row[16];
 	int row_size;
+	int i;
 	u8 *p_addr = (u8 *) addr;
 
 	if(type == MEMDUMP_TYPE_WORD)
@@ -2214,21 +2216,18 @@ static void print_memdump(u32 addr, s32 size, int type)
 	}
 
 	size_left = size > MAX_MEMDUMP_SIZE ? MAX_MEMDUMP_SIZE : size;
-	row_size = 0;
 
 	while(size_left > 0)
 	{
-		row[row_size] = p_addr[row_size];
-		row_size++;
-		if(row_size == 16)
+		row_size = size_left > 16 ? 16 : size_left;
+		for(i = 0; i < row_size; i++)
 		{
-			// draw row
-			print_row(row, row_size, (u32) p_addr, type);
-			p_addr += 16;
-			row_size = 0;
+			row[i] = p_addr[i];
 		}
 
-		size_left--;
+		print_row(row, row_size, (u32) p_addr, type);
+		p_addr += row_size;
+		size_left -= row_size;
 	}
 }
 
@@ -2298,7 +2297,6 @@ static int savemem_cmd(int argc, char **argv)
 	char path[1024];
 	u32 addr;
 	int size;
-	int written;
 	char *endp;
 
 	if(!handlepath(g_context.currdir, argv[2], path, TYPE_FILE, 0))
@@ -2328,20 +2326,7 @@ static int savemem_cmd(int argc, char **argv)
 		}
 		else
 		{
-			written = 0;
-			while(written < size)
-			{
-				int ret;
-
-				ret = sceIoWrite(fd, (void *) (addr + written), size - written);
-				if(ret <= 0)
-				{
-					printf("Could not write out file\n");
-					break;
-				}
-
-				written += ret;
-			}
+			xferMemToFile(addr, size, fd);
 			sceIoClose(fd);
 		}
 	}
@@ -2353,6 +2338,133 @@ static int savemem_cmd(int argc, char **argv)
 	return CMD_OK;
 }
 
+/* Stream memory into a host file over the usbhostfs bulk channel, this avoids the 64KiB
+ * write command round trips and needs no buffer on the PSP */
+static int dumpstream_cmd(int argc, char **argv)
+{
+	char path[1024];
+	BulkWriteFunc bulkwrite;
+	u32 addr;
+	u32 size;
+	u32 size_left;
+	u32 written;
+	int fd;
+
+	if(!handlepath(g_context.currdir, argv[2], path, TYPE_FILE, 0))
+	{
+		printf("Error invalid path\n");
+		return CMD_ERROR;
+	}
+
+	if(strncmp(path, "host", 4))
+	{
+		printf("Error %s is not a host path\n", path);
+		return CMD_ERROR;
+	}
+
+	if(!memDecode(argv[0], &addr) || !memDecode(argv[1], &size))
+	{
+		return CMD_ERROR;
+	}
+
+	size_left = memValidate(addr, MEM_ATTRIB_READ | MEM_ATTRIB_BYTE);
+	size = size > size_left ? size_left : size;
+	if(size == 0)
+	{
+		printf("Error invalid memory region 0x%08X\n", addr);
+		return CMD_ERROR;
+	}
+
+	bulkwrite = find_bulkwrite();
+	if(bulkwrite == NULL)
+	{
+		printf("Error could not find the usbhostfs bulk channel\n");
+		return CMD_ERROR;
+	}
+
+	fd = sceIoOpen(path, PSP_O_CREAT | PSP_O_TRUNC | PSP_O_WRONLY | HOSTFS_BULK_OPEN, 0777);
+	if(fd < 0)
+	{
+		printf("Could not open file '%s' for writing 0x%08X\n", path, fd);
+		return CMD_ERROR;
+	}
+
+	written = write_bulk(bulkwrite, (void *) addr, size);
+	sceIoClose(fd);
+
+	if(written < size)
+	{
+		printf("Error streaming memory at 0x%08X\n", addr + written);
+	}
+	printf("Streamed 0x%08X bytes from 0x%08X\n", written, addr);
+
+	return CMD_OK;
+}
+
+static int snapshot_cmd(int argc, char **argv)
+{
+	char path[1024];
+	u32 addr;
+	u32 size;
+	u32 size_left;
+	u32 count = 1;
+	u32 delay = 0;
+	u32 i;
+
+	if(!handlepath(g_context.currdir, argv[2], path, TYPE_FILE, 0))
+	{
+		printf("Error invalid path\n");
+		return CMD_ERROR;
+	}
+
+	if(strncmp(path, "host", 4))
+	{
+		printf("Error %s is not a host path\n", path);
+		return CMD_ERROR;
+	}
+
+	if(!memDecode(argv[0], &addr) || !memDecode(argv[1], &size))
+	{
+		return CMD_ERROR;
+	}
+
+	if(((argc > 3) && (strtoint(argv[3], &count) == 0)) || ((argc > 4) && (strtoint(argv[4], &delay) == 0)))
+	{
+		printf("Invalid count or delay\n");
+		return CMD_ERROR;
+	}
+
+	size_left = memValidate(addr, MEM_ATTRIB_READ | MEM_ATTRIB_WORD);
+	size = size > size_left ? size_left : size;
+
+	for(i = 0; i < count; i++)
+	{
+		int changed;
+
+		if((i > 0) && (delay > 0))
+		{
+			sceKernelDelayThread(delay * 1000);
+		}
+
+		changed = snapshotTake(addr, size, path);
+		if(changed < 0)
+		{
+			return CMD_ERROR;
+		}
+
+		printf("Snapshot sent 0x%08X bytes\n", changed);
+	}
+
+	return CMD_OK;
+}
+
+static int snapreset_cmd(int argc, char **argv)
+{
+	snapshotReset();
+
+	return CMD_OK;
+}
+
 static int loadmem_cmd(int argc, char **argv)
 {
 	char path[1024];
@@ -2379,7 +2491,6 @@ static int loadmem_cmd(int argc, char **argv)
 	if(memDecode(argv[0], &addr))
 	{
 		int size_left;
-		int readbytes;
 		int fd;
 
 		size_left = memValidate(addr, MEM_ATTRIB_READ | MEM_ATTRIB_BYTE);
@@ -2401,26 +2512,8 @@ static int loadmem_cmd(int argc, char **argv)
 				size = size_left;
 			}
 
-			readbytes = 0;
-			while(readbytes < size)
-			{
-				int ret;
-
-				ret = sceIoRead(fd, (void *) (addr + readbytes), size - readbytes);
-				if(ret < 0)
-				{
-					printf("Could not write out file\n");
-					break;
-				}
-				else if(ret == 0)
-				{
-					break;
-				}
-
-				readbytes += ret;
-			}
+			xferFileToMem(fd, addr, size);
 			sceIoClose(fd);
-			printf("Read %d bytes into memory\n", readbytes);
 		}
 	}
 	else
@@ -2694,8 +2787,9 @@ static int peekb_cmd(int argc, char **argv)
 	return CMD_OK;
 }
 
-static int fillb_cmd(int argc, char **argv)
+static int fill_values(int argc, char **argv, int width)
 {
+	static const u32 attribs[5] = { 0, MEM_ATTRIB_BYTE, MEM_ATTRIB_HALF, 0, MEM_ATTRIB_WORD };
 	u32 addr;
 	u32 size;
 
@@ -2704,7 +2798,9 @@ static int fillb_cmd(int argc, char **argv)
 		u32 size_left;
 		u32 val;
 
-		size_left = memValidate(addr, MEM_ATTRIB_WRITE | MEM_ATTRIB_BYTE);
+		addr &= ~(width - 1);
+
+		size_left = memValidate(addr, MEM_ATTRIB_WRITE | attribs[width]);
 		size = size > size_left ? size_left : size;
 
 		if(strtoint(argv[2], &val) == 0)
@@ -2713,272 +2809,422 @@ static int fillb_cmd(int argc, char **argv)
 			return CMD_ERROR;
 		}
 
-		memset((void *) addr, val, size);
+		memFill(addr, size, val, width);
 	}
 
 	return CMD_OK;
 }
 
-static int fillh_cmd(int argc, char **argv)
+static int fillb_cmd(int argc, char **argv)
 {
-	u32 addr;
-	u32 size;
+	return fill_values(argc, argv, sizeof(u8));
+}
 
-	if(memDecode(argv[0], &addr) && memDecode(argv[1], &size))
-	{
-		u32 size_left;
-		u32 val;
-		int i;
-		u16 *ptr;
+static int fillh_cmd(int argc, char **argv)
+{
+	return fill_values(argc, argv, sizeof(u16));
+}
 
-		addr &= ~1;
+static int fillw_cmd(int argc, char **argv)
+{
+	return fill_values(argc, argv, sizeof(u32));
+}
 
-		size_left = memValidate(addr, MEM_ATTRIB_WRITE | MEM_ATTRIB_HALF);
-		size = size > size_left ? size_left : size;
+/* Maximum number of matches printed by one find command */
+#define FIND_MAX_RESULTS 256
 
-		if(strtoint(argv[2], &val) == 0)
-		{
-			printf("Invalid fill value %s\n", argv[2]);
-			return CMD_ERROR;
-		}
+/* Search from addr and print the matches, capped at FIND_MAX_RESULTS */
+static void find_print(const struct MemSearch *search, u32 addr, u32 size)
+{
+	u32 results[FIND_MAX_RESULTS];
+	u32 size_left;
+	u32 next;
+	int count;
+	int i;
 
-		ptr = (u16*) addr;
+	size_left = memValidate(addr, MEM_ATTRIB_READ | MEM_ATTRIB_BYTE);
+	size = size_left > size ? size : size_left;
 
-		for(i = 0; i < (size / 2); i++)
-		{
-			ptr[i] = (u16) val;
-		}
+	count = memSearch(search, addr, size, results, FIND_MAX_RESULTS, &next);
+	for(i = 0; i < count; i++)
+	{
+		printf("Found match at address 0x%08X\n", results[i]);
 	}
 
-	return CMD_OK;
+	if(next < (addr + size))
+	{
+		printf("Stopped after %d matches, next search from 0x%08X\n", count, next);
+	}
 }
 
-static int fillw_cmd(int argc, char **argv)
+static int findstr_cmd(int argc, char **argv)
 {
 	u32 addr;
 	u32 size;
 
 	if(memDecode(argv[0], &addr) && memDecode(argv[1], &size))
 	{
-		u32 size_left;
-		u32 val;
-		int i;
-		u32 *ptr;
-
-		addr &= ~3;
-
-		size_left = memValidate(addr, MEM_ATTRIB_WRITE | MEM_ATTRIB_WORD);
-		size = size > size_left ? size_left : size;
+		struct MemSearch search;
 
-		if(strtoint(argv[2], &val) == 0)
+		if(!memSearchInit(&search, argv[2], NULL, strlen(argv[2]), 1))
 		{
-			printf("Invalid fill value %s\n", argv[2]);
+			printf("Invalid search string, maximum length is %d\n", MEMSEARCH_MAX_PATTERN);
 			return CMD_ERROR;
 		}
 
-		ptr = (u32*) addr;
-
-		for(i = 0; i < (size / 4); i++)
-		{
-			ptr[i] = (u32) val;
-		}
+		find_print(&search, addr, size);
 	}
 
 	return CMD_OK;
 }
 
-static int findstr_cmd(int argc, char **argv)
+/* Search for a list of words or half words, only at aligned addresses */
+static int find_values(int argc, char **argv, int valsize)
 {
 	u32 addr;
 	u32 size;
 
 	if(memDecode(argv[0], &addr) && memDecode(argv[1], &size))
 	{
-		u32 size_left;
+		struct MemSearch search;
 		int searchlen;
-		void *curr, *found;
+		uint8_t data[MEMSEARCH_MAX_PATTERN];
+		int i;
 
-		size_left = memValidate(addr, MEM_ATTRIB_READ | MEM_ATTRIB_BYTE);
-		size = size_left > size ? size : size_left;
-		searchlen = strlen(argv[2]);
-		curr = (void *) addr;
-		
-		do
+		searchlen = 0;
+		for(i = 2; i < argc; i++)
 		{
-			found = memmem_mask(curr, NULL, size, argv[2], searchlen);
-			if(found)
+			u32 val;
+
+			if(strtoint(argv[i], &val) == 0)
 			{
-				printf("Found match at address 0x%p\n", found);
-				found++;
-				size -= (found - curr);
-				curr = found;
+				printf("Invalid search value %s\n", argv[i]);
+				return CMD_ERROR;
 			}
+
+			if((searchlen + valsize) > sizeof(data))
+			{
+				printf("Too many search values\n");
+				return CMD_ERROR;
+			}
+
+			memcpy(&data[searchlen], &val, valsize);
+			searchlen += valsize;
 		}
-		while((found) && (size > 0));
+
+		memSearchInit(&search, data, NULL, searchlen, valsize);
+		find_print(&search, addr, size);
 	}
 
 	return CMD_OK;
 }
 
 static int findw_cmd(int argc, char **argv)
+{
+	return find_values(argc, argv, sizeof(u32));
+}
+
+static int findh_cmd(int argc, char **argv)
+{
+	return find_values(argc, argv, sizeof(u16));
+}
+
+static int findhex_cmd(int argc, char **argv)
 {
 	u32 addr;
 	u32 size;
+	uint8_t hex[MEMSEARCH_MAX_PATTERN];
+	uint8_t *mask = NULL;
+	uint8_t mask_d[MEMSEARCH_MAX_PATTERN];
+	int hexsize;
+	int masksize;
 
 	if(memDecode(argv[0], &addr) && memDecode(argv[1], &size))
 	{
-		u32 size_left;
-		int searchlen;
-		void *curr, *found;
-		uint8_t search[128];
-		int i;
+		struct MemSearch search;
 
-		searchlen = 0;
-		for(i = 2; i < argc; i++)
+		hexsize = decode_hexstr(argv[2], hex, sizeof(hex));
+		if(hexsize == 0)
 		{
-			u32 val;
+			printf("Error in search string\n");
+			return CMD_ERROR;
+		}
 
-			if(strtoint(argv[i], &val) == 0)
+		if(argc > 3)
+		{
+			masksize = decode_hexstr(argv[3], mask_d, sizeof(mask_d));
+			if(masksize == 0)
 			{
-				printf("Invalid search value %s\n", argv[i]);
+				printf("Error in mask string\n");
 				return CMD_ERROR;
 			}
 
-			memcpy(&search[searchlen], &val, sizeof(val));
-			searchlen += sizeof(val);
-		}
-
-		size_left = memValidate(addr, MEM_ATTRIB_READ | MEM_ATTRIB_BYTE);
-		size = size_left > size ? size : size_left;
-		curr = (void *) addr;
-		
-		do
-		{
-			found = memmem_mask(curr, NULL, size, search, searchlen);
-			if(found)
+			if(masksize != hexsize)
 			{
-				printf("Found match at address 0x%p\n", found);
-				found++;
-				size -= (found - curr);
-				curr = found;
+				printf("Hex and mask do not match\n");
+				return CMD_ERROR;
 			}
+
+			mask = mask_d;
 		}
-		while((found) && (size > 0));
+
+		memSearchInit(&search, hex, mask, hexsize, 1);
+		find_print(&search, addr, size);
 	}
 
 	return CMD_OK;
 }
 
-static int findh_cmd(int argc, char **argv)
+static int sigscan_cmd(int argc, char **argv)
 {
+	char path[1024];
+	struct MemSigSet *set;
+	struct MemSigMatch results[FIND_MAX_RESULTS];
 	u32 addr;
 	u32 size;
+	u32 size_left;
+	u32 pos;
+	u32 next;
+	int count;
+	int total = 0;
+	int i;
 
-	if(memDecode(argv[0], &addr) && memDecode(argv[1], &size))
+	if(!memDecode(argv[1], &addr))
 	{
-		u32 size_left;
-		int searchlen;
-		void *curr, *found;
-		uint8_t search[128];
-		int i;
+		return CMD_ERROR;
+	}
 
-		searchlen = 0;
-		for(i = 2; i < argc; i++)
+	/* Default to the rest of the memory region */
+	size_left = memValidate(addr, MEM_ATTRIB_READ | MEM_ATTRIB_BYTE);
+	size = size_left;
+	if(argc > 2)
+	{
+		if(!memDecode(argv[2], &size))
 		{
-			u32 val;
+			return CMD_ERROR;
+		}
+		size = size_left > size ? size : size_left;
+	}
 
-			if(strtoint(argv[i], &val) == 0)
-			{
-				printf("Invalid search value %s\n", argv[i]);
-				return CMD_ERROR;
-			}
+	if(size == 0)
+	{
+		printf("Error invalid memory region 0x%08X\n", addr);
+		return CMD_ERROR;
+	}
+
+	if(!handlepath(g_context.currdir, argv[0], path, TYPE_FILE, 1))
+	{
+		printf("Error invalid file %s\n", argv[0]);
+		return CMD_ERROR;
+	}
+
+	set = memSigLoad(path);
+	if(set == NULL)
+	{
+		return CMD_ERROR;
+	}
 
-			memcpy(&search[searchlen], &val, sizeof(u16));
-			searchlen += sizeof(u16);
+	printf("Scanning 0x%08X to 0x%08X for %d signatures\n", addr, addr + size, memSigCount(set));
+	/* Each pass picks up from the lowest match the last one had no room for */
+	for(pos = addr; pos < (addr + size); pos = next)
+	{
+		count = memSigScan(set, pos, addr + size - pos, results, FIND_MAX_RESULTS, &next);
+		for(i = 0; i < count; i++)
+		{
+			printf("Found %s at address 0x%08X\n", memSigName(set, results[i].sig), results[i].addr);
 		}
+		total += count;
+	}
+	printf("%d matches\n", total);
 
-		size_left = memValidate(addr, MEM_ATTRIB_READ | MEM_ATTRIB_BYTE);
-		size = size_left > size ? size : size_left;
-		curr = (void *) addr;
-		
-		do
+	memSigFree(set);
+
+	return CMD_OK;
+}
+
+static int scan_width(const char *str)
+{
+	switch(str[0])
+	{
+		case 'b': return sizeof(u8);
+		case 'h': return sizeof(u16);
+		case 'w': return sizeof(u32);
+		default: return 0;
+	};
+}
+
+static int scanfirst_cmd(int argc, char **argv)
+{
+	u32 addr;
+	u32 size;
+	u32 size_left;
+	u32 val;
+	int width;
+	int count;
+
+	if(!memDecode(argv[0], &addr) || !memDecode(argv[1], &size))
+	{
+		return CMD_ERROR;
+	}
+
+	width = scan_width(argv[2]);
+	if(width == 0)
+	{
+		printf("Invalid width %s, must be b, h or w\n", argv[2]);
+		return CMD_ERROR;
+	}
+
+	if((argc > 3) && (strtoint(argv[3], &val) == 0))
+	{
+		printf("Invalid scan value %s\n", argv[3]);
+		return CMD_ERROR;
+	}
+
+	size_left = memValidate(addr, MEM_ATTRIB_READ | MEM_ATTRIB_BYTE);
+	size = size_left > size ? size : size_left;
+	if(size == 0)
+	{
+		printf("Error invalid memory region 0x%08X\n", addr);
+		return CMD_ERROR;
+	}
+
+	count = memScanFirst(addr, size, width, argc > 3 ? &val : NULL);
+	if(count < 0)
+	{
+		return CMD_ERROR;
+	}
+
+	printf("%d candidates\n", count);
+
+	return CMD_OK;
+}
+
+static int scannext_cmd(int argc, char **argv)
+{
+	static const struct
+	{
+		const char *name;
+		enum MemScanCond cond;
+		int needval;
+	} conds[] = {
+		{ "changed", MEMSCAN_CHANGED, 0 },
+		{ "unchanged", MEMSCAN_UNCHANGED, 0 },
+		{ "inc", MEMSCAN_INCREASED, 0 },
+		{ "dec", MEMSCAN_DECREASED, 0 },
+		{ "eq", MEMSCAN_EQUAL, 1 },
+		{ "ne", MEMSCAN_NOTEQUAL, 1 },
+		{ "gt", MEMSCAN_GREATER, 1 },
+		{ "lt", MEMSCAN_LESS, 1 },
+	};
+	u32 val = 0;
+	int count;
+	int i;
+
+	for(i = 0; i < (sizeof(conds) / sizeof(conds[0])); i++)
+	{
+		if(strcmp(argv[0], conds[i].name) == 0)
 		{
-			found = memmem_mask(curr, NULL, size, search, searchlen);
-			if(found)
-			{
-				printf("Found match at address 0x%p\n", found);
-				found++;
-				size -= (found - curr);
-				curr = found;
-			}
+			break;
+		}
+	}
+
+	if(i == (sizeof(conds) / sizeof(conds[0])))
+	{
+		printf("Invalid condition %s\n", argv[0]);
+		return CMD_ERROR;
+	}
+
+	if(conds[i].needval)
+	{
+		if((argc < 2) || (strtoint(argv[1], &val) == 0))
+		{
+			printf("Condition %s needs a valid value\n", argv[0]);
+			return CMD_ERROR;
 		}
-		while((found) && (size > 0));
 	}
 
+	count = memScanNext(conds[i].cond, val);
+	if(count < 0)
+	{
+		return CMD_ERROR;
+	}
+
+	printf("%d candidates\n", count);
+
 	return CMD_OK;
 }
 
-static int findhex_cmd(int argc, char **argv)
+#define SCANLIST_DEFAULT 32
+
+static int scanlist_cmd(int argc, char **argv)
 {
-	u32 addr;
-	u32 size;
-	uint8_t hex[128];
-	uint8_t *mask = NULL;
-	uint8_t mask_d[128];
-	int hexsize;
-	int masksize;
+	u32 addrs[FIND_MAX_RESULTS];
+	u32 prev[FIND_MAX_RESULTS];
+	u32 max = SCANLIST_DEFAULT;
+	u32 start = 0;
+	int width;
+	int count;
+	int i;
 
-	if(memDecode(argv[0], &addr) && memDecode(argv[1], &size))
+	width = memScanWidth();
+	if(width == 0)
 	{
-		u32 size_left;
-		void *curr, *found;
+		printf("No scan in progress\n");
+		return CMD_ERROR;
+	}
 
-		hexsize = decode_hexstr(argv[2], hex, sizeof(hex));
-		if(hexsize == 0)
-		{
-			printf("Error in search string\n");
-			return CMD_ERROR;
-		}
+	if((argc > 0) && (strtoint(argv[0], &max) == 0))
+	{
+		printf("Invalid count %s\n", argv[0]);
+		return CMD_ERROR;
+	}
 
-		if(argc > 3)
-		{
-			masksize = decode_hexstr(argv[3], mask_d, sizeof(mask_d));
-			if(masksize == 0)
-			{
-				printf("Error in mask string\n");
-				return CMD_ERROR;
-			}
+	if((argc > 1) && (strtoint(argv[1], &start) == 0))
+	{
+		printf("Invalid start %s\n", argv[1]);
+		return CMD_ERROR;
+	}
 
-			if(masksize != hexsize)
-			{
-				printf("Hex and mask do not match\n");
-				return CMD_ERROR;
-			}
+	if(max > FIND_MAX_RESULTS)
+	{
+		max = FIND_MAX_RESULTS;
+	}
 
-			mask = mask_d;
-		}
+	if((start > 0) && (start >= (u32) memScanCount()))
+	{
+		printf("Start %d is past the last of %d candidates\n", start, memScanCount());
+		return CMD_ERROR;
+	}
 
-		size_left = memValidate(addr, MEM_ATTRIB_READ | MEM_ATTRIB_BYTE);
-		size = size_left > size ? size : size_left;
-		curr = (void *) addr;
-		
-		do
+	count = memScanGet(start, addrs, prev, max);
+	for(i = 0; i < count; i++)
+	{
+		switch(width)
 		{
-			found = memmem_mask(curr, mask, size, hex, hexsize);
-			if(found)
-			{
-				printf("Found match at address 0x%p\n", found);
-				found++;
-				size -= (found - curr);
-				curr = found;
-			}
-		}
-		while((found) && (size > 0));
+			case 1: printf("0x%08X: 0x%02X (was 0x%02X)\n", addrs[i], _lb(addrs[i]), prev[i]);
+					break;
+			case 2: printf("0x%08X: 0x%04X (was 0x%04X)\n", addrs[i], _lh(addrs[i]), prev[i]);
+					break;
+			default: printf("0x%08X: 0x%08X (was 0x%08X)\n", addrs[i], _lw(addrs[i]), prev[i]);
+					 break;
+		};
+	}
+
+	if((count > 0) && ((start + count) < (u32) memScanCount()))
+	{
+		printf("Listed %d to %d of %d candidates, next start %d\n", start, start + count - 1, memScanCount(), start + count);
 	}
 
 	return CMD_OK;
 }
 
+static int scanreset_cmd(int argc, char **argv)
+{
+	memScanReset();
+
+	return CMD_OK;
+}
+
 static int copymem_cmd(int argc, char **argv)
 {
 	u32 src;
@@ -2996,7 +3242,7 @@ static int copymem_cmd(int argc, char **argv)
 		size_left = srcsize > destsize ? destsize : srcsize;
 		size = size > size_left ? size_left : size;
 
-		memmove((void *) dest, (void *) src, size);
+		memCopy(dest, src, size);
 	}
 
 	return CMD_OK;
@@ -3409,6 +3655,13 @@ static int exresume_cmd(int argc, char **argv)
 	return CMD_OK;
 }
 
+static int exresumeall_cmd(int argc, char **argv)
+{
+	printf("Resumed %d threads\n", exceptionResumeAll());
+
+	return CMD_OK;
+}
+
 static int setreg_cmd(int argc, char **argv)
 {
 	u32 addr;
@@ -3504,8 +3757,21 @@ static int bpset_cmd(int argc, char **argv)
 		size_left = memValidate(addr, MEM_ATTRIB_WRITE | MEM_ATTRIB_WORD | MEM_ATTRIB_EXEC);
 		if(size_left >= sizeof(u32))
 		{
-			debugSetBP(addr);
-			ret = CMD_OK;
+			u32 count = 0;
+
+			if(argc > 1)
+			{
+				if(!strtoint(argv[1], &count))
+				{
+					printf("Error, invalid ignore count\n");
+					return CMD_ERROR;
+				}
+			}
+
+			if(debugSetBP(addr, DEBUG_BP_SHELL, count))
+			{
+				ret = CMD_OK;
+			}
 		}
 		else
 		{
@@ -3516,6 +3782,21 @@ static int bpset_cmd(int argc, char **argv)
 	return ret;
 }
 
+static int bpdel_cmd(int argc, char **argv)
+{
+	u32 id;
+
+	if(!strtoint(argv[0], &id))
+	{
+		printf("Error, invalid breakpoint id\n");
+		return CMD_ERROR;
+	}
+
+	debugDeleteBp(id);
+
+	return CMD_OK;
+}
+
 static int bpprint_cmd(int argc, char **argv)
 {
 	debugPrintBPS();
@@ -3523,6 +3804,97 @@ static int bpprint_cmd(int argc, char **argv)
 	return CMD_OK;
 }
 
+static int wpset_cmd(int argc, char **argv)
+{
+	u32 addr;
+	u32 size;
+	u32 count = 0;
+	int type = WATCH_TYPE_WRITE;
+	int id;
+
+	if(!memDecode(argv[0], &addr) || !memDecode(argv[1], &size))
+	{
+		return CMD_ERROR;
+	}
+
+	if(argc > 2)
+	{
+		if(strcmp(argv[2], "r") == 0)
+		{
+			type = WATCH_TYPE_READ;
+		}
+		else if(strcmp(argv[2], "w") == 0)
+		{
+			type = WATCH_TYPE_WRITE;
+		}
+		else if(strcmp(argv[2], "rw") == 0)
+		{
+			type = WATCH_TYPE_ACCESS;
+		}
+		else
+		{
+			printf("Error, invalid watch type '%s'\n", argv[2]);
+			return CMD_ERROR;
+		}
+	}
+
+	if(argc > 3)
+	{
+		if(!strtoint(argv[3], &count))
+		{
+			printf("Error, invalid ignore count\n");
+			return CMD_ERROR;
+		}
+	}
+
+	id = watchSet(addr, size, type, 0, count);
+	if(id < 0)
+	{
+		return CMD_ERROR;
+	}
+
+	printf("Watchpoint %d set\n", id);
+
+	return CMD_OK;
+}
+
+static int wpdel_cmd(int argc, char **argv)
+{
+	u32 id;
+
+	if(!strtoint(argv[0], &id))
+	{
+		printf("Error, invalid watchpoint id\n");
+		return CMD_ERROR;
+	}
+
+	watchDelete(id);
+
+	return CMD_OK;
+}
+
+static int wpprint_cmd(int argc, char **argv)
+{
+	watchPrint();
+
+	return CMD_OK;
+}
+
+static int wpperiod_cmd(int argc, char **argv)
+{
+	u32 us;
+
+	if((!strtoint(argv[0], &us)) || (us == 0))
+	{
+		printf("Error, invalid sample period\n");
+		return CMD_ERROR;
+	}
+
+	watchSetPeriod(us);
+
+	return CMD_OK;
+}
+
 static int step_cmd(int argc, char **argv)
 {
 	debugStep(0);
@@ -3554,6 +3926,23 @@ static int symload_cmd(int argc, char **argv)
 	return CMD_OK;
 }
 
+static int symlazy_cmd(int argc, char **argv)
+{
+	char source[MAXPATHLEN];
+
+	if( !handlepath(g_context.currdir, argv[0], source, TYPE_FILE, 1) )
+	{
+		return CMD_ERROR;
+	}
+
+	if(!symbolLoadSymbolsLazy(source))
+	{
+		return CMD_ERROR;
+	}
+
+	return CMD_OK;
+}
+
 static int symlist_cmd(int argc, char **argv)
 {
 	symbolPrintLoadList();
@@ -3568,6 +3957,16 @@ static int symprint_cmd(int argc, char **argv)
 	return CMD_OK;
 }
 
+static int symdel_cmd(int argc, char **argv)
+{
+	if(!symbolDeleteSymbols(argv[0]))
+	{
+		return CMD_ERROR;
+	}
+
+	return CMD_OK;
+}
+
 static int symbyaddr_cmd(int argc, char **argv)
 {
 	u32 addr;
@@ -3575,19 +3974,18 @@ static int symbyaddr_cmd(int argc, char **argv)
 
 	if(memDecode(argv[0], &addr))
 	{
-		const struct SymfileEntry *pEntry;
+		struct SymbolInfo sym;
 		unsigned int baseaddr;
 
-		pEntry = symbolFindByAddress(addr, &baseaddr);
-		if(pEntry)
+		if(symbolFindByAddress(addr, &sym, &baseaddr))
 		{
-			if((baseaddr + pEntry->addr) < addr)
+			if((baseaddr + sym.addr) < addr)
 			{
-				printf("%s+0x%x\n", pEntry->name, addr - (baseaddr + pEntry->addr));
+				printf("%s+0x%x\n", sym.name, addr - (baseaddr + sym.addr));
 			}
 			else
 			{
-				printf("%s\n", pEntry->name);
+				printf("%s\n", sym.name);
 			}
 
 			ret = CMD_OK;
@@ -3601,6 +3999,24 @@ static int symbyaddr_cmd(int argc, char **argv)
 	return ret;
 }
 
+static int print_symfind(const char *modname, const struct SymfileEntry *sym, void *arg)
+{
+	printf("%s:%s\n", modname, sym->name);
+
+	return 1;
+}
+
+static int symfind_cmd(int argc, char **argv)
+{
+	if(symbolEnumPrefix(argv[0], print_symfind, NULL) == 0)
+	{
+		printf("No symbols match %s\n", argv[0]);
+		return CMD_ERROR;
+	}
+
+	return CMD_OK;
+}
+
 static int symbyname_cmd(int argc, char **argv)
 {
 	u32 addr;
@@ -3931,10 +4347,13 @@ const struct sh_command commands[] = {
 	
 	{ "memory", NULL, NULL, 0, "Commands to manipulate memory", NULL },
 	{ "meminfo", "mf", meminfo_cmd, 0, "Print free memory info", "[partitionid]" },
-	{ "memreg",  "mr", memreg_cmd, 0, "Print available memory regions (for other commands)", "" },
+	{ "memreg",  "mr", memreg_cmd, 0, "Print available memory regions (for other commands)", "[addr]" },
 	{ "memdump", "dm", memdump_cmd, 0, "Dump memory to screen", "[addr|-] [b|h|w]" },
 	{ "memblocks", "mk", memblocks_cmd, 0, "Dump the sysmem block table", "[f|t]" },
 	{ "savemem", "sm", savemem_cmd, 3, "Save memory to a file", "addr size path" },
+	{ "dumpstream", "ds", dumpstream_cmd, 3, "Stream memory to a host file over the USB bulk channel", "addr size path" },
+	{ "snapshot", "sp", snapshot_cmd, 3, "Append the pages changed since the last snapshot to a host file", "addr size path [count [delayms]]" },
+	{ "snapreset", NULL, snapreset_cmd, 0, "Free the snapshot state, the next snapshot is a full one", "" },
 	{ "loadmem", "lm", loadmem_cmd, 2, "Load memory from a file", "addr path [maxsize]" },
 	{ "pokew",   "pw", pokew_cmd, 2, "Poke words into memory", "addr val1 [val2..valN]"},
 	{ "pokeh",   "pw", pokeh_cmd, 2, "Poke half words into memory", "addr val1 [val2..valN]"},
@@ -3948,8 +4367,13 @@ const struct sh_command commands[] = {
 	{ "copymem", "cm", copymem_cmd, 3, "Copy a block of memory", "srcaddr destaddr size"},
 	{ "findstr", "ns", findstr_cmd, 3, "Find an ASCII string", "addr size str"},
 	{ "findhex", "nx", findhex_cmd, 3, "Find an hexstring string", "addr size hexstr [mask]"},
-	{ "findw",   "nw", findw_cmd, 3, "Find a list of words", "addr size val1 [val2..valN]"},
-	{ "findh",   "nh", findh_cmd, 3, "Find a list of half words", "addr size val1 [val2..valN]"},
+	{ "findw",   "nw", findw_cmd, 3, "Find a list of words (word aligned)", "addr size val1 [val2..valN]"},
+	{ "findh",   "nh", findh_cmd, 3, "Find a list of half words (half word aligned)", "addr size val1 [val2..valN]"},
+	{ "sigscan", "sn", sigscan_cmd, 2, "Find signatures from a file (lines of name hexstr [mask])", "file addr [size]"},
+	{ "scanfirst", "sf", scanfirst_cmd, 3, "Start a value scan, without a value every slot is a candidate", "addr size b|h|w [val]"},
+	{ "scannext", "sx", scannext_cmd, 1, "Narrow the value scan candidates", "changed|unchanged|inc|dec|eq|ne|gt|lt [val]"},
+	{ "scanlist", "sz", scanlist_cmd, 0, "List the value scan candidates", "[max [start]]"},
+	{ "scanreset", NULL, scanreset_cmd, 0, "Free the value scan candidates", ""},
 	{ "dcache",  "dc", dcache_cmd, 1, "Perform a data cache operation", "w|i|wi [addr size]"},
 	{ "icache",  "ic", icache_cmd, 0, "Perform an instruction cache operation", "[addr size]"},
 	{ "disasm",  "di", disasm_cmd, 1, "Disassemble instructions", "address [count]"},
@@ -3974,21 +4398,30 @@ const struct sh_command commands[] = {
 	{ "exlist",  "el", exlist_cmd, 0, "List the exception contexts", "" },
 	{ "exctx",   "ec", exctx_cmd, 1, "Set the current exception context", "ex" },
 	{ "exresume", "c", exresume_cmd, 0, "Resume from the exception", "[addr]"},
+	{ "exresumeall", "ca", exresumeall_cmd, 0, "Resume every thread stopped in an exception", ""},
 	{ "exprfpu", "ef", exprfpu_cmd, 0, "Print the current FPU registers", "[ex]"},
 	{ "exprvfpu", "ev", exprvfpu_cmd, 0, "Print the current VFPU registers", "[s|c|r|m|e] [ex]"},
 	{ "setreg", "str", setreg_cmd, 2, "Set the value of an exception register", "$reg value"},
 	{ "hwena",  NULL, hwena_cmd, 0, "Enable or disable the HW debugger", "[on|off]" },
 	{ "hwregs", NULL, hwregs_cmd, 0, "Print or change the current HW breakpoint setup (v1.5 only)", "[reg=val]..." },
 	{ "hwbp", NULL, hwbp_cmd, 1, "Set a hardware instruction breakpoint", "addr [mask]" },
-	{ "bpset", "bp", bpset_cmd, 1, "Set a break point", "addr"},
+	{ "bpset", "bp", bpset_cmd, 1, "Set a break point, optionally ignoring the first count hits", "addr [count]"},
+	{ "bpdel", "bd", bpdel_cmd, 1, "Delete a break point", "id"},
 	{ "bpprint", "bt", bpprint_cmd, 0, "Print the current breakpoints", ""},
+	{ "wpset", "ws", wpset_cmd, 2, "Set a watchpoint, in the HW registers if free otherwise sampled (writes only)", "addr size [r|w|rw] [count]"},
+	{ "wpdel", "wd", wpdel_cmd, 1, "Delete a watchpoint", "id"},
+	{ "wpprint", "wt", wpprint_cmd, 0, "Print the current watchpoints", ""},
+	{ "wpperiod", NULL, wpperiod_cmd, 1, "Set the sampling period of the sampled watchpoints", "us"},
 	{ "step", "s", step_cmd, 0, "Step the next instruction", ""},
 	{ "skip", "k", skip_cmd, 0, "Skip the next instruction (i.e. jump over jals)", ""},
 	{ "symload", "syl", symload_cmd, 1, "Load a symbol file", "file.sym"},
+	{ "symlazy", "syz", symlazy_cmd, 1, "Load a symbol file, reading the names from it when needed", "file.sym"},
 	{ "symlist", "syt", symlist_cmd, 0, "List the loaded symbols", ""},
 	{ "symprint", "syp", symprint_cmd, 1, "Print the symbols for a module", "modname"},
+	{ "symdel", "syd", symdel_cmd, 1, "Delete the symbols for a module", "modname"},
 	{ "symbyaddr", "sya", symbyaddr_cmd, 1, "Print the symbol at the specified address", "addr"},
-	{ "symbyname", "syn", symbyname_cmd, 1, "Print the specified symbol address", "module:symname"},
+	{ "symbyname", "syn", symbyname_cmd, 1, "Print the specified symbol address", "[module:]symname"},
+	{ "symfind", "syf", symfind_cmd, 1, "List the symbols starting with a prefix", "[module:]prefix"},
 
 	{ "misc", NULL, NULL, 0, "Miscellaneous commands (e.g. USB, exit)", NULL},
 	{ "usbmon", "umn", usbmasson_cmd, 0, "Enable USB mass storage device", ""},
@@ -4196,6 +4629,120 @@ int psplinkParseCommand(char *command)
 
 #ifndef USB_ONLY
 
+/* Most symbols listed when a completion is ambiguous */
+#define COMPLETE_MAX_PRINT 32
+
+struct SymbolComplete
+{
+	char match[CLI_MAX];
+	/* Length of the prefix common to all matches */
+	int  len;
+	int  count;
+	int  print;
+};
+
+static int complete_symbol(const char *modname, const struct SymfileEntry *sym, void *arg)
+{
+	struct SymbolComplete *comp = (struct SymbolComplete *) arg;
+
+	if(comp->print)
+	{
+		printf("%s:%s\n", modname, sym->name);
+	}
+	else if(comp->count == 0)
+	{
+		strncpy(comp->match, sym->name, CLI_MAX - 1);
+		comp->match[CLI_MAX - 1] = 0;
+		comp->len = strlen(comp->match);
+	}
+	else
+	{
+		int i = 0;
+
+		while((i < comp->len) && (comp->match[i] == sym->name[i]))
+		{
+			i++;
+		}
+		comp->len = i;
+	}
+
+	comp->count++;
+
+	return !comp->print || (comp->count < COMPLETE_MAX_PRINT);
+}
+
+static void cli_add_char(char ch)
+{
+	if(g_cli_pos < (CLI_MAX - 1))
+	{
+		g_cli[g_cli_pos++] = ch;
+		g_cli[g_cli_pos] = 0;
+		putchar(ch);
+	}
+}
+
+/* Complete an unterminated ?symbol? at the end of the command line */
+static void cli_complete_symbol(void)
+{
+	struct SymbolComplete comp;
+	const char *word = NULL;
+	const char *name;
+	int typed;
+	int i;
+
+	g_cli[g_cli_pos] = 0;
+	for(i = 0; i < g_cli_pos; i++)
+	{
+		if(g_cli[i] == '?')
+		{
+			word = word ? NULL : &g_cli[i+1];
+		}
+	}
+
+	if(word == NULL)
+	{
+		return;
+	}
+
+	/* Skip the size marker and module name */
+	if(*word == '`')
+	{
+		word++;
+	}
+	name = strchr(word, ':');
+	name = name ? name + 1 : word;
+	typed = strlen(name);
+
+	memset(&comp, 0, sizeof(comp));
+	symbolEnumPrefix(word, complete_symbol, &comp);
+	if(comp.count == 0)
+	{
+		return;
+	}
+
+	if((comp.len > typed) || (comp.count == 1))
+	{
+		for(i = typed; i < comp.len; i++)
+		{
+			cli_add_char(comp.match[i]);
+		}
+
+		if(comp.count == 1)
+		{
+			cli_add_char('?');
+		}
+	}
+	else
+	{
+		printf("\n");
+		comp.count = 0;
+		comp.print = 1;
+		symbolEnumPrefix(word, complete_symbol, &comp);
+		print_prompt();
+		printf("%s", g_cli);
+	}
+}
+
 /* Process command line */
 static int process_cli()
 {
@@ -4332,7 +4879,8 @@ int shellProcessChar(int ch)
 					  putchar(8);
 				  }
 				  break;
-		case 9  : break; // Ignore tab
+		case 9  : cli_complete_symbol();
+				  break;
 		case 13 :		 // Enter key 
 		case 10 : if(process_cli() == CMD_EXITSHELL) 
 				  {
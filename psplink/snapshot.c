@@ -0,0 +1,200 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * snapshot.c - PSPLINK incremental memory snapshots
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+#include <pspkernel.h>
+#include <pspsysmem_kernel.h>
+#include <stdio.h>
+#include <string.h>
+#include <usbhostfs.h>
+#include "util.h"
+#include "snapshot.h"
+
+#define SNAPSHOT_PARTITION 1
+
+/* The header and run table are sent in one piece from the start of the block, followed by
+ * two hash words for each page of the region */
+static struct
+{
+	SceUID block;
+	u32 addr;
+	u32 size;
+	u32 npages;
+	u32 seq;
+	char path[1024];
+	struct SnapshotHeader *header;
+	struct SnapshotRun *runs;
+	u32 *hashes;
+} g_snap = { -1 };
+
+static void hash_page(const u32 *data, u32 words, u32 *hash)
+{
+	u32 h1 = 0x811C9DC5;
+	u32 h2 = 0;
+	u32 i;
+
+	for(i = 0; i < words; i++)
+	{
+		h1 = (h1 ^ data[i]) * 0x01000193;
+		h2 = ((h2 << 5) | (h2 >> 27)) + data[i];
+	}
+
+	hash[0] = h1;
+	hash[1] = h2;
+}
+
+static int snapshot_init(u32 addr, u32 size, const char *path)
+{
+	u32 maxruns;
+
+	snapshotReset();
+
+	g_snap.npages = (size + SNAPSHOT_PAGE - 1) / SNAPSHOT_PAGE;
+	/* At worst every other page changes */
+	maxruns = (g_snap.npages + 1) / 2;
+	g_snap.block = sceKernelAllocPartitionMemory(SNAPSHOT_PARTITION, "Snapshot", PSP_SMEM_Low,
+			sizeof(struct SnapshotHeader) + (maxruns * sizeof(struct SnapshotRun)) + (g_snap.npages * 2 * sizeof(u32)), NULL);
+	if(g_snap.block < 0)
+	{
+		printf("Error could not allocate snapshot memory %08X\n", g_snap.block);
+		return 0;
+	}
+
+	g_snap.header = sceKernelGetBlockHeadAddr(g_snap.block);
+	g_snap.runs = (struct SnapshotRun *) (g_snap.header + 1);
+	g_snap.hashes = (u32 *) (g_snap.runs + maxruns);
+	g_snap.addr = addr;
+	g_snap.size = size;
+	g_snap.seq = 0;
+	strcpy(g_snap.path, path);
+
+	return 1;
+}
+
+/* Append the pages changed since the last snapshot to path, starting a new file with the
+ * whole region when the region or path differ. Returns the number of bytes sent or < 0 */
+int snapshotTake(u32 addr, u32 size, const char *path)
+{
+	BulkWriteFunc bulkwrite;
+	struct SnapshotHeader *header;
+	struct SnapshotRun *runs;
+	u32 nruns = 0;
+	u32 changed = 0;
+	u32 page;
+	u32 i;
+	int fd;
+	int ok;
+
+	bulkwrite = find_bulkwrite();
+	if(bulkwrite == NULL)
+	{
+		printf("Error could not find the usbhostfs bulk channel\n");
+		return -1;
+	}
+
+	addr &= ~3;
+	size &= ~3;
+	if((size == 0) || (strlen(path) >= sizeof(g_snap.path)))
+	{
+		printf("Error invalid snapshot region or path\n");
+		return -1;
+	}
+
+	if((g_snap.block < 0) || (addr != g_snap.addr) || (size != g_snap.size) || (strcmp(path, g_snap.path)))
+	{
+		if(!snapshot_init(addr, size, path))
+		{
+			return -1;
+		}
+	}
+
+	runs = g_snap.runs;
+	for(page = 0; page < g_snap.npages; page++)
+	{
+		u32 offset;
+		u32 len;
+		u32 hash[2];
+		u32 *old;
+
+		offset = page * SNAPSHOT_PAGE;
+		len = (size - offset) > SNAPSHOT_PAGE ? SNAPSHOT_PAGE : (size - offset);
+		old = &g_snap.hashes[page * 2];
+		hash_page((u32 *) (addr + offset), len / 4, hash);
+		if((g_snap.seq > 0) && (hash[0] == old[0]) && (hash[1] == old[1]))
+		{
+			continue;
+		}
+
+		old[0] = hash[0];
+		old[1] = hash[1];
+		if((nruns > 0) && ((runs[nruns-1].offset + runs[nruns-1].size) == offset))
+		{
+			runs[nruns-1].size += len;
+		}
+		else
+		{
+			runs[nruns].offset = offset;
+			runs[nruns].size = len;
+			nruns++;
+		}
+		changed += len;
+	}
+
+	header = g_snap.header;
+	memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+	header->seq = g_snap.seq;
+	header->addr = addr;
+	header->size = size;
+	header->pagesize = SNAPSHOT_PAGE;
+	header->nruns = nruns;
+	header->time = sceKernelGetSystemTimeLow();
+	header->changed = changed;
+
+	fd = sceIoOpen(path, PSP_O_CREAT | PSP_O_WRONLY | HOSTFS_BULK_OPEN
+			| (g_snap.seq == 0 ? PSP_O_TRUNC : PSP_O_APPEND), 0777);
+	if(fd < 0)
+	{
+		printf("Could not open file '%s' for writing 0x%08X\n", path, fd);
+		snapshotReset();
+		return -1;
+	}
+
+	/* Pages are sent straight from memory, one written to while it is sent can end up torn
+	 * just as with savemem */
+	i = sizeof(struct SnapshotHeader) + (nruns * sizeof(struct SnapshotRun));
+	ok = (write_bulk(bulkwrite, header, i) == i);
+	for(i = 0; (ok) && (i < nruns); i++)
+	{
+		ok = (write_bulk(bulkwrite, (void *) (addr + runs[i].offset), runs[i].size) == runs[i].size);
+	}
+	sceIoClose(fd);
+
+	if(!ok)
+	{
+		/* The file no longer matches the hashes, start again with a full snapshot */
+		printf("Error writing snapshot %d\n", g_snap.seq);
+		snapshotReset();
+		return -1;
+	}
+
+	g_snap.seq++;
+
+	return changed;
+}
+
+void snapshotReset(void)
+{
+	if(g_snap.block >= 0)
+	{
+		sceKernelFreePartitionMemory(g_snap.block);
+		g_snap.block = -1;
+	}
+}
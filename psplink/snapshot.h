@@ -0,0 +1,46 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * snapshot.h - PSPLINK incremental memory snapshots
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#define SNAPSHOT_MAGIC "SNAP"
+#define SNAPSHOT_PAGE  4096
+
+/* Each snapshot in the file is a header, a table of runs and then the data of each run.
+ * The first snapshot in a file contains the whole region, later ones only the pages
+ * which changed since the previous one */
+struct SnapshotHeader
+{
+	char magic[4];
+	u32 seq;
+	u32 addr;
+	u32 size;
+	u32 pagesize;
+	u32 nruns;
+	/* Low word of the system time in microseconds */
+	u32 time;
+	/* Total size of the runs */
+	u32 changed;
+};
+
+struct SnapshotRun
+{
+	u32 offset;
+	u32 size;
+};
+
+int snapshotTake(u32 addr, u32 size, const char *path);
+void snapshotReset(void);
+
+#endif
@@ -20,8 +20,6 @@
 #include "psplink.h"
 #include "symbols.h"
 
-/* TODO: Perhaps needs some sort of lock (disable interrupts?) */
-
 #define SYMFILE_MAGIC "SYMS"
 #define MODNAME_SIZE  28
 
@@ -34,46 +32,217 @@ struct SymfileHeader
 	u32  strsize;
 } __attribute__((packed));
 
+/* Compressed symbol files. Symbols are sorted on address, each one is 
+ * encoded as varints of the address delta, the size, the length of the 
+ * prefix shared with the previous name and the length of the rest of the 
+ * name, followed by the rest of the name */
+#define SYMFILE_ZMAGIC   "SYMZ"
+#define SYMFILE_ZVERSION 1
+
+struct SymfileZHeader
+{
+	char magic[4];
+	char modname[MODNAME_SIZE];
+	u32  version;
+	u32  symcount;
+	/* Size of the decoded string table */
+	u32  strsize;
+	/* Size of the encoded symbols following the header */
+	u32  datasize;
+} __attribute__((packed));
+
+#define SYMREADER_SIZE 512
+
+struct SymReader
+{
+	SceUID fd;
+	/* Bytes left in the file after the buffer */
+	unsigned int left;
+	unsigned int pos;
+	unsigned int len;
+	unsigned char buf[SYMREADER_SIZE];
+};
+
 struct SymbolFile
 {
 	struct SymbolFile *pNext, *pPrev;
 	void *data;
 	unsigned int size;
+	/* Segment the file was allocated in and the size of the allocation */
+	struct SymbolSegment *pSeg;
+	unsigned int allocsize;
+	/* Number of module relative symbols, sorted before the absolute ones */
+	int relcount;
+	/* Name hash index, buckets and chains hold symbol indexes */
+	unsigned short *hash;
+	unsigned short *chain;
+	unsigned int hashmask;
+	/* Open file for lazy tables, which leave the names on the host and 
+	 * keep string offsets in the entries. -1 for resident tables */
+	SceUID fd;
+};
+
+/* Block of a lazy string table read in one go */
+#define NAMEBLOCK_SIZE 512
+/* Number of lazy symbols whose names are kept */
+#define NAMECACHE_SIZE 32
+
+struct NameBlock
+{
+	struct SymbolFile *pFile;
+	unsigned int offset;
+	unsigned int len;
+	char data[NAMEBLOCK_SIZE];
+};
+
+struct NameCache
+{
+	struct SymbolFile *pFile;
+	int index;
+	unsigned int stamp;
+	/* Copy of the entry with the name pointing into the cache */
+	struct SymfileEntry entry;
+	char name[SYMBOL_MAXNAME];
+};
+
+#define SYMHASH_MIN 16
+/* End of a hash chain, also limits the number of symbols in a file */
+#define SYMHASH_END 0xFFFF
+
+/* Relative addresses are all below this so sorting on the raw address 
+ * gives two runs, each of which stays in order once the base is added */
+#define SYM_ABSOLUTE(addr) ((addr) >= 0x08000000)
+
+/* Cache of the last few modules looked up by address */
+#define SYMCACHE_SIZE 4
+
+struct SymbolCache
+{
+	SceUID uid;
+	unsigned int text_addr;
+	struct SymbolFile *pFile;
+};
+
+/* Symbol files are packed into segments, each one a partition block. New
+ * segments are added as needed and released when their last file is freed */
+struct SymbolSegment
+{
+	struct SymbolSegment *pNext;
+	SceUID block;
+	/* Size of the block and the bytes used, including this header */
+	unsigned int size;
+	unsigned int used;
 };
 
-#define HEAP_SIZE (64*1024)
+#define SEGMENT_SIZE (64*1024)
 #define HEAP_PARTITION 1
 
-static SceUID g_block_id = -1;
-static void *g_baseaddr = NULL;
-static void *g_curraddr = NULL;
+static struct SymbolSegment *g_pSegs = NULL;
 static struct SymbolFile *g_pHead = NULL;
+static struct SymbolCache g_symcache[SYMCACHE_SIZE];
+static int g_symcachenext = 0;
+/* Held by every lookup, load and delete. Loads and deletes move the tables
+ * around, and lookups use the module cache and the lazy name buffers */
+static SceUID g_symsema = -1;
+static struct NameBlock g_nameblock;
+static struct NameCache g_namecache[NAMECACHE_SIZE];
+static unsigned int g_namestamp = 0;
+
+static void lock_symbols(void)
+{
+	(void) sceKernelWaitSema(g_symsema, 1, 0);
+}
+
+static void unlock_symbols(void)
+{
+	(void) sceKernelSignalSema(g_symsema, 1);
+}
+
+static void flush_cache(void)
+{
+	memset(g_symcache, 0, sizeof(g_symcache));
+	g_symcachenext = 0;
+	memset(g_namecache, 0, sizeof(g_namecache));
+	g_nameblock.pFile = NULL;
+}
+
+static struct SymbolSegment *alloc_segment(unsigned int size)
+{
+	struct SymbolSegment *pSeg;
+	SceUID block;
+
+	size = (size + sizeof(struct SymbolSegment) + 255) & ~255;
+	if(size < SEGMENT_SIZE)
+	{
+		size = SEGMENT_SIZE;
+	}
+
+	block = sceKernelAllocPartitionMemory(HEAP_PARTITION, "symbols", PSP_SMEM_Low, size, NULL);
+	if(block < 0)
+	{
+		printf("Error could not allocate memory buffer %08X\n", block);
+		return NULL;
+	}
+
+	pSeg = sceKernelGetBlockHeadAddr(block);
+	pSeg->block = block;
+	pSeg->size = size;
+	pSeg->used = sizeof(struct SymbolSegment);
+	pSeg->pNext = g_pSegs;
+	g_pSegs = pSeg;
+
+	return pSeg;
+}
+
+static void free_segment(struct SymbolSegment *pSeg)
+{
+	struct SymbolSegment **pPrev;
 
-/* TODO: If we have run out of memory try and coallecse any free space */
-static struct SymbolFile *alloc_symbolfile(unsigned int size)
+	pPrev = &g_pSegs;
+	while(*pPrev)
+	{
+		if(*pPrev == pSeg)
+		{
+			*pPrev = pSeg->pNext;
+			sceKernelFreePartitionMemory(pSeg->block);
+			break;
+		}
+		pPrev = &(*pPrev)->pNext;
+	}
+}
+
+static struct SymbolFile *alloc_symbolfile(unsigned int size, unsigned int extra)
 {
 	struct SymbolFile *pRet = NULL;
+	struct SymbolSegment *pSeg;
 	unsigned int total_size;
 
-	if(g_block_id < 0)
+	total_size = ((size + 3) & ~3) + ((extra + 3) & ~3) + sizeof(struct SymbolFile);
+
+	pSeg = g_pSegs;
+	while(pSeg)
 	{
-		g_block_id = sceKernelAllocPartitionMemory(HEAP_PARTITION, "symbols", PSP_SMEM_Low, HEAP_SIZE, NULL);
-		if(g_block_id < 0)
+		if((pSeg->size - pSeg->used) >= total_size)
 		{
-			printf("Error could not allocate memory buffer %08X\n", g_block_id);
-			return NULL;
+			break;
 		}
-		g_baseaddr = g_curraddr = sceKernelGetBlockHeadAddr(g_block_id);
+		pSeg = pSeg->pNext;
 	}
 
-	total_size = ((size + 3) & ~3) + sizeof(struct SymbolFile);
+	if(pSeg == NULL)
+	{
+		pSeg = alloc_segment(total_size);
+	}
 
-	if((g_curraddr + size) < (g_baseaddr + HEAP_SIZE))
+	if(pSeg)
 	{
-		pRet = g_curraddr;
+		pRet = ((void *) pSeg) + pSeg->used;
 		memset(pRet, 0, total_size);
 		pRet->size = size;
-		pRet->data = g_curraddr + sizeof(struct SymbolFile);
+		pRet->data = ((void *) pRet) + sizeof(struct SymbolFile);
+		pRet->pSeg = pSeg;
+		pRet->allocsize = total_size;
+		pRet->fd = -1;
 		if(g_pHead == NULL)
 		{
 			g_pHead = pRet;
@@ -91,7 +260,7 @@ static struct SymbolFile *alloc_symbolfile(unsigned int size)
 			pRet->pPrev = pFile;
 		}
 
-		g_curraddr += total_size;
+		pSeg->used += total_size;
 	}
 	else
 	{
@@ -101,10 +270,76 @@ static struct SymbolFile *alloc_symbolfile(unsigned int size)
 	return pRet;
 }
 
+/* Map a file pointer to where it will be after a compaction */
+static struct SymbolFile *moved_file(struct SymbolFile *pFile, void *start, void *end, unsigned int delta)
+{
+	if(((void *) pFile >= start) && ((void *) pFile < end))
+	{
+		return ((void *) pFile) - delta;
+	}
+
+	return pFile;
+}
+
+/* Close the gap left by a freed file by moving the rest of its segment down */
+static void compact_segment(struct SymbolSegment *pSeg, void *gap, unsigned int delta)
+{
+	struct SymbolFile *pFile;
+	void *start = gap + delta;
+	void *end = ((void *) pSeg) + pSeg->used;
+
+	/* Fix up the pointers in place, memmove then carries them to the new location */
+	pFile = g_pHead;
+	while(pFile)
+	{
+		struct SymbolFile *pNext = pFile->pNext;
+
+		if(((void *) pFile >= start) && ((void *) pFile < end))
+		{
+			if((pFile->hash) && (pFile->fd < 0))
+			{
+				struct SymfileHeader *pHead;
+				struct SymfileEntry  *pEntry;
+				int i;
+
+				pHead = (struct SymfileHeader *) pFile->data;
+				pEntry = (struct SymfileEntry *) (pFile->data + sizeof(struct SymfileHeader));
+				for(i = 0; i < pHead->symcount; i++)
+				{
+					pEntry[i].name -= delta;
+				}
+			}
+			if(pFile->hash)
+			{
+				pFile->hash = ((void *) pFile->hash) - delta;
+				pFile->chain = ((void *) pFile->chain) - delta;
+			}
+			pFile->data -= delta;
+		}
+
+		pFile->pNext = moved_file(pFile->pNext, start, end, delta);
+		pFile->pPrev = moved_file(pFile->pPrev, start, end, delta);
+		pFile = pNext;
+	}
+	g_pHead = moved_file(g_pHead, start, end, delta);
+
+	memmove(gap, start, end - start);
+	pSeg->used -= delta;
+}
+
 static void free_symbolfile(struct SymbolFile *pSym)
 {
 	if(pSym)
 	{
+		struct SymbolSegment *pSeg = pSym->pSeg;
+
+		if(pSym->fd >= 0)
+		{
+			sceIoClose(pSym->fd);
+		}
+
+		/* The caller holds the symbol lock, so no lookup is using the tables we move */
+		flush_cache();
 		if(pSym->pPrev == NULL)
 		{
 			g_pHead = pSym->pNext;
@@ -118,9 +353,29 @@ static void free_symbolfile(struct SymbolFile *pSym)
 		{
 			pSym->pNext->pPrev = pSym->pPrev;
 		}
+
+		if(pSeg->used == sizeof(struct SymbolSegment) + pSym->allocsize)
+		{
+			free_segment(pSeg);
+		}
+		else
+		{
+			compact_segment(pSeg, pSym, pSym->allocsize);
+		}
 	}
 }
 
+static const char *get_modname(const struct SymbolFile *pFile, char *name)
+{
+	const struct SymfileHeader *pHead;
+
+	pHead = (const struct SymfileHeader *) pFile->data;
+	memcpy(name, pHead->modname, MODNAME_SIZE);
+	name[MODNAME_SIZE] = 0;
+
+	return name;
+}
+
 static struct SymbolFile *find_symbolfile(const char *modname)
 {
 	struct SymbolFile *pNext;
@@ -135,13 +390,7 @@ static struct SymbolFile *find_symbolfile(const char *modname)
 
 	while(pNext)
 	{
-		struct SymfileHeader *pHead;
-
-		pHead = (struct SymfileHeader *) pNext->data;
-		memcpy(name, pHead->modname, MODNAME_SIZE);
-		name[MODNAME_SIZE] = 0;
-
-		if(strcmp(name, modname) == 0)
+		if(strcmp(get_modname(pNext, name), modname) == 0)
 		{
 			break;
 		}
@@ -154,236 +403,676 @@ static struct SymbolFile *find_symbolfile(const char *modname)
 
 static void free_mem(void)
 {
-	if(g_block_id >= 0)
+	while(g_pSegs)
 	{
-		sceKernelFreePartitionMemory(g_block_id);
-		g_block_id = -1;
+		free_segment(g_pSegs);
 	}
 }
 
-const struct SymfileEntry* symbolFindByAddress(unsigned int addr, unsigned int *baseaddr)
+/* Get the symbol file and text address of the module containing addr, only 
+ * queries the module info when it is not in the cache */
+static struct SymbolFile *find_module_symbols(unsigned int addr, unsigned int *baseaddr)
 {
 	SceKernelModuleInfo info;
+	struct SymbolFile *pFile = NULL;
 	SceUID uid;
-	struct SymfileEntry *pRet = NULL;
+	int i;
 
-	uid = refer_module_by_addr(addr, &info);
-	if(uid >= 0)
+	uid = find_module_by_addr(addr);
+	if(uid < 0)
 	{
-		struct SymbolFile *pFile;
-
-		pFile = find_symbolfile(info.name);
-		if(pFile)
-		{
-			struct SymfileHeader *pHead;
-			struct SymfileEntry  *pEntry;
-			unsigned int ba;
-			int i;
-
-			pHead = (struct SymfileHeader *) pFile->data;
-			pEntry = (struct SymfileEntry *) (pFile->data + sizeof(struct SymfileHeader));
-			ba = info.text_addr;
-			/* TODO: Really should do a quick search */
-			for(i = 0; i < pHead->symcount; i++)
-			{
-				unsigned int bottom, top;
-
-				if(pEntry[i].addr >= 0x08000000)
-				{
-					bottom = pEntry[i].addr;
-				}
-				else
-				{
-					bottom = pEntry[i].addr + ba;
-				}
-
-				if((pEntry[i].size == 0) && (i < (pHead->symcount-1)))
-				{
-					top = pEntry[i+1].addr;
-				}
-				else
-				{
-					top = pEntry[i].size + bottom;
-				}
+		return NULL;
+	}
 
-				if((addr >= bottom) && (addr < top))
-				{
-					pRet = &pEntry[i];
-					/* Return base address in addr */
-					if(baseaddr)
-					{
-						*baseaddr = ba;
-					}
-					break;
-				}
-			}
-		}
-		else
+	for(i = 0; i < SYMCACHE_SIZE; i++)
+	{
+		if(g_symcache[i].uid == uid)
 		{
-			//printf("Error could not find symbol file for module %s\n", info.name);
+			pFile = g_symcache[i].pFile;
+			*baseaddr = g_symcache[i].text_addr;
+			break;
 		}
 	}
-	else
+
+	if(i < SYMCACHE_SIZE)
 	{
-		//printf("Error could not find module at addr %08X\n", addr);
+		return pFile;
 	}
 
-	return pRet;
+	if(!psplinkReferModule(uid, &info))
+	{
+		return NULL;
+	}
+
+	pFile = find_symbolfile(info.name);
+	*baseaddr = info.text_addr;
+
+	g_symcache[g_symcachenext].uid = uid;
+	g_symcache[g_symcachenext].text_addr = info.text_addr;
+	g_symcache[g_symcachenext].pFile = pFile;
+	g_symcachenext = (g_symcachenext + 1) % SYMCACHE_SIZE;
+
+	return pFile;
 }
 
-const char *symbolFindNameByAddress(unsigned int addr)
+static void swap_symbol(struct SymfileEntry *pEntry, unsigned short *aux, int a, int b)
 {
-	const struct SymfileEntry *sym;
+	struct SymfileEntry temp;
+
+	temp = pEntry[a];
+	pEntry[a] = pEntry[b];
+	pEntry[b] = temp;
 
-	sym = symbolFindByAddress(addr, NULL);
-	if(sym)
+	if(aux)
 	{
-		return sym->name;
+		unsigned short val;
+
+		val = aux[a];
+		aux[a] = aux[b];
+		aux[b] = val;
 	}
+}
+
+static void sift_symbol(struct SymfileEntry *pEntry, unsigned short *aux, int root, int count)
+{
+	while(((root * 2) + 1) < count)
+	{
+		int child;
+
+		child = (root * 2) + 1;
+		if(((child + 1) < count) && (pEntry[child].addr < pEntry[child+1].addr))
+		{
+			child++;
+		}
+
+		if(pEntry[root].addr >= pEntry[child].addr)
+		{
+			break;
+		}
 
-	return "Unknown";
+		swap_symbol(pEntry, aux, root, child);
+		root = child;
+	}
 }
 
-int symbolFindNameByAddressEx(unsigned int addr, char *output, int size)
+/* Heap sort the symbols on address, no qsort in the kernel libc. aux 
+ * if not NULL is a per symbol array which is kept in step */
+static void sort_symbols(struct SymfileEntry *pEntry, unsigned short *aux, int count)
 {
-	const struct SymfileEntry *pSym;
-	unsigned int baseaddr;
-	char symtemp[256];
+	int i;
 
-	if((output == NULL) || (size <= 0))
+	for(i = (count / 2) - 1; i >= 0; i--)
 	{
-		return 0;
+		sift_symbol(pEntry, aux, i, count);
 	}
 
-	pSym = symbolFindByAddress(addr, &baseaddr);
-	if(pSym)
+	for(i = count - 1; i > 0; i--)
 	{
-		unsigned int reladdr;
+		swap_symbol(pEntry, aux, 0, i);
+		sift_symbol(pEntry, aux, 0, i);
+	}
+}
 
-		reladdr = pSym->addr;
-		if(baseaddr <= reladdr)
-		{
-			reladdr = reladdr - baseaddr;
-		}
-		if((baseaddr + reladdr) < addr)
+/* Find the symbol covering addr in the sorted run first to last-1, -1 if none */
+static int search_symbols(const struct SymfileEntry *pEntry, int first, int last, unsigned int addr)
+{
+	int low = first;
+	int high = last - 1;
+	int found = -1;
+	unsigned int top;
+
+	while(low <= high)
+	{
+		int mid = (low + high) / 2;
+
+		if(pEntry[mid].addr <= addr)
 		{
-			sprintf(symtemp, "%s+0x%x", pSym->name,
-					addr - (baseaddr + reladdr));
+			found = mid;
+			low = mid + 1;
 		}
 		else
 		{
-			sprintf(symtemp, "%s", pSym->name);
+			high = mid - 1;
 		}
 	}
+
+	if(found < 0)
+	{
+		return -1;
+	}
+
+	/* Unsized symbols run up to the next one */
+	if((pEntry[found].size == 0) && ((found + 1) < last))
+	{
+		top = pEntry[found+1].addr;
+	}
 	else
 	{
-		return 0;
+		top = pEntry[found].addr + pEntry[found].size;
 	}
 
-	strncpy(output, symtemp, size);
-	output[size-1] = 0;
+	if(addr >= top)
+	{
+		return -1;
+	}
 
-	return 1;
+	return found;
 }
 
-unsigned int symbolFindByName(const char *name, unsigned int *size)
+/* Read a name from a lazy string table into buf, must hold the symbol lock */
+static int read_name(struct SymbolFile *pFile, unsigned int ofs, char *buf)
 {
-	const char *modname = NULL;
-	const char *symname = NULL;
-	char symbuf[128];
-	char *pcolon;
-	struct SymbolFile *pFile;
-	unsigned int addr = 0;
-	SceUID uid;
-	SceKernelModuleInfo info;
+	struct SymfileHeader *pHead;
+	struct NameBlock *pBlock = &g_nameblock;
+	int i;
 
-	strncpy(symbuf, name, 127);
-	symbuf[127] = 0;
-	pcolon = strchr(symbuf, ':');
-	if(pcolon)
-	{
-		*pcolon = 0;
-		pcolon++;
-		modname = symbuf;
-		symname = pcolon;
-	}
-	else
+	pHead = (struct SymfileHeader *) pFile->data;
+	buf[0] = 0;
+	if(ofs >= pHead->strsize)
 	{
-		printf("Error symbol address must be of the form module:name\n");
 		return 0;
 	}
 
-	uid = refer_module_by_name(modname, &info);
-	if(uid < 0)
+	/* Reread starting at the name unless the block holds all of it */
+	if((pBlock->pFile != pFile) || (ofs < pBlock->offset) || (ofs >= (pBlock->offset + pBlock->len))
+			|| ((memchr(&pBlock->data[ofs - pBlock->offset], 0, pBlock->offset + pBlock->len - ofs) == NULL)
+				&& ((pBlock->offset + pBlock->len) < pHead->strsize)))
 	{
-		printf("Error cannot find loaded module %s\n", modname);
-		return 0;
+		pBlock->pFile = NULL;
+		pBlock->offset = ofs;
+		pBlock->len = pHead->strsize - ofs;
+		if(pBlock->len > NAMEBLOCK_SIZE)
+		{
+			pBlock->len = NAMEBLOCK_SIZE;
+		}
+
+		if((sceIoLseek32(pFile->fd, pHead->strstart + ofs, PSP_SEEK_SET) < 0)
+				|| (sceIoRead(pFile->fd, pBlock->data, pBlock->len) != pBlock->len))
+		{
+			return 0;
+		}
+		pBlock->pFile = pFile;
 	}
 
-	pFile = find_symbolfile(modname);
-	if(pFile)
+	for(i = 0; (i < (SYMBOL_MAXNAME - 1)) && ((ofs + i) < (pBlock->offset + pBlock->len)); i++)
 	{
-		struct SymfileHeader *pHead;
-		struct SymfileEntry *pEntry;
-		int i;
-
-		pHead = (struct SymfileHeader *) pFile->data;
-		pEntry = (struct SymfileEntry *) (pFile->data + sizeof(struct SymfileHeader));
-
-		for(i = 0; i < pHead->symcount; i++)
+		buf[i] = pBlock->data[ofs - pBlock->offset + i];
+		if(buf[i] == 0)
 		{
-			if(strcmp(symname, pEntry[i].name) == 0)
-			{
-				if(pEntry[i].addr >= 0x08000000)
-				{
-					addr = pEntry[i].addr;
-				}
-				else
-				{
-					addr = info.text_addr + pEntry[i].addr;
-				}
-				if(size)
-				{
-					*size = pEntry[i].size;
-				}
-				break;
-			}
+			break;
 		}
 	}
-	else
+	buf[i] = 0;
+
+	return 1;
+}
+
+/* Get the name of a symbol, lazy names are read into buf (SYMBOL_MAXNAME bytes) */
+static const char *entry_name(struct SymbolFile *pFile, const struct SymfileEntry *pEntry, char *buf)
+{
+	if(pFile->fd < 0)
 	{
-		printf("Error could not file module %s's symbols\n", modname);
+		return pEntry->name;
 	}
 
-	return addr;
+	read_name(pFile, (u32) pEntry->name, buf);
+
+	return buf;
 }
 
-void symbolPrintLoadList(void)
+/* Get a symbol entry with a usable name. For lazy tables this is a copy in 
+ * the name cache. Either way it is only valid while the symbol lock is held */
+static const struct SymfileEntry *resolve_entry(struct SymbolFile *pFile, int index)
 {
-	if(g_pHead)
+	struct SymfileEntry *pEntry;
+	struct NameCache *pCache = NULL;
+	int i;
+
+	pEntry = (struct SymfileEntry *) (pFile->data + sizeof(struct SymfileHeader));
+	if(pFile->fd < 0)
 	{
-		struct SymbolFile *pNext;
+		return &pEntry[index];
+	}
 
-		pNext = g_pHead;
-		while(pNext)
+	for(i = 0; i < NAMECACHE_SIZE; i++)
+	{
+		if((g_namecache[i].pFile == pFile) && (g_namecache[i].index == index))
 		{
-			struct SymfileHeader *pHead;
+			pCache = &g_namecache[i];
+			break;
+		}
+
+		/* Otherwise evict the least recently used */
+		if((pCache == NULL) || (g_namecache[i].stamp < pCache->stamp))
+		{
+			pCache = &g_namecache[i];
+		}
+	}
+
+	if((pCache->pFile != pFile) || (pCache->index != index))
+	{
+		pCache->pFile = NULL;
+		if(read_name(pFile, (u32) pEntry[index].name, pCache->name))
+		{
+			pCache->pFile = pFile;
+			pCache->index = index;
+			pCache->entry = pEntry[index];
+			pCache->entry.name = pCache->name;
+		}
+	}
+	pCache->stamp = ++g_namestamp;
+
+	if(pCache->pFile == NULL)
+	{
+		return NULL;
+	}
+
+	return &pCache->entry;
+}
+
+static unsigned int hash_name(const char *name)
+{
+	unsigned int hash = 5381;
+
+	while(*name)
+	{
+		hash = (hash * 33) + (unsigned char) *name++;
+	}
+
+	return hash;
+}
+
+/* Number of hash buckets for count symbols, a power of 2 */
+static unsigned int hash_buckets(unsigned int count)
+{
+	unsigned int buckets = SYMHASH_MIN;
+
+	while((buckets * 2) <= count)
+	{
+		buckets *= 2;
+	}
+
+	return buckets;
+}
+
+/* Size of the name index for a file, symcount is the most symbols it could hold */
+static unsigned int hash_size(unsigned int symcount)
+{
+	return (hash_buckets(symcount) + symcount) * sizeof(unsigned short);
+}
+
+/* Sort the symbols and build the name index in the space after the file data */
+static void build_index(struct SymbolFile *pFile)
+{
+	struct SymfileHeader *pHead;
+	struct SymfileEntry  *pEntry;
+	unsigned int buckets;
+	int i;
+
+	pHead = (struct SymfileHeader *) pFile->data;
+	pEntry = (struct SymfileEntry *) (pFile->data + sizeof(struct SymfileHeader));
+	buckets = hash_buckets(pHead->symcount);
+
+	pFile->hash = (unsigned short *) (pFile->data + ((pFile->size + 3) & ~3));
+	pFile->chain = pFile->hash + buckets;
+	pFile->hashmask = buckets - 1;
+	memset(pFile->hash, 0xFF, buckets * sizeof(unsigned short));
+
+	/* Hash in file order, lazy string tables are then read sequentially. 
+	 * The chains hold the buckets until the symbols are sorted */
+	for(i = 0; i < pHead->symcount; i++)
+	{
+		char name[SYMBOL_MAXNAME];
+
+		pFile->chain[i] = hash_name(entry_name(pFile, &pEntry[i], name)) & pFile->hashmask;
+	}
+
+	sort_symbols(pEntry, pFile->chain, pHead->symcount);
+
+	pFile->relcount = 0;
+	while((pFile->relcount < pHead->symcount) && (!SYM_ABSOLUTE(pEntry[pFile->relcount].addr)))
+	{
+		pFile->relcount++;
+	}
+
+	/* Insert backwards so each chain is in symbol order */
+	for(i = pHead->symcount - 1; i >= 0; i--)
+	{
+		unsigned int bucket;
+
+		bucket = pFile->chain[i];
+		pFile->chain[i] = pFile->hash[bucket];
+		pFile->hash[bucket] = i;
+	}
+}
+
+static const struct SymfileEntry *find_symbol_name(struct SymbolFile *pFile, const char *name)
+{
+	const struct SymfileEntry *pEntry;
+	unsigned int i;
+
+	pEntry = (const struct SymfileEntry *) (pFile->data + sizeof(struct SymfileHeader));
+	i = pFile->hash[hash_name(name) & pFile->hashmask];
+	while(i != SYMHASH_END)
+	{
+		char buf[SYMBOL_MAXNAME];
+
+		if(strcmp(entry_name(pFile, &pEntry[i], buf), name) == 0)
+		{
+			return &pEntry[i];
+		}
+		i = pFile->chain[i];
+	}
+
+	return NULL;
+}
+
+int symbolFindByAddress(unsigned int addr, struct SymbolInfo *sym, unsigned int *baseaddr)
+{
+	struct SymbolFile *pFile;
+	unsigned int ba = 0;
+	int ret = 0;
+
+	lock_symbols();
+	pFile = find_module_symbols(addr, &ba);
+	if(pFile)
+	{
+		const struct SymfileEntry *pFound = NULL;
+		struct SymfileHeader *pHead;
+		struct SymfileEntry  *pEntry;
+		int i = -1;
+
+		pHead = (struct SymfileHeader *) pFile->data;
+		pEntry = (struct SymfileEntry *) (pFile->data + sizeof(struct SymfileHeader));
+
+		if(addr >= ba)
+		{
+			i = search_symbols(pEntry, 0, pFile->relcount, addr - ba);
+		}
+
+		if(i < 0)
+		{
+			i = search_symbols(pEntry, pFile->relcount, pHead->symcount, addr);
+		}
+
+		if(i >= 0)
+		{
+			pFound = resolve_entry(pFile, i);
+		}
+
+		/* Copy it out, the table may move once we let go of the lock */
+		if(pFound)
+		{
+			sym->addr = pFound->addr;
+			sym->size = pFound->size;
+			strncpy(sym->name, pFound->name, SYMBOL_MAXNAME);
+			sym->name[SYMBOL_MAXNAME-1] = 0;
+
+			/* Return base address in addr */
+			if(baseaddr)
+			{
+				*baseaddr = ba;
+			}
+			ret = 1;
+		}
+	}
+	unlock_symbols();
+
+	return ret;
+}
+
+int symbolFindNameByAddressEx(unsigned int addr, char *output, int size)
+{
+	struct SymbolInfo sym;
+	unsigned int baseaddr;
+	char symtemp[256];
+
+	if((output == NULL) || (size <= 0))
+	{
+		return 0;
+	}
+
+	if(symbolFindByAddress(addr, &sym, &baseaddr))
+	{
+		unsigned int reladdr;
+
+		reladdr = sym.addr;
+		if(baseaddr <= reladdr)
+		{
+			reladdr = reladdr - baseaddr;
+		}
+		if((baseaddr + reladdr) < addr)
+		{
+			sprintf(symtemp, "%s+0x%x", sym.name,
+					addr - (baseaddr + reladdr));
+		}
+		else
+		{
+			sprintf(symtemp, "%s", sym.name);
+		}
+	}
+	else
+	{
+		return 0;
+	}
+
+	strncpy(output, symtemp, size);
+	output[size-1] = 0;
+
+	return 1;
+}
+
+static unsigned int find_by_name(const char *name, unsigned int *size)
+{
+	const char *modname = NULL;
+	const char *symname = NULL;
+	char symbuf[128];
+	char *pcolon;
+	struct SymbolFile *pFile;
+	SceKernelModuleInfo info;
+
+	strncpy(symbuf, name, 127);
+	symbuf[127] = 0;
+	pcolon = strchr(symbuf, ':');
+	if(pcolon)
+	{
+		*pcolon = 0;
+		pcolon++;
+		modname = symbuf;
+		symname = pcolon;
+
+		if(refer_module_by_name(modname, &info) < 0)
+		{
+			printf("Error cannot find loaded module %s\n", modname);
+			return 0;
+		}
+
+		if(find_symbolfile(modname) == NULL)
+		{
+			printf("Error could not file module %s's symbols\n", modname);
+			return 0;
+		}
+	}
+	else
+	{
+		/* No module so search all of them */
+		symname = symbuf;
+	}
+
+	for(pFile = g_pHead; pFile; pFile = pFile->pNext)
+	{
+		const struct SymfileEntry *pEntry;
+		char curr[MODNAME_SIZE+1];
+
+		get_modname(pFile, curr);
+		if((modname) && (strcmp(curr, modname) != 0))
+		{
+			continue;
+		}
+
+		pEntry = find_symbol_name(pFile, symname);
+		if(pEntry == NULL)
+		{
+			continue;
+		}
+
+		if(!SYM_ABSOLUTE(pEntry->addr))
+		{
+			/* Relative symbols need their module to be loaded */
+			if((modname == NULL) && (refer_module_by_name(curr, &info) < 0))
+			{
+				continue;
+			}
+
+			if(size)
+			{
+				*size = pEntry->size;
+			}
+
+			return info.text_addr + pEntry->addr;
+		}
+
+		if(size)
+		{
+			*size = pEntry->size;
+		}
+
+		return pEntry->addr;
+	}
+
+	return 0;
+}
+
+static int enum_prefix(const char *prefix, SymbolEnumFunc func, void *arg)
+{
+	const char *modname = NULL;
+	const char *symname;
+	char modbuf[MODNAME_SIZE+1];
+	struct SymbolFile *pFile;
+	int prefixlen;
+	int count = 0;
+
+	symname = strchr(prefix, ':');
+	if(symname)
+	{
+		if((symname - prefix) > MODNAME_SIZE)
+		{
+			return 0;
+		}
+
+		memcpy(modbuf, prefix, symname - prefix);
+		modbuf[symname - prefix] = 0;
+		modname = modbuf;
+		symname++;
+	}
+	else
+	{
+		symname = prefix;
+	}
+
+	prefixlen = strlen(symname);
+
+	for(pFile = g_pHead; pFile; pFile = pFile->pNext)
+	{
+		struct SymfileHeader *pHead;
+		struct SymfileEntry  *pEntry;
+		char curr[MODNAME_SIZE+1];
+		int i;
+
+		get_modname(pFile, curr);
+		if((modname) && (strcmp(curr, modname) != 0))
+		{
+			continue;
+		}
+
+		pHead = (struct SymfileHeader *) pFile->data;
+		pEntry = (struct SymfileEntry *) (pFile->data + sizeof(struct SymfileHeader));
+		for(i = 0; i < pHead->symcount; i++)
+		{
+			struct SymfileEntry entry;
+			char name[SYMBOL_MAXNAME];
+
+			entry = pEntry[i];
+			entry.name = entry_name(pFile, &pEntry[i], name);
+			if(strncmp(entry.name, symname, prefixlen) == 0)
+			{
+				count++;
+				if(!func(curr, &entry, arg))
+				{
+					return count;
+				}
+			}
+		}
+	}
+
+	return count;
+}
+
+unsigned int symbolFindByName(const char *name, unsigned int *size)
+{
+	unsigned int ret;
+
+	lock_symbols();
+	ret = find_by_name(name, size);
+	unlock_symbols();
+
+	return ret;
+}
+
+int symbolEnumPrefix(const char *prefix, SymbolEnumFunc func, void *arg)
+{
+	int ret;
+
+	/* The callback is run with the lock held, so it must not call back in here */
+	lock_symbols();
+	ret = enum_prefix(prefix, func, arg);
+	unlock_symbols();
+
+	return ret;
+}
+
+void symbolPrintLoadList(void)
+{
+	lock_symbols();
+	if(g_pHead)
+	{
+		struct SymbolFile *pNext;
+		struct SymbolSegment *pSeg;
+		unsigned int used = 0;
+		unsigned int total = 0;
+		int segs = 0;
+
+		pNext = g_pHead;
+		while(pNext)
+		{
+			struct SymfileHeader *pHead;
 
 			pHead = (struct SymfileHeader *) pNext->data;
-			printf("Module %.28s - Size %d - Symcount %d\n", pHead->modname, pNext->size, pHead->symcount);
+			printf("Module %.28s - Size %d - Symcount %d%s\n", pHead->modname, pNext->size, pHead->symcount,
+					pNext->fd >= 0 ? " - Lazy" : "");
 			pNext = pNext->pNext;
 		}
+
+		for(pSeg = g_pSegs; pSeg; pSeg = pSeg->pNext)
+		{
+			used += pSeg->used;
+			total += pSeg->size;
+			segs++;
+		}
+		printf("Memory used %d of %d bytes in %d blocks\n", used, total, segs);
 	}
 	else
 	{
 		printf("No symbols loaded\n");
 	}
+	unlock_symbols();
 }
 
 void symbolPrintSymbols(const char *modname)
 {
 	struct SymbolFile *pFile;
 
+	lock_symbols();
 	pFile = find_symbolfile(modname);
 	if(pFile)
 	{
@@ -395,23 +1084,212 @@ void symbolPrintSymbols(const char *modname)
 		pEntry = (struct SymfileEntry *) (pFile->data + sizeof(struct SymfileHeader));
 		for(i = 0; i < pHead->symcount; i++)
 		{
+			char name[SYMBOL_MAXNAME];
+
 			printf("Symbol %d - Address 0x%08X - Size %-10d - Name %s\n", i, 
-					pEntry[i].addr, pEntry[i].size, pEntry[i].name);
+					pEntry[i].addr, pEntry[i].size, entry_name(pFile, &pEntry[i], name));
 		}
 	}
 	else
 	{
 		printf("Could not file module %s's symbols\n", modname);
 	}
+	unlock_symbols();
 }
 
-int symbolLoadSymbols(const char *file)
+/* Index a newly loaded file and replace any older symbols for the same module */
+static void finish_load(struct SymbolFile *pFile)
+{
+	struct SymbolFile *pOld;
+	char modname[MODNAME_SIZE+1];
+
+	build_index(pFile);
+
+	/* pFile may move after this */
+	pOld = find_symbolfile(get_modname(pFile, modname));
+	if(pOld != pFile)
+	{
+		free_symbolfile(pOld);
+	}
+
+	flush_cache();
+}
+
+static int reader_byte(struct SymReader *pReader)
+{
+	if(pReader->pos == pReader->len)
+	{
+		int len;
+
+		if(pReader->left == 0)
+		{
+			return -1;
+		}
+
+		len = pReader->left > SYMREADER_SIZE ? SYMREADER_SIZE : pReader->left;
+		if(sceIoRead(pReader->fd, pReader->buf, len) != len)
+		{
+			return -1;
+		}
+
+		pReader->left -= len;
+		pReader->pos = 0;
+		pReader->len = len;
+	}
+
+	return pReader->buf[pReader->pos++];
+}
+
+static int reader_varint(struct SymReader *pReader, unsigned int *val)
+{
+	int shift = 0;
+
+	*val = 0;
+	while(shift < 32)
+	{
+		int ch;
+
+		ch = reader_byte(pReader);
+		if(ch < 0)
+		{
+			return 0;
+		}
+
+		*val |= (ch & 0x7F) << shift;
+		if((ch & 0x80) == 0)
+		{
+			return 1;
+		}
+		shift += 7;
+	}
+
+	return 0;
+}
+
+/* Decode the symbols of a compressed file into the normal in memory layout */
+static int decode_symbols(struct SymReader *pReader, struct SymbolFile *pFile)
+{
+	struct SymfileHeader *pHead;
+	struct SymfileEntry  *pEntry;
+	char *pString;
+	unsigned int addr = 0;
+	unsigned int strpos = 0;
+	unsigned int prevpos = 0;
+	unsigned int prevlen = 0;
+	int i;
+
+	pHead = (struct SymfileHeader *) pFile->data;
+	pEntry = (struct SymfileEntry *) (pFile->data + sizeof(struct SymfileHeader));
+	pString = (char *) (pFile->data + pHead->strstart);
+
+	for(i = 0; i < pHead->symcount; i++)
+	{
+		unsigned int delta, size, prefix, suffix;
+		unsigned int j;
+
+		if((!reader_varint(pReader, &delta)) || (!reader_varint(pReader, &size))
+				|| (!reader_varint(pReader, &prefix)) || (!reader_varint(pReader, &suffix)))
+		{
+			return 0;
+		}
+
+		if((prefix > prevlen) || (suffix > (pHead->strsize - strpos))
+				|| ((prefix + suffix + 1) > (pHead->strsize - strpos)))
+		{
+			return 0;
+		}
+
+		addr += delta;
+		pEntry[i].addr = addr;
+		pEntry[i].size = size;
+		pEntry[i].name = &pString[strpos];
+
+		memcpy(&pString[strpos], &pString[prevpos], prefix);
+		for(j = 0; j < suffix; j++)
+		{
+			int ch;
+
+			ch = reader_byte(pReader);
+			if(ch < 0)
+			{
+				return 0;
+			}
+			pString[strpos + prefix + j] = ch;
+		}
+		pString[strpos + prefix + suffix] = 0;
+
+		prevpos = strpos;
+		prevlen = prefix + suffix;
+		strpos += prevlen + 1;
+	}
+
+	return 1;
+}
+
+static int load_compressed(const char *file, SceUID fd, unsigned int filesize)
+{
+	struct SymfileZHeader zhead;
+	struct SymfileHeader *pHead;
+	struct SymbolFile *pFile;
+	struct SymReader reader;
+	unsigned int size;
+
+	if(sceIoRead(fd, &zhead, sizeof(zhead)) != sizeof(zhead))
+	{
+		printf("Error reading data from file\n");
+		return 0;
+	}
+
+	if(zhead.version != SYMFILE_ZVERSION)
+	{
+		printf("Error unsupported symbol file version %d\n", zhead.version);
+		return 0;
+	}
+
+	if(((zhead.datasize + sizeof(zhead)) != filesize) || (zhead.symcount >= SYMHASH_END))
+	{
+		printf("Error invalid size for symbol file\n");
+		return 0;
+	}
+
+	size = sizeof(struct SymfileHeader) + (zhead.symcount * sizeof(struct SymfileEntry)) + zhead.strsize;
+	pFile = alloc_symbolfile(size, hash_size(zhead.symcount));
+	if(pFile == NULL)
+	{
+		printf("Error could not allocate memory for symbol file\n");
+		return 0;
+	}
+
+	pHead = (struct SymfileHeader *) pFile->data;
+	memcpy(pHead->magic, SYMFILE_MAGIC, 4);
+	memcpy(pHead->modname, zhead.modname, MODNAME_SIZE);
+	pHead->symcount = zhead.symcount;
+	pHead->strstart = size - zhead.strsize;
+	pHead->strsize = zhead.strsize;
+
+	memset(&reader, 0, sizeof(reader));
+	reader.fd = fd;
+	reader.left = zhead.datasize;
+	if(!decode_symbols(&reader, pFile))
+	{
+		printf("Error corrupt symbol file %s\n", file);
+		free_symbolfile(pFile);
+		return 0;
+	}
+
+	finish_load(pFile);
+
+	return 1;
+}
+
+static int load_symbols(const char *file)
 {
 	SceIoStat st;
 	struct SymbolFile *pFile = NULL;
 	struct SymfileHeader *pHead = NULL;
 	struct SymfileEntry  *pEntry = NULL;
 	const char *pString = NULL;
+	char magic[4];
 	int fd = -1;
 	int ret;
 	int i;
@@ -423,17 +1301,32 @@ int symbolLoadSymbols(const char *file)
 		goto error;
 	}
 
-	pFile = alloc_symbolfile(st.st_size);
-	if(pFile == NULL)
+	fd = sceIoOpen(file, PSP_O_RDONLY, 0777);
+	if(fd < 0)
 	{
-		printf("Error could not allocate memory for symbol file\n");
+		printf("Error could not open file %s - %08X\n", file, fd);
 		goto error;
 	}
 
-	fd = sceIoOpen(file, PSP_O_RDONLY, 0777);
-	if(fd < 0)
+	if(sceIoRead(fd, magic, sizeof(magic)) != sizeof(magic))
 	{
-		printf("Error could not open file %s - %08X\n", file, fd);
+		printf("Error reading data from file\n");
+		goto error;
+	}
+	sceIoLseek32(fd, 0, PSP_SEEK_SET);
+
+	if(memcmp(magic, SYMFILE_ZMAGIC, 4) == 0)
+	{
+		ret = load_compressed(file, fd, st.st_size);
+		sceIoClose(fd);
+		return ret;
+	}
+
+	/* Leave room for the name index assuming the file is all symbols */
+	pFile = alloc_symbolfile(st.st_size, hash_size(st.st_size / sizeof(struct SymfileEntry)));
+	if(pFile == NULL)
+	{
+		printf("Error could not allocate memory for symbol file\n");
 		goto error;
 	}
 
@@ -460,6 +1353,12 @@ int symbolLoadSymbols(const char *file)
 		goto error;
 	}
 
+	if(pHead->symcount >= SYMHASH_END)
+	{
+		printf("Error too many symbols in file\n");
+		goto error;
+	}
+
 	/* Fixup string lists */
 	pEntry = (struct SymfileEntry *) (pFile->data + sizeof(struct SymfileHeader));
 	pString = (const char *) (pFile->data + pHead->strstart);
@@ -469,6 +1368,8 @@ int symbolLoadSymbols(const char *file)
 		pEntry[i].name = &pString[(u32) pEntry[i].name];
 	}
 
+	finish_load(pFile);
+
 	return 1;
 
 error:
@@ -485,14 +1386,158 @@ error:
 	return 0;
 }
 
-/* TODO: Actually allow the deletion of a single symbol table */
-int symbolDeleteSymbols(const char *modname)
+static int load_symbols_lazy(const char *file)
 {
+	SceIoStat st;
+	struct SymfileHeader head;
+	struct SymbolFile *pFile = NULL;
+	unsigned int size;
+	int fd = -1;
+
+	memset(&st, 0, sizeof(st));
+	if(sceIoGetstat(file, &st) < 0)
+	{
+		printf("Error file %s does not exist\n", file);
+		goto error;
+	}
+
+	fd = sceIoOpen(file, PSP_O_RDONLY, 0777);
+	if(fd < 0)
+	{
+		printf("Error could not open file %s - %08X\n", file, fd);
+		goto error;
+	}
+
+	if(sceIoRead(fd, &head, sizeof(head)) != sizeof(head))
+	{
+		printf("Error reading data from file\n");
+		goto error;
+	}
+
+	if(memcmp(head.magic, SYMFILE_ZMAGIC, 4) == 0)
+	{
+		printf("Error compressed symbol files cannot be loaded lazily\n");
+		goto error;
+	}
+
+	if(memcmp(head.magic, SYMFILE_MAGIC, 4) != 0)
+	{
+		printf("Error invalid magic\n");
+		goto error;
+	}
+
+	if(((head.symcount * sizeof(struct SymfileEntry)) + head.strsize + sizeof(struct SymfileHeader)) != st.st_size)
+	{
+		printf("Error invalid size for symbol file\n");
+		goto error;
+	}
+
+	if(head.symcount >= SYMHASH_END)
+	{
+		printf("Error too many symbols in file\n");
+		goto error;
+	}
+
+	/* Only the header and entries are kept, the entries point into the string table on the host */
+	size = sizeof(struct SymfileHeader) + (head.symcount * sizeof(struct SymfileEntry));
+	pFile = alloc_symbolfile(size, hash_size(head.symcount));
+	if(pFile == NULL)
+	{
+		printf("Error could not allocate memory for symbol file\n");
+		goto error;
+	}
+
+	memcpy(pFile->data, &head, sizeof(head));
+	if(sceIoRead(fd, pFile->data + sizeof(head), size - sizeof(head)) != (size - sizeof(head)))
+	{
+		printf("Error reading data from file\n");
+		goto error;
+	}
+
+	pFile->fd = fd;
+	finish_load(pFile);
+
+	return 1;
+
+error:
+	if(pFile)
+	{
+		free_symbolfile(pFile);
+	}
+
+	if(fd >= 0)
+	{
+		sceIoClose(fd);
+	}
+
 	return 0;
 }
 
+int symbolLoadSymbols(const char *file)
+{
+	int ret;
+
+	lock_symbols();
+	ret = load_symbols(file);
+	unlock_symbols();
+
+	return ret;
+}
+
+int symbolLoadSymbolsLazy(const char *file)
+{
+	int ret;
+
+	lock_symbols();
+	ret = load_symbols_lazy(file);
+	unlock_symbols();
+
+	return ret;
+}
+
+int symbolDeleteSymbols(const char *modname)
+{
+	struct SymbolFile *pFile;
+
+	lock_symbols();
+	pFile = find_symbolfile(modname);
+	if(pFile == NULL)
+	{
+		unlock_symbols();
+		printf("Could not find module %s's symbols\n", modname);
+		return 0;
+	}
+
+	free_symbolfile(pFile);
+	unlock_symbols();
+
+	return 1;
+}
+
 void symbolDeleteAll(void)
 {
+	struct SymbolFile *pFile;
+
+	lock_symbols();
+	for(pFile = g_pHead; pFile; pFile = pFile->pNext)
+	{
+		if(pFile->fd >= 0)
+		{
+			sceIoClose(pFile->fd);
+		}
+	}
+
+	flush_cache();
 	free_mem();
 	g_pHead = NULL;
+	unlock_symbols();
+}
+
+void symbolInit(void)
+{
+	g_symsema = sceKernelCreateSema("SymbolMutex", 0, 1, 1, NULL);
+	if(g_symsema < 0)
+	{
+		printf("Error could not create symbol semaphore %08X\n", g_symsema);
+	}
 }
@@ -22,14 +22,33 @@ struct SymfileEntry
 	u32 size;
 } __attribute__((packed));
 
-const struct SymfileEntry* symbolFindByAddress(unsigned int addr, unsigned int *baseaddr);
-const char *symbolFindNameByAddress(unsigned int addr);
+#define SYMBOL_MAXNAME 128
+
+/* A copy of a symbol, the tables can move once a lookup returns */
+struct SymbolInfo
+{
+	u32 addr;
+	u32 size;
+	char name[SYMBOL_MAXNAME];
+};
+
+/* Copy the symbol containing addr into sym, baseaddr is set to its module's text address */
+int symbolFindByAddress(unsigned int addr, struct SymbolInfo *sym, unsigned int *baseaddr);
 int symbolFindNameByAddressEx(unsigned int addr, char *output, int size);
+/* Find a symbol by module:name, or by name alone in any module */
 unsigned int symbolFindByName(const char *name, unsigned int *size);
+/* Called for each symbol matched by symbolEnumPrefix, return 0 to stop. sym is only
+ * valid during the call and the callback must not call the other symbol functions */
+typedef int (*SymbolEnumFunc)(const char *modname, const struct SymfileEntry *sym, void *arg);
+/* Enumerate the symbols starting with prefix, which may be of the form module:prefix */
+int symbolEnumPrefix(const char *prefix, SymbolEnumFunc func, void *arg);
 void symbolPrintLoadList(void);
 void symbolPrintSymbols(const char *modname);
 int symbolLoadSymbols(const char *file);
+/* Load only the symbol addresses, names are read from the file when needed */
+int symbolLoadSymbolsLazy(const char *file);
 int symbolDeleteSymbols(const char *modname);
 void symbolDeleteAll(void);
+void symbolInit(void);
 
 #endif
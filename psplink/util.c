@@ -25,6 +25,8 @@
 #include "psplink.h"
 #include "util.h"
 #include "sio.h"
+#include "decodeaddr.h"
+#include "libs.h"
 
 enum UsbStates 
 {
@@ -374,6 +376,7 @@ int load_start_module(const char *name, int argc, char **argv)
 	int len;
 
 	modid = sceKernelLoadModule(name, 0, NULL);
+	memInvalidateLookups();
 	if(modid >= 0)
 	{
 		len = build_args(args, name, argc, argv);
@@ -561,6 +564,50 @@ int stop_usbhost(void)
 	return 0;
 }
 
+/* Find usbWriteBulkData in usbhostfs, NULL if it is not loaded */
+BulkWriteFunc find_bulkwrite(void)
+{
+	return (BulkWriteFunc) libsFindExportByNid(refer_module_by_name(MODULE_NAME, NULL), "USBHostFS", 0x4ABA9C2B);
+}
+
+/* Write memory to the file opened with HOSTFS_BULK_OPEN, aligned data is sent straight from
+ * memory so only a short first piece is split off to reach 64 bytes */
+int write_bulk(BulkWriteFunc bulkwrite, const void *data, u32 size)
+{
+	u32 written = 0;
+
+	while(written < size)
+	{
+		u32 addr;
+		u32 len;
+
+		addr = (u32) data + written;
+		len = size - written;
+		if(len > HOSTFS_BULK_MAXWRITE)
+		{
+			len = HOSTFS_BULK_MAXWRITE;
+		}
+
+		if(addr & 63)
+		{
+			u32 head = 64 - (addr & 63);
+
+			len = len > head ? head : len;
+		}
+
+		/* The USB controller reads memory directly */
+		sceKernelDcacheWritebackRange((void *) addr, len);
+		if(bulkwrite((void *) addr, len) != len)
+		{
+			break;
+		}
+
+		written += len;
+	}
+
+	return written;
+}
+
 void save_execargs(int argc, char **argv)
 {
 	int i;
@@ -747,52 +794,6 @@ int strtoint(const char *str, u32 *i)
 	return 1;
 }
 
-int memcmp_mask(void *data1, void *data2, void *mask, int len)
-{
-	unsigned char *m, *d1, *d2;
-	int i;
-
-	m = mask;
-	d1 = data1;
-	d2 = data2;
-
-	if(m == NULL)
-	{
-		return memcmp(data1, data2, len);
-	}
-
-	for(i = 0; i < len; i++)
-	{
-		if((d1[i] & m[i]) != d2[i])
-		{
-			return (d1[i] & m[i]) - d2[i];
-		}
-	}
-
-	return 0;
-}
-
-void* memmem_mask(void *data, void *mask, int len, void *search, int slen)
-{
-	int i;
-
-	if((data == NULL) || (len < 0) || (search == NULL) || (slen < 0))
-	{
-		return NULL;
-	}
-
-	for(i = 0; i < (len - slen + 1); i++)
-	{
-		if(memcmp_mask(data, search, mask, slen) == 0)
-		{
-			return data;
-		}
-		data++;
-	}
-
-	return NULL;
-}
-
 int decode_hexstr(const char *str, unsigned char *data, int max)
 {
 	int hexlen;
@@ -844,6 +845,11 @@ SceUID refer_module_by_addr(unsigned int addr, SceKernelModuleInfo *info)
 	return module_refer(sceKernelFindModuleByAddress(addr), info);
 }
 
+SceUID find_module_by_addr(unsigned int addr)
+{
+	return module_refer(sceKernelFindModuleByAddress(addr), NULL);
+}
+
 SceUID refer_module_by_name(const char *name, SceKernelModuleInfo *info)
 {
 	return module_refer(sceKernelFindModuleByName(name), info);
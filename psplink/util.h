@@ -46,6 +46,9 @@ int init_usbmass(void);
 int stop_usbmass(void);
 int init_usbhost(const char *bootpath);
 int stop_usbhost(void);
+typedef int (*BulkWriteFunc)(const void *data, int len);
+BulkWriteFunc find_bulkwrite(void);
+int write_bulk(BulkWriteFunc bulkwrite, const void *data, u32 size);
 void save_execargs(int argc, char **argv);
 int openfile(const char *filename, PspFile *pFile);
 int closefile(PspFile *pFile);
@@ -53,10 +56,10 @@ int fdgetc(PspFile *pFile);
 int fdgets(PspFile *pFile, char *buf, int size);
 void strip_whitesp(char *s);
 int strtoint(const char *str, u32 *i);
-void* memmem_mask(void *data, void *mask, int len, void *search, int slen);
-int memcmp_mask(void *data1, void *data2, void *mask, int len);
 int decode_hexstr(const char *str, unsigned char *data, int max);
 SceUID refer_module_by_addr(unsigned int addr, SceKernelModuleInfo *info);
+/* Get the UID of the module containing addr without querying its info */
+SceUID find_module_by_addr(unsigned int addr);
 SceUID refer_module_by_name(const char *name, SceKernelModuleInfo *info);
 int psplinkReferModule(SceUID uid, SceKernelModuleInfo *info);
 SceUID psplinkReferModuleByName(const char *name, SceKernelModuleInfo *info);
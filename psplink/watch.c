@@ -0,0 +1,483 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * watch.c - PSPLINK data watchpoints
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+#include <pspkernel.h>
+#include <pspsysmem_kernel.h>
+#include <stdio.h>
+#include <string.h>
+#include "decodeaddr.h"
+#include "debug.h"
+#include "watch.h"
+
+#define WATCH_MAX        16
+#define WATCH_PARTITION  1
+/* Sampled ranges keep one hash per line so a change can be narrowed down */
+#define WATCH_LINE       64
+/* Default time between samples in microseconds */
+#define WATCH_PERIOD     1000
+/* Above the threads of most games so a write is seen soon after it happens */
+#define WATCH_PRIORITY   16
+
+/* There is only one set of data break registers and no MMU to write protect pages with,
+ * so the first watch which fits goes in the hardware and the rest are write watches found
+ * by sampling the range from a thread */
+struct Watch
+{
+	int active;
+	unsigned int addr;
+	unsigned int size;
+	int type;
+	unsigned int flags;
+	unsigned int hits;
+	/* Number of hits to ignore before we stop */
+	unsigned int count;
+	/* Hashes of each line of a sampled range */
+	SceUID block;
+	u32 *hashes;
+	u32 nlines;
+};
+
+static struct Watch g_watches[WATCH_MAX];
+/* Watch held in the hardware registers, -1 if they are free */
+static int g_hwwatch = -1;
+/* Threads stepping over an access to the hardware watch, it stays clear until they are done */
+static int g_stepping = 0;
+/* Protects the sampled watches from the sampling thread */
+static SceUID g_watchsema = -1;
+static SceUID g_samplethid = -1;
+static volatile int g_sampling = 0;
+static unsigned int g_period = WATCH_PERIOD;
+
+static const char *g_typenames[4] = { "", "read", "write", "access" };
+
+/* The data break matches the address under a mask, so only a naturally aligned power of
+ * two can be watched exactly. Anything under a word is widened to the whole word */
+static int hw_mask(unsigned int addr, unsigned int size, unsigned int *mask)
+{
+	if(size < 4)
+	{
+		if(((addr & 3) + size) > 4)
+		{
+			return 0;
+		}
+		addr &= ~3;
+		size = 4;
+	}
+
+	if((size & (size - 1)) || (addr & (size - 1)))
+	{
+		return 0;
+	}
+
+	*mask = size - 1;
+
+	return 1;
+}
+
+static int hw_set(unsigned int addr, unsigned int mask, unsigned int ctl)
+{
+	struct DebugEnv env;
+
+	if(debugGetEnv(&env))
+	{
+		return 0;
+	}
+
+	env.DBA = addr & ~mask;
+	env.DBAM = mask;
+	env.DBC = ctl;
+
+	return debugSetEnv(&env) == 0;
+}
+
+static int hw_arm(const struct Watch *w)
+{
+	unsigned int mask;
+
+	if(!hw_mask(w->addr, w->size, &mask))
+	{
+		return 0;
+	}
+
+	return hw_set(w->addr, mask, (w->type << 20) | 2);
+}
+
+static void hw_disarm(void)
+{
+	hw_set(0, 0, 0);
+}
+
+static u32 hash_range(unsigned int start, unsigned int end)
+{
+	u32 h = 0x811C9DC5;
+
+	if(((start | end) & 3) == 0)
+	{
+		for(; start < end; start += 4)
+		{
+			h = (h ^ _lw(start)) * 0x01000193;
+		}
+	}
+	else
+	{
+		for(; start < end; start++)
+		{
+			h = (h ^ _lb(start)) * 0x01000193;
+		}
+	}
+
+	return h;
+}
+
+/* Get the part of line i which is inside the watched range */
+static void line_range(const struct Watch *w, u32 i, unsigned int *start, unsigned int *end)
+{
+	unsigned int base;
+
+	base = (w->addr & ~(WATCH_LINE - 1)) + (i * WATCH_LINE);
+	*start = base < w->addr ? w->addr : base;
+	*end = (base + WATCH_LINE) > (w->addr + w->size) ? (w->addr + w->size) : (base + WATCH_LINE);
+}
+
+static void sample_watch(int id)
+{
+	struct Watch *w = &g_watches[id];
+	unsigned int first = 0;
+	unsigned int last = 0;
+	u32 i;
+
+	for(i = 0; i < w->nlines; i++)
+	{
+		unsigned int start;
+		unsigned int end;
+		u32 h;
+
+		line_range(w, i, &start, &end);
+		h = hash_range(start, end);
+		if(h != w->hashes[i])
+		{
+			w->hashes[i] = h;
+			if(last == 0)
+			{
+				first = start;
+			}
+			last = end;
+		}
+	}
+
+	if(last != 0)
+	{
+		w->hits++;
+		if(w->hits > w->count)
+		{
+			printf("Watchpoint %d: write to 0x%08X-0x%08X, hit %d\n", id, first, last, w->hits);
+		}
+	}
+}
+
+static int sample_thread(SceSize args, void *argp)
+{
+	while(g_sampling)
+	{
+		int i;
+
+		sceKernelWaitSema(g_watchsema, 1, NULL);
+		for(i = 0; i < WATCH_MAX; i++)
+		{
+			if((g_watches[i].active) && (g_watches[i].hashes))
+			{
+				sample_watch(i);
+			}
+		}
+		sceKernelSignalSema(g_watchsema, 1);
+
+		sceKernelDelayThread(g_period);
+	}
+
+	return 0;
+}
+
+static int sample_start(void)
+{
+	if(g_samplethid >= 0)
+	{
+		return 1;
+	}
+
+	g_samplethid = sceKernelCreateThread("PspLinkWatch", sample_thread, WATCH_PRIORITY, 0x1000, 0, NULL);
+	if(g_samplethid < 0)
+	{
+		printf("Error could not create the watch thread 0x%08X\n", g_samplethid);
+		return 0;
+	}
+
+	g_sampling = 1;
+	sceKernelStartThread(g_samplethid, 0, NULL);
+
+	return 1;
+}
+
+/* Must be called without holding the watch semaphore */
+static void sample_stop(void)
+{
+	int i;
+
+	if(g_samplethid < 0)
+	{
+		return;
+	}
+
+	for(i = 0; i < WATCH_MAX; i++)
+	{
+		if((g_watches[i].active) && (g_watches[i].hashes))
+		{
+			return;
+		}
+	}
+
+	g_sampling = 0;
+	sceKernelWaitThreadEnd(g_samplethid, NULL);
+	sceKernelDeleteThread(g_samplethid);
+	g_samplethid = -1;
+}
+
+static int sample_init(struct Watch *w)
+{
+	u32 i;
+
+	w->nlines = ((w->addr & (WATCH_LINE - 1)) + w->size + WATCH_LINE - 1) / WATCH_LINE;
+	w->block = sceKernelAllocPartitionMemory(WATCH_PARTITION, "Watch", PSP_SMEM_Low, w->nlines * sizeof(u32), NULL);
+	if(w->block < 0)
+	{
+		printf("Error could not allocate watch memory %08X\n", w->block);
+		return 0;
+	}
+
+	w->hashes = sceKernelGetBlockHeadAddr(w->block);
+	for(i = 0; i < w->nlines; i++)
+	{
+		unsigned int start;
+		unsigned int end;
+
+		line_range(w, i, &start, &end);
+		w->hashes[i] = hash_range(start, end);
+	}
+
+	return 1;
+}
+
+int watchSet(unsigned int addr, unsigned int size, int type, unsigned int flags, unsigned int count)
+{
+	struct Watch *w;
+	unsigned int mask;
+	int id;
+
+	if((type < WATCH_TYPE_READ) || (type > WATCH_TYPE_ACCESS) || (size == 0))
+	{
+		printf("Error invalid watchpoint type or size\n");
+		return -1;
+	}
+
+	if(memValidate(addr, MEM_ATTRIB_READ | MEM_ATTRIB_BYTE) < size)
+	{
+		printf("Error invalid memory range for watchpoint\n");
+		return -1;
+	}
+
+	if(g_watchsema < 0)
+	{
+		g_watchsema = sceKernelCreateSema("WatchMutex", 0, 1, 1, NULL);
+	}
+
+	for(id = 0; id < WATCH_MAX; id++)
+	{
+		if(!g_watches[id].active)
+		{
+			break;
+		}
+	}
+
+	if(id == WATCH_MAX)
+	{
+		printf("Error, could not find a free watchpoint\n");
+		return -1;
+	}
+
+	w = &g_watches[id];
+	memset(w, 0, sizeof(struct Watch));
+	w->addr = addr;
+	w->size = size;
+	w->type = type;
+	w->flags = flags;
+	w->count = count;
+	w->block = -1;
+
+	if((g_hwwatch < 0) && (hw_mask(addr, size, &mask)) && (hw_arm(w)))
+	{
+		g_hwwatch = id;
+		w->active = 1;
+		return id;
+	}
+
+	if(flags & WATCH_GDB)
+	{
+		return -1;
+	}
+
+	if(type != WATCH_TYPE_WRITE)
+	{
+		printf("Error, the hardware watch is %s, only write watches can be sampled\n",
+				g_hwwatch < 0 ? "unavailable for this range" : "in use");
+		return -1;
+	}
+
+	if(!sample_init(w))
+	{
+		return -1;
+	}
+
+	sceKernelWaitSema(g_watchsema, 1, NULL);
+	w->active = 1;
+	sceKernelSignalSema(g_watchsema, 1);
+
+	if(!sample_start())
+	{
+		watchDelete(id);
+		return -1;
+	}
+
+	return id;
+}
+
+int watchDelete(int id)
+{
+	struct Watch *w;
+
+	if((id < 0) || (id >= WATCH_MAX) || (!g_watches[id].active))
+	{
+		return 0;
+	}
+
+	w = &g_watches[id];
+	if(g_hwwatch == id)
+	{
+		hw_disarm();
+		g_hwwatch = -1;
+	}
+
+	if(w->block >= 0)
+	{
+		sceKernelWaitSema(g_watchsema, 1, NULL);
+		w->active = 0;
+		sceKernelSignalSema(g_watchsema, 1);
+		sceKernelFreePartitionMemory(w->block);
+		w->block = -1;
+		w->hashes = NULL;
+		sample_stop();
+	}
+
+	w->active = 0;
+
+	return 1;
+}
+
+int watchClear(unsigned int addr, int type)
+{
+	int i;
+
+	for(i = 0; i < WATCH_MAX; i++)
+	{
+		struct Watch *w = &g_watches[i];
+
+		if((w->active) && (w->flags & WATCH_GDB) && (w->addr == addr) && (w->type == type))
+		{
+			return watchDelete(i);
+		}
+	}
+
+	return 0;
+}
+
+void watchPrint(void)
+{
+	int i;
+
+	printf("Watchpoint List:\n");
+	for(i = 0; i < WATCH_MAX; i++)
+	{
+		struct Watch *w = &g_watches[i];
+
+		if(w->active)
+		{
+			printf("%-2d: Address %08X - Size %08X - %-6s - %s - Hits %d", i, w->addr, w->size,
+					g_typenames[w->type], g_hwwatch == i ? "HW" : "Sampled", w->hits);
+			if(w->count)
+			{
+				printf(" - Ignore %d", w->count);
+			}
+			if(w->flags & WATCH_GDB)
+			{
+				printf(" - GDB");
+			}
+			printf("\n");
+		}
+	}
+	printf("Sample period %dus\n", g_period);
+}
+
+void watchSetPeriod(unsigned int us)
+{
+	g_period = us;
+}
+
+int watchHandleHit(unsigned int epc)
+{
+	struct Watch *w;
+
+	if(g_hwwatch < 0)
+	{
+		return 0;
+	}
+
+	/* Resuming would repeat the access and trap again, so it must be stepped with the
+	 * registers clear */
+	w = &g_watches[g_hwwatch];
+	w->hits++;
+	hw_disarm();
+
+	if((w->flags & WATCH_GDB) || (w->hits <= w->count))
+	{
+		g_stepping++;
+		return 2;
+	}
+
+	/* Like a breakpoint a watch is removed once it stops */
+	printf("Watchpoint %d: %s of 0x%08X-0x%08X at 0x%08X\n", g_hwwatch, g_typenames[w->type],
+			w->addr, w->addr + w->size, epc);
+	w->active = 0;
+	g_hwwatch = -1;
+
+	return 1;
+}
+
+void watchRearm(void)
+{
+	if(g_stepping > 0)
+	{
+		g_stepping--;
+	}
+
+	if((g_stepping == 0) && (g_hwwatch >= 0))
+	{
+		hw_arm(&g_watches[g_hwwatch]);
+	}
+}
@@ -0,0 +1,40 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * watch.h - PSPLINK data watchpoints
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+
+#ifndef __WATCH_H__
+#define __WATCH_H__
+
+/* Access types, the same encoding as the data break control register */
+#define WATCH_TYPE_READ   1
+#define WATCH_TYPE_WRITE  2
+#define WATCH_TYPE_ACCESS 3
+
+/* Watchpoint flags */
+/* Owned by the gdb stub, only placed in the hardware registers and stepped over by
+ * other threads */
+#define WATCH_GDB 0x0001
+
+/* Set a watchpoint ignoring the first count hits, returns its id or < 0 on error */
+int watchSet(unsigned int addr, unsigned int size, int type, unsigned int flags, unsigned int count);
+/* Clear the gdb watchpoint at addr, returns 1 if one was found */
+int watchClear(unsigned int addr, int type);
+int watchDelete(int id);
+void watchPrint(void);
+void watchSetPeriod(unsigned int us);
+/* Called on a data break, returns 1 to stop the thread or 2 to step over the access.
+ * Each thread stepping calls watchRearm once its step is done, the hardware watch goes
+ * back in when the last one has */
+int watchHandleHit(unsigned int epc);
+void watchRearm(void);
+
+#endif
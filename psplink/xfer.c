@@ -0,0 +1,269 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * xfer.c - PSPLINK file and memory transfers
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+#include <pspkernel.h>
+#include <pspsysmem_kernel.h>
+#include <stdio.h>
+#include <string.h>
+#include <usbhostfs.h>
+#include "xfer.h"
+
+#define XFER_PARTITION 1
+/* Each transfer is a whole number of hostfs blocks so the driver never sends a short one
+ * in the middle of a file */
+#define XFER_BUFSIZE   (4*HOSTFS_MAX_BLOCK)
+/* Print the progress after each this many bytes */
+#define XFER_PROGRESS  (1024*1024)
+
+struct XferStat
+{
+	u32 start;
+	u32 done;
+	u32 next;
+};
+
+/* Two buffers passed between the reader thread and the writer, empty counts the buffers
+ * the reader may fill and full the ones waiting to be written. A length <= 0 ends it */
+struct XferPipe
+{
+	int fd;
+	u8 *buf[2];
+	int len[2];
+	int bufsize;
+	SceUID empty;
+	SceUID full;
+	volatile int abort;
+};
+
+static void stat_start(struct XferStat *stat)
+{
+	stat->start = sceKernelGetSystemTimeLow();
+	stat->done = 0;
+	stat->next = XFER_PROGRESS;
+}
+
+static u32 stat_rate(const struct XferStat *stat, u32 ms)
+{
+	/* Kept in 32 bits, there is no 64 bit division without libgcc */
+	if(ms == 0)
+	{
+		return 0;
+	}
+
+	if(stat->done < (0xFFFFFFFF / 1000))
+	{
+		return ((stat->done * 1000) / ms) / 1024;
+	}
+
+	return ((stat->done / ms) * 1000) / 1024;
+}
+
+static void stat_update(struct XferStat *stat, u32 bytes)
+{
+	u32 ms;
+
+	stat->done += bytes;
+	if(stat->done >= stat->next)
+	{
+		ms = (sceKernelGetSystemTimeLow() - stat->start) / 1000;
+		printf("\r0x%08X bytes, %u KiB/s", stat->done, stat_rate(stat, ms));
+		stat->next = stat->done + XFER_PROGRESS;
+	}
+}
+
+static void stat_end(const struct XferStat *stat, const char *verb)
+{
+	u32 ms;
+
+	ms = (sceKernelGetSystemTimeLow() - stat->start) / 1000;
+	printf("\r%s 0x%08X bytes in %u.%03us (%u KiB/s)\n", verb, stat->done, ms / 1000, ms % 1000,
+			stat_rate(stat, ms));
+}
+
+static int reader_thread(SceSize args, void *argp)
+{
+	struct XferPipe *pipe = *(struct XferPipe **) argp;
+	int idx = 0;
+	int len;
+
+	do
+	{
+		sceKernelWaitSema(pipe->empty, 1, NULL);
+		len = pipe->abort ? 0 : sceIoRead(pipe->fd, pipe->buf[idx], pipe->bufsize);
+		pipe->len[idx] = len;
+		sceKernelSignalSema(pipe->full, 1);
+		idx ^= 1;
+	}
+	while(len > 0);
+
+	return 0;
+}
+
+/* Copy a file, the next buffer is read on a second thread while the last one is written */
+int xferFileToFile(int in, int out)
+{
+	struct XferPipe pipe;
+	struct XferPipe *ppipe = &pipe;
+	struct XferStat stat;
+	SceUID block;
+	SceUID thid;
+	int idx = 0;
+	int ret = 0;
+
+	memset(&pipe, 0, sizeof(pipe));
+	pipe.fd = in;
+	pipe.bufsize = XFER_BUFSIZE;
+	block = sceKernelAllocPartitionMemory(XFER_PARTITION, "XferBuffer", PSP_SMEM_Low, 2 * pipe.bufsize, NULL);
+	if(block < 0)
+	{
+		/* Fall back to a single hostfs block each */
+		pipe.bufsize = HOSTFS_MAX_BLOCK;
+		block = sceKernelAllocPartitionMemory(XFER_PARTITION, "XferBuffer", PSP_SMEM_Low, 2 * pipe.bufsize, NULL);
+		if(block < 0)
+		{
+			printf("Error could not allocate transfer buffers 0x%08X\n", block);
+			return block;
+		}
+	}
+
+	pipe.buf[0] = sceKernelGetBlockHeadAddr(block);
+	pipe.buf[1] = pipe.buf[0] + pipe.bufsize;
+	pipe.empty = sceKernelCreateSema("XferEmpty", 0, 2, 2, NULL);
+	pipe.full = sceKernelCreateSema("XferFull", 0, 0, 2, NULL);
+	thid = sceKernelCreateThread("PspLinkXfer", reader_thread, sceKernelGetThreadCurrentPriority(), 0x1000, 0, NULL);
+	if((pipe.empty < 0) || (pipe.full < 0) || (thid < 0))
+	{
+		printf("Error could not create the transfer thread\n");
+		ret = -1;
+		goto error;
+	}
+
+	stat_start(&stat);
+	sceKernelStartThread(thid, sizeof(ppipe), &ppipe);
+	while(1)
+	{
+		int len;
+
+		sceKernelWaitSema(pipe.full, 1, NULL);
+		len = pipe.len[idx];
+		if(len <= 0)
+		{
+			if((len < 0) && (ret == 0))
+			{
+				printf("\nError reading source file 0x%08X\n", len);
+				ret = len;
+			}
+			break;
+		}
+
+		/* After an error keep taking buffers until the reader sees the abort */
+		if(!pipe.abort)
+		{
+			int written;
+
+			written = sceIoWrite(out, pipe.buf[idx], len);
+			if(written != len)
+			{
+				printf("\nError writing destination file 0x%08X\n", written);
+				ret = written < 0 ? written : -1;
+				pipe.abort = 1;
+			}
+			else
+			{
+				stat_update(&stat, len);
+			}
+		}
+
+		sceKernelSignalSema(pipe.empty, 1);
+		idx ^= 1;
+	}
+
+	sceKernelWaitThreadEnd(thid, NULL);
+	if(ret == 0)
+	{
+		stat_end(&stat, "Copied");
+		ret = stat.done;
+	}
+
+error:
+	if(thid >= 0)
+	{
+		sceKernelDeleteThread(thid);
+	}
+	if(pipe.full >= 0)
+	{
+		sceKernelDeleteSema(pipe.full);
+	}
+	if(pipe.empty >= 0)
+	{
+		sceKernelDeleteSema(pipe.empty);
+	}
+	sceKernelFreePartitionMemory(block);
+
+	return ret;
+}
+
+/* Memory is the buffer, it is read into or written from in bounded pieces so progress can
+ * be shown and an error stops within a piece of where it happened */
+int xferFileToMem(int fd, u32 addr, u32 size)
+{
+	struct XferStat stat;
+
+	stat_start(&stat);
+	while(stat.done < size)
+	{
+		u32 len;
+		int ret;
+
+		len = (size - stat.done) > XFER_BUFSIZE ? XFER_BUFSIZE : (size - stat.done);
+		ret = sceIoRead(fd, (void *) (addr + stat.done), len);
+		if(ret < 0)
+		{
+			printf("\nError reading file 0x%08X\n", ret);
+			return ret;
+		}
+		else if(ret == 0)
+		{
+			break;
+		}
+
+		stat_update(&stat, ret);
+	}
+	stat_end(&stat, "Read");
+
+	return stat.done;
+}
+
+int xferMemToFile(u32 addr, u32 size, int fd)
+{
+	struct XferStat stat;
+
+	stat_start(&stat);
+	while(stat.done < size)
+	{
+		u32 len;
+		int ret;
+
+		len = (size - stat.done) > XFER_BUFSIZE ? XFER_BUFSIZE : (size - stat.done);
+		ret = sceIoWrite(fd, (void *) (addr + stat.done), len);
+		if(ret <= 0)
+		{
+			printf("\nError writing file 0x%08X\n", ret);
+			return ret < 0 ? ret : -1;
+		}
+
+		stat_update(&stat, ret);
+	}
+	stat_end(&stat, "Wrote");
+
+	return stat.done;
+}
@@ -0,0 +1,22 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * xfer.h - PSPLINK file and memory transfers
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+
+#ifndef __XFER_H__
+#define __XFER_H__
+
+/* All return the number of bytes transferred or < 0 on error, and print the throughput */
+int xferFileToFile(int in, int out);
+int xferFileToMem(int fd, u32 addr, u32 size);
+int xferMemToFile(u32 addr, u32 size, int fd);
+
+#endif
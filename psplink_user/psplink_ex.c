@@ -12,13 +12,16 @@
  */
 
 #include <pspkernel.h>
+#include <pspintrman.h>
 #include <string.h>
 #include <stdio.h>
 #include "../psplink/debug.h"
 #include "psplink_user.h"
 #include "psplink_ex.h"
 
-struct PsplinkContext g_psplinkContext[PSPLINK_MAX_CONTEXT];
+struct PsplinkContextPool g_psplinkPool;
+static struct PsplinkContext g_psplinkContext[PSPLINK_CONTEXT_CHUNK];
+static SceUID g_poolsema = -1;
 static GdbHandler g_gdbhandler = NULL;
 
 void psplinkDefaultExHandler(void);
@@ -31,19 +34,55 @@ void psplinkUserRegisterGdbHandler(GdbHandler gdbhandler)
 	g_gdbhandler = gdbhandler;
 }
 
-/* Install an error handler */
-int psplinkInitException(void)
+/* Put a chunk of contexts on the free list, interrupts are off so no other thread can
+ * except while the list is being changed */
+static void add_chunk(struct PsplinkContext *chunk)
 {
+	int intc;
 	int i;
-	memset(g_psplinkContext, 0, sizeof(g_psplinkContext));
 
-	for(i = 0; i < (PSPLINK_MAX_CONTEXT-1); i++)
+	memset(chunk, 0, PSPLINK_CONTEXT_CHUNK * sizeof(struct PsplinkContext));
+	for(i = 0; i < (PSPLINK_CONTEXT_CHUNK-1); i++)
 	{
-		g_psplinkContext[i].pNext = &g_psplinkContext[i+1];
+		chunk[i].pNext = &chunk[i+1];
 	}
 
+	intc = sceKernelCpuSuspendIntr();
+	chunk[PSPLINK_CONTEXT_CHUNK-1].pNext = g_psplinkPool.pFree;
+	g_psplinkPool.pFree = chunk;
+	g_psplinkPool.nfree += PSPLINK_CONTEXT_CHUNK;
+	g_psplinkPool.chunks[g_psplinkPool.nchunks++] = chunk;
+	sceKernelCpuResumeIntr(intc);
+}
+
+/* Called from a thread which has just taken a context so the pool grows before it runs
+ * out, contexts are never freed */
+static void grow_pool(void)
+{
+	SceUID uid;
+
+	sceKernelWaitSema(g_poolsema, 1, NULL);
+	if((g_psplinkPool.nfree < PSPLINK_CONTEXT_LOW) && (g_psplinkPool.nchunks < PSPLINK_MAX_CHUNKS))
+	{
+		uid = sceKernelAllocPartitionMemory(2, "PspLinkContext", PSP_SMEM_High, 
+				PSPLINK_CONTEXT_CHUNK * sizeof(struct PsplinkContext), NULL);
+		if(uid >= 0)
+		{
+			add_chunk((struct PsplinkContext *) sceKernelGetBlockHeadAddr(uid));
+		}
+	}
+	sceKernelSignalSema(g_poolsema, 1);
+}
+
+/* Install an error handler */
+int psplinkInitException(void)
+{
+	memset(&g_psplinkPool, 0, sizeof(g_psplinkPool));
+	add_chunk(g_psplinkContext);
+	g_poolsema = sceKernelCreateSema("PspLinkContextPool", 0, 1, 1, NULL);
+
 	return psplinkRegisterExceptions((void *) psplinkDefaultExHandler,
-			(void *) psplinkDebugExHandler, g_psplinkContext);
+			(void *) psplinkDebugExHandler, &g_psplinkPool);
 }
 
 /**
@@ -68,7 +107,13 @@ void psplinkTrap(struct PsplinkContext *ctx)
 		return;
 	}
 
+	if(g_psplinkPool.nfree < PSPLINK_CONTEXT_LOW)
+	{
+		grow_pool();
+	}
+
 	ctx->thid = thid;
+	ctx->parked = 0;
 	if(ctx->regs.type == PSPLINK_EXTYPE_DEBUG)
 	{
 		struct DebugEnv env;
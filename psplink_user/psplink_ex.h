@@ -3,8 +3,13 @@
 
 #include <stdint.h>
 
+/* Exception contexts are allocated in chunks as they are needed, the first is static */
+#define PSPLINK_CONTEXT_CHUNK 16
+#define PSPLINK_MAX_CHUNKS    32
 /* Define maximum number of thread exception context */
-#define PSPLINK_MAX_CONTEXT 8
+#define PSPLINK_MAX_CONTEXT   (PSPLINK_CONTEXT_CHUNK * PSPLINK_MAX_CHUNKS)
+/* Grow the pool when fewer than this many contexts are free */
+#define PSPLINK_CONTEXT_LOW   4
 
 #define PSPLINK_EXTYPE_NORMAL 0
 #define PSPLINK_EXTYPE_DEBUG  1
@@ -55,10 +60,23 @@ typedef struct _PsplinkRegBlock
 struct PsplinkContext
 {
 	int valid;
+	/* Next in the free list */
 	struct PsplinkContext *pNext;
 	PsplinkRegBlock regs;
 	SceUID thid;
 	unsigned int drcntl;
+	/* Set while the thread sleeps waiting for the shell to resume it */
+	int parked;
+};
+
+/* The exception handler pops contexts from the free list and resuming pushes them back,
+ * both with exceptions off. The asm depends on the first two fields */
+struct PsplinkContextPool
+{
+	struct PsplinkContext *pFree;
+	int nfree;
+	int nchunks;
+	struct PsplinkContext *chunks[PSPLINK_MAX_CHUNKS];
 };
 
 int psplinkInitException(void);
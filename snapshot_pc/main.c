@@ -0,0 +1,479 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * main.c - Rebuild and compare psplink memory snapshots
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SNAPSHOT_MAGIC  "SNAP"
+/* Size of the snapshot header and of each run */
+#define SNAPSHOT_HEADER 32
+#define SNAPSHOT_RUN    8
+
+struct Snapshot
+{
+	/* File offset of the run table */
+	long offset;
+	unsigned int seq;
+	unsigned int addr;
+	unsigned int size;
+	unsigned int nruns;
+	unsigned int time;
+	unsigned int changed;
+};
+
+struct Args
+{
+	const char *cmd;
+	const char *file;
+	char **params;
+	int nparams;
+	int words;
+	int width;
+};
+
+static struct Args g_args;
+
+static FILE *g_fp = NULL;
+static struct Snapshot *g_snaps = NULL;
+static int g_snapcount = 0;
+
+static unsigned int read32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+static unsigned int read_value(const unsigned char *p, int width)
+{
+	switch(width)
+	{
+		case 1: return p[0];
+		case 2: return p[0] | (p[1] << 8);
+		default: return read32(p);
+	};
+}
+
+static int load_index(const char *file)
+{
+	unsigned char head[SNAPSHOT_HEADER];
+	int alloc = 0;
+
+	g_fp = fopen(file, "rb");
+	if(g_fp == NULL)
+	{
+		fprintf(stderr, "Error could not open %s\n", file);
+		return 0;
+	}
+
+	while(fread(head, 1, sizeof(head), g_fp) == sizeof(head))
+	{
+		struct Snapshot *snap;
+		long next;
+
+		if(memcmp(head, SNAPSHOT_MAGIC, 4))
+		{
+			fprintf(stderr, "Error invalid snapshot header at offset %ld\n", ftell(g_fp) - SNAPSHOT_HEADER);
+			return 0;
+		}
+
+		if(g_snapcount == alloc)
+		{
+			alloc = alloc ? alloc * 2 : 64;
+			g_snaps = realloc(g_snaps, alloc * sizeof(struct Snapshot));
+			if(g_snaps == NULL)
+			{
+				fprintf(stderr, "Error could not allocate memory\n");
+				return 0;
+			}
+		}
+
+		snap = &g_snaps[g_snapcount];
+		snap->offset = ftell(g_fp);
+		snap->seq = read32(&head[4]);
+		snap->addr = read32(&head[8]);
+		snap->size = read32(&head[12]);
+		snap->nruns = read32(&head[20]);
+		snap->time = read32(&head[24]);
+		snap->changed = read32(&head[28]);
+
+		if((snap->seq != g_snapcount) || ((g_snapcount > 0)
+					&& ((snap->addr != g_snaps[0].addr) || (snap->size != g_snaps[0].size))))
+		{
+			fprintf(stderr, "Error snapshot %d does not follow on from the previous one\n", g_snapcount);
+			return 0;
+		}
+
+		next = snap->offset + (snap->nruns * SNAPSHOT_RUN) + snap->changed;
+		if((fseek(g_fp, 0, SEEK_END) != 0) || (ftell(g_fp) < next))
+		{
+			fprintf(stderr, "Warning snapshot %d is truncated\n", g_snapcount);
+			break;
+		}
+		fseek(g_fp, next, SEEK_SET);
+		g_snapcount++;
+	}
+
+	if(g_snapcount == 0)
+	{
+		fprintf(stderr, "Error no snapshots in %s\n", file);
+		return 0;
+	}
+
+	return 1;
+}
+
+/* Copy the runs of a snapshot over the image */
+static int apply_snapshot(const struct Snapshot *snap, unsigned char *image)
+{
+	unsigned char *runs;
+	unsigned int i;
+	int ret = 1;
+
+	runs = malloc(snap->nruns * SNAPSHOT_RUN + 1);
+	if(runs == NULL)
+	{
+		fprintf(stderr, "Error could not allocate memory\n");
+		return 0;
+	}
+
+	fseek(g_fp, snap->offset, SEEK_SET);
+	if(fread(runs, SNAPSHOT_RUN, snap->nruns, g_fp) != snap->nruns)
+	{
+		ret = 0;
+	}
+
+	for(i = 0; (ret) && (i < snap->nruns); i++)
+	{
+		unsigned int offset = read32(&runs[i * SNAPSHOT_RUN]);
+		unsigned int size = read32(&runs[i * SNAPSHOT_RUN + 4]);
+
+		if((offset > snap->size) || (size > (snap->size - offset))
+				|| (fread(&image[offset], 1, size, g_fp) != size))
+		{
+			ret = 0;
+		}
+	}
+
+	if(!ret)
+	{
+		fprintf(stderr, "Error reading snapshot %d\n", snap->seq);
+	}
+	free(runs);
+
+	return ret;
+}
+
+static unsigned char *alloc_image(void)
+{
+	unsigned char *image;
+
+	image = calloc(1, g_snaps[0].size);
+	if(image == NULL)
+	{
+		fprintf(stderr, "Error could not allocate memory\n");
+	}
+
+	return image;
+}
+
+/* Bring an image which holds snapshot from up to snapshot to */
+static int build_image(unsigned char *image, int from, int to)
+{
+	int i;
+
+	for(i = from + 1; i <= to; i++)
+	{
+		if(!apply_snapshot(&g_snaps[i], image))
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int get_index(const char *str, int *index)
+{
+	char *endp;
+
+	*index = strtol(str, &endp, 0);
+	if((*endp) || (*index < 0) || (*index >= g_snapcount))
+	{
+		fprintf(stderr, "Error invalid snapshot %s, there are %d\n", str, g_snapcount);
+		return 0;
+	}
+
+	return 1;
+}
+
+static int cmd_list(void)
+{
+	int i;
+
+	printf("Region 0x%08X to 0x%08X\n", g_snaps[0].addr, g_snaps[0].addr + g_snaps[0].size);
+	for(i = 0; i < g_snapcount; i++)
+	{
+		printf("%4d: %10.3fs %6u runs 0x%08X bytes\n", i, (g_snaps[i].time - g_snaps[0].time) / 1000000.0,
+				g_snaps[i].nruns, g_snaps[i].changed);
+	}
+
+	return 1;
+}
+
+static int cmd_extract(void)
+{
+	unsigned char *image;
+	FILE *fp;
+	int index;
+
+	if(!get_index(g_args.params[0], &index))
+	{
+		return 0;
+	}
+
+	image = alloc_image();
+	if((image == NULL) || (!build_image(image, -1, index)))
+	{
+		return 0;
+	}
+
+	fp = fopen(g_args.params[1], "wb");
+	if(fp == NULL)
+	{
+		fprintf(stderr, "Error could not open %s for writing\n", g_args.params[1]);
+		return 0;
+	}
+
+	if(fwrite(image, 1, g_snaps[0].size, fp) != g_snaps[0].size)
+	{
+		fprintf(stderr, "Error writing to %s\n", g_args.params[1]);
+		fclose(fp);
+		return 0;
+	}
+	fclose(fp);
+	free(image);
+
+	return 1;
+}
+
+static int cmd_diff(void)
+{
+	unsigned char *first;
+	unsigned char *second;
+	unsigned int addr;
+	unsigned int size;
+	unsigned int i;
+	int a;
+	int b;
+
+	if((!get_index(g_args.params[0], &a)) || (!get_index(g_args.params[1], &b)))
+	{
+		return 0;
+	}
+
+	if(a > b)
+	{
+		int t = a;
+		a = b;
+		b = t;
+	}
+
+	addr = g_snaps[0].addr;
+	size = g_snaps[0].size;
+	first = alloc_image();
+	second = alloc_image();
+	if((first == NULL) || (second == NULL) || (!build_image(first, -1, a)))
+	{
+		return 0;
+	}
+
+	memcpy(second, first, size);
+	if(!build_image(second, a, b))
+	{
+		return 0;
+	}
+
+	for(i = 0; i < size; i += 4)
+	{
+		unsigned int start;
+
+		if(memcmp(&first[i], &second[i], 4) == 0)
+		{
+			continue;
+		}
+
+		if(g_args.words)
+		{
+			printf("0x%08X: 0x%08X -> 0x%08X\n", addr + i, read32(&first[i]), read32(&second[i]));
+			continue;
+		}
+
+		start = i;
+		while(((i + 4) < size) && (memcmp(&first[i + 4], &second[i + 4], 4)))
+		{
+			i += 4;
+		}
+		printf("0x%08X to 0x%08X (0x%X bytes)\n", addr + start, addr + i + 4, i + 4 - start);
+	}
+
+	free(first);
+	free(second);
+
+	return 1;
+}
+
+static int cmd_query(void)
+{
+	unsigned char *image;
+	unsigned int addr;
+	unsigned int offset;
+	unsigned int last = 0;
+	char *endp;
+	int i;
+
+	addr = strtoul(g_args.params[0], &endp, 0);
+	offset = addr - g_snaps[0].addr;
+	if((*endp) || (addr < g_snaps[0].addr) || (offset > (g_snaps[0].size - g_args.width)))
+	{
+		fprintf(stderr, "Error address %s is not in the snapshot region\n", g_args.params[0]);
+		return 0;
+	}
+
+	image = alloc_image();
+	if(image == NULL)
+	{
+		return 0;
+	}
+
+	/* Print the value each time it changes */
+	for(i = 0; i < g_snapcount; i++)
+	{
+		unsigned int val;
+
+		if(!apply_snapshot(&g_snaps[i], image))
+		{
+			return 0;
+		}
+
+		val = read_value(&image[offset], g_args.width);
+		if((i == 0) || (val != last))
+		{
+			printf("%4d: %10.3fs 0x%0*X\n", i, (g_snaps[i].time - g_snaps[0].time) / 1000000.0,
+					g_args.width * 2, val);
+		}
+		last = val;
+	}
+	free(image);
+
+	return 1;
+}
+
+static void print_help(void)
+{
+	fprintf(stderr, "Usage: psp-snapshot [options] command file [params]\n");
+	fprintf(stderr, "Rebuild and compare memory snapshots taken with the psplink snapshot command\n\n");
+	fprintf(stderr, "Commands:\n");
+	fprintf(stderr, "list file              : List the snapshots in the file\n");
+	fprintf(stderr, "extract file n output  : Write the full memory image of snapshot n\n");
+	fprintf(stderr, "diff file a b          : Print the ranges which differ between snapshots a and b\n");
+	fprintf(stderr, "query file addr        : Print the value at addr each time it changes\n\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "-w      : Print each differing word with diff\n");
+	fprintf(stderr, "-s size : Value size for query, 1, 2 or 4 (default 4)\n");
+	fprintf(stderr, "-h      : Print this help\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int ch;
+
+	memset(&g_args, 0, sizeof(g_args));
+	g_args.width = 4;
+
+	while((ch = getopt(argc, argv, "ws:h")) != -1)
+	{
+		switch(ch)
+		{
+			case 'w': g_args.words = 1;
+					  break;
+			case 's': g_args.width = atoi(optarg);
+					  if((g_args.width != 1) && (g_args.width != 2) && (g_args.width != 4))
+					  {
+						  return 0;
+					  }
+					  break;
+			case 'h':
+			default: return 0;
+		};
+	}
+
+	if((argc - optind) < 2)
+	{
+		return 0;
+	}
+
+	g_args.cmd = argv[optind];
+	g_args.file = argv[optind+1];
+	g_args.params = &argv[optind+2];
+	g_args.nparams = argc - optind - 2;
+
+	return 1;
+}
+
+static const struct
+{
+	const char *name;
+	int nparams;
+	int (*func)(void);
+} g_commands[] = {
+	{ "list", 0, cmd_list },
+	{ "extract", 2, cmd_extract },
+	{ "diff", 2, cmd_diff },
+	{ "query", 1, cmd_query },
+};
+
+int main(int argc, char **argv)
+{
+	int ret;
+	int i;
+
+	if(!parse_args(argc, argv))
+	{
+		print_help();
+		return 1;
+	}
+
+	for(i = 0; i < (sizeof(g_commands) / sizeof(g_commands[0])); i++)
+	{
+		if(strcmp(g_args.cmd, g_commands[i].name) == 0)
+		{
+			break;
+		}
+	}
+
+	if((i == (sizeof(g_commands) / sizeof(g_commands[0]))) || (g_args.nparams != g_commands[i].nparams))
+	{
+		print_help();
+		return 1;
+	}
+
+	if(!load_index(g_args.file))
+	{
+		return 1;
+	}
+
+	ret = g_commands[i].func();
+	fclose(g_fp);
+
+	return ret ? 0 : 1;
+}
@@ -0,0 +1,574 @@
+/*
+ * PSPLINK
+ * -----------------------------------------------------------------------
+ * Licensed under the BSD license, see LICENSE in PSPLINK root for details.
+ *
+ * main.c - Generate psplink symbol files from an ELF or PRX
+ *
+ * Copyright (c) 2006 James F <tyranid@gmail.com>
+ *
+ * $HeadURL$
+ * $Id$
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define ELF_MACHINE_MIPS 8
+#define SHT_SYMTAB       2
+#define STT_NOTYPE       0
+#define STT_OBJECT       1
+#define STT_FUNC         2
+#define SHN_UNDEF        0
+#define SHN_ABS          0xFFF1
+
+#define MODINFO_SECTION  ".rodata.sceModuleInfo"
+
+#define SYMFILE_MAGIC    "SYMS"
+#define SYMFILE_ZMAGIC   "SYMZ"
+#define SYMFILE_ZVERSION 1
+#define MODNAME_SIZE     28
+/* Size of the SYMS header and entries */
+#define SYMFILE_HEADER   44
+#define SYMFILE_ENTRY    12
+/* psplink keeps symbol indexes in 16 bits and uses 0xFFFF as the end of a hash chain */
+#define SYMFILE_MAXSYMS  0xFFFF
+
+struct Symbol
+{
+	unsigned int addr;
+	unsigned int size;
+	const char *name;
+};
+
+struct Buffer
+{
+	unsigned char *data;
+	unsigned int len;
+	unsigned int alloc;
+};
+
+struct Args
+{
+	const char *input;
+	const char *output;
+	const char *modname;
+	int uncompressed;
+	int verbose;
+};
+
+static struct Args g_args;
+
+static unsigned char *g_file = NULL;
+static unsigned int g_filesize = 0;
+
+static struct Symbol *g_syms = NULL;
+static int g_symcount = 0;
+static int g_symalloc = 0;
+
+static char g_modname[MODNAME_SIZE+1];
+
+static unsigned int read32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+static unsigned int read16(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static int buf_reserve(struct Buffer *buf, unsigned int len)
+{
+	if((buf->len + len) > buf->alloc)
+	{
+		unsigned char *data;
+		unsigned int alloc;
+
+		alloc = buf->alloc ? buf->alloc * 2 : 4096;
+		while(alloc < (buf->len + len))
+		{
+			alloc *= 2;
+		}
+
+		data = realloc(buf->data, alloc);
+		if(data == NULL)
+		{
+			fprintf(stderr, "Error could not allocate memory\n");
+			return 0;
+		}
+		buf->data = data;
+		buf->alloc = alloc;
+	}
+
+	return 1;
+}
+
+static int buf_write(struct Buffer *buf, const void *data, unsigned int len)
+{
+	if(!buf_reserve(buf, len))
+	{
+		return 0;
+	}
+
+	memcpy(buf->data + buf->len, data, len);
+	buf->len += len;
+
+	return 1;
+}
+
+static int buf_write32(struct Buffer *buf, unsigned int val)
+{
+	unsigned char data[4];
+
+	data[0] = val;
+	data[1] = val >> 8;
+	data[2] = val >> 16;
+	data[3] = val >> 24;
+
+	return buf_write(buf, data, 4);
+}
+
+static int buf_varint(struct Buffer *buf, unsigned int val)
+{
+	unsigned char data[5];
+	int len = 0;
+
+	do
+	{
+		data[len] = val & 0x7F;
+		val >>= 7;
+		if(val)
+		{
+			data[len] |= 0x80;
+		}
+		len++;
+	}
+	while(val);
+
+	return buf_write(buf, data, len);
+}
+
+static unsigned char *load_file(const char *file, unsigned int *size)
+{
+	FILE *fp;
+	unsigned char *data = NULL;
+	long len;
+
+	fp = fopen(file, "rb");
+	if(fp == NULL)
+	{
+		fprintf(stderr, "Error could not open file %s\n", file);
+		return NULL;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	if(len > 0)
+	{
+		data = malloc(len);
+		if((data) && (fread(data, 1, len, fp) == (size_t) len))
+		{
+			*size = len;
+		}
+		else
+		{
+			fprintf(stderr, "Error reading file %s\n", file);
+			free(data);
+			data = NULL;
+		}
+	}
+	else
+	{
+		fprintf(stderr, "Error file %s is empty\n", file);
+	}
+
+	fclose(fp);
+
+	return data;
+}
+
+static int add_symbol(unsigned int addr, unsigned int size, const char *name)
+{
+	if(g_symcount == g_symalloc)
+	{
+		struct Symbol *syms;
+		int alloc;
+
+		alloc = g_symalloc ? g_symalloc * 2 : 256;
+		syms = realloc(g_syms, alloc * sizeof(struct Symbol));
+		if(syms == NULL)
+		{
+			fprintf(stderr, "Error could not allocate symbol table\n");
+			return 0;
+		}
+		g_syms = syms;
+		g_symalloc = alloc;
+	}
+
+	g_syms[g_symcount].addr = addr;
+	g_syms[g_symcount].size = size;
+	g_syms[g_symcount].name = name;
+	g_symcount++;
+
+	return 1;
+}
+
+static int sym_compare(const void *left, const void *right)
+{
+	const struct Symbol *l = left;
+	const struct Symbol *r = right;
+
+	if(l->addr < r->addr)
+	{
+		return -1;
+	}
+	else if(l->addr > r->addr)
+	{
+		return 1;
+	}
+
+	return strcmp(l->name, r->name);
+}
+
+/* Sort on address and drop exact duplicates */
+static void sort_symbols(void)
+{
+	int i;
+	int out = 0;
+
+	qsort(g_syms, g_symcount, sizeof(struct Symbol), sym_compare);
+	for(i = 0; i < g_symcount; i++)
+	{
+		if((out > 0) && (sym_compare(&g_syms[out-1], &g_syms[i]) == 0))
+		{
+			continue;
+		}
+		g_syms[out++] = g_syms[i];
+	}
+
+	g_symcount = out;
+}
+
+static int load_elf(void)
+{
+	const unsigned char *ehdr = g_file;
+	const unsigned char *shdrs;
+	const char *shstrtab = NULL;
+	unsigned int shoff, shnum, shstrndx;
+	unsigned int i;
+
+	if((g_filesize < 52) || (memcmp(g_file, "\177ELF", 4) != 0))
+	{
+		fprintf(stderr, "Error %s is not an ELF, encrypted PRXs are not supported\n", g_args.input);
+		return 0;
+	}
+
+	if((ehdr[4] != 1) || (ehdr[5] != 1) || (read16(ehdr + 18) != ELF_MACHINE_MIPS))
+	{
+		fprintf(stderr, "Error not a 32bit little endian MIPS ELF\n");
+		return 0;
+	}
+
+	shoff = read32(ehdr + 32);
+	shnum = read16(ehdr + 48);
+	shstrndx = read16(ehdr + 50);
+	if((shnum == 0) || ((shoff + (shnum * 40)) > g_filesize))
+	{
+		fprintf(stderr, "Error no section headers, the file has been stripped\n");
+		return 0;
+	}
+	shdrs = g_file + shoff;
+
+	if((shstrndx < shnum) && (read32(shdrs + (shstrndx * 40) + 16) < g_filesize))
+	{
+		shstrtab = (const char *) g_file + read32(shdrs + (shstrndx * 40) + 16);
+	}
+
+	for(i = 0; i < shnum; i++)
+	{
+		const unsigned char *sh = shdrs + (i * 40);
+		unsigned int offset = read32(sh + 16);
+		unsigned int size = read32(sh + 20);
+
+		if((shstrtab) && (strcmp(shstrtab + read32(sh), MODINFO_SECTION) == 0)
+				&& ((offset + 4 + MODNAME_SIZE) <= g_filesize))
+		{
+			/* Module name follows the attributes and version */
+			memcpy(g_modname, g_file + offset + 4, MODNAME_SIZE);
+			g_modname[MODNAME_SIZE] = 0;
+		}
+		else if(read32(sh + 4) == SHT_SYMTAB)
+		{
+			unsigned int link = read32(sh + 24);
+			const char *strtab;
+			unsigned int strsize;
+			unsigned int s;
+
+			if((link >= shnum) || ((offset + size) > g_filesize))
+			{
+				continue;
+			}
+
+			strsize = read32(shdrs + (link * 40) + 20);
+			if((read32(shdrs + (link * 40) + 16) + strsize) > g_filesize)
+			{
+				continue;
+			}
+			strtab = (const char *) g_file + read32(shdrs + (link * 40) + 16);
+
+			for(s = 0; s < (size / 16); s++)
+			{
+				const unsigned char *sym = g_file + offset + (s * 16);
+				unsigned int name = read32(sym);
+				unsigned int shndx = read16(sym + 14);
+				int type = sym[12] & 0xF;
+
+				if(((type != STT_FUNC) && (type != STT_OBJECT) && (type != STT_NOTYPE))
+						|| (shndx == SHN_UNDEF) || (shndx == SHN_ABS) || (name == 0) || (name >= strsize))
+				{
+					continue;
+				}
+
+				if(memchr(strtab + name, 0, strsize - name) == NULL)
+				{
+					continue;
+				}
+
+				if(!add_symbol(read32(sym + 4), read32(sym + 8), strtab + name))
+				{
+					return 0;
+				}
+			}
+		}
+	}
+
+	return 1;
+}
+
+/* Write the plain format read by all versions of psplink */
+static int build_plain(struct Buffer *out)
+{
+	struct Buffer strings;
+	char modname[MODNAME_SIZE];
+	unsigned int stroff = 0;
+	int i;
+
+	memset(&strings, 0, sizeof(strings));
+	memset(modname, 0, sizeof(modname));
+	memcpy(modname, g_modname, strlen(g_modname));
+
+	if((!buf_write(out, SYMFILE_MAGIC, 4)) || (!buf_write(out, modname, MODNAME_SIZE)))
+	{
+		return 0;
+	}
+
+	for(i = 0; i < g_symcount; i++)
+	{
+		buf_write(&strings, g_syms[i].name, strlen(g_syms[i].name) + 1);
+	}
+
+	buf_write32(out, g_symcount);
+	buf_write32(out, SYMFILE_HEADER + (g_symcount * SYMFILE_ENTRY));
+	buf_write32(out, strings.len);
+
+	for(i = 0; i < g_symcount; i++)
+	{
+		buf_write32(out, stroff);
+		buf_write32(out, g_syms[i].addr);
+		buf_write32(out, g_syms[i].size);
+		stroff += strlen(g_syms[i].name) + 1;
+	}
+
+	if(!buf_write(out, strings.data, strings.len))
+	{
+		return 0;
+	}
+	free(strings.data);
+
+	return 1;
+}
+
+/* Write the compressed format, see symbols.c for the layout */
+static int build_compressed(struct Buffer *out)
+{
+	struct Buffer data;
+	char modname[MODNAME_SIZE];
+	const char *prev = "";
+	unsigned int addr = 0;
+	unsigned int strsize = 0;
+	int i;
+
+	memset(&data, 0, sizeof(data));
+	memset(modname, 0, sizeof(modname));
+	memcpy(modname, g_modname, strlen(g_modname));
+
+	for(i = 0; i < g_symcount; i++)
+	{
+		const char *name = g_syms[i].name;
+		unsigned int prefix = 0;
+		unsigned int len;
+
+		while((prev[prefix]) && (prev[prefix] == name[prefix]))
+		{
+			prefix++;
+		}
+		len = strlen(name);
+
+		if((!buf_varint(&data, g_syms[i].addr - addr)) || (!buf_varint(&data, g_syms[i].size))
+				|| (!buf_varint(&data, prefix)) || (!buf_varint(&data, len - prefix))
+				|| (!buf_write(&data, name + prefix, len - prefix)))
+		{
+			return 0;
+		}
+
+		addr = g_syms[i].addr;
+		strsize += len + 1;
+		prev = name;
+	}
+
+	if((!buf_write(out, SYMFILE_ZMAGIC, 4)) || (!buf_write(out, modname, MODNAME_SIZE)))
+	{
+		return 0;
+	}
+	buf_write32(out, SYMFILE_ZVERSION);
+	buf_write32(out, g_symcount);
+	buf_write32(out, strsize);
+	buf_write32(out, data.len);
+	if(!buf_write(out, data.data, data.len))
+	{
+		return 0;
+	}
+	free(data.data);
+
+	return 1;
+}
+
+static void print_help(void)
+{
+	fprintf(stderr, "Usage: psp-symgen [options] input.elf output.sym\n");
+	fprintf(stderr, "Generate a psplink symbol file from an ELF or PRX\n\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "-m name : Set the module name, otherwise taken from the module info\n");
+	fprintf(stderr, "-u      : Write the uncompressed format for older versions of psplink\n");
+	fprintf(stderr, "-v      : Verbose output\n");
+	fprintf(stderr, "-h      : Print this help\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int ch;
+
+	memset(&g_args, 0, sizeof(g_args));
+
+	while((ch = getopt(argc, argv, "m:uvh")) != -1)
+	{
+		switch(ch)
+		{
+			case 'm': g_args.modname = optarg;
+					  break;
+			case 'u': g_args.uncompressed = 1;
+					  break;
+			case 'v': g_args.verbose = 1;
+					  break;
+			case 'h':
+			default: return 0;
+		};
+	}
+
+	if((argc - optind) != 2)
+	{
+		return 0;
+	}
+
+	g_args.input = argv[optind];
+	g_args.output = argv[optind+1];
+
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	struct Buffer out;
+	FILE *fp;
+	int ret;
+
+	if(!parse_args(argc, argv))
+	{
+		print_help();
+		return 1;
+	}
+
+	g_file = load_file(g_args.input, &g_filesize);
+	if((g_file == NULL) || (!load_elf()))
+	{
+		return 1;
+	}
+
+	if(g_args.modname)
+	{
+		strncpy(g_modname, g_args.modname, MODNAME_SIZE);
+		g_modname[MODNAME_SIZE] = 0;
+	}
+
+	if(g_modname[0] == 0)
+	{
+		fprintf(stderr, "Error no module info found, specify the module name with -m\n");
+		return 1;
+	}
+
+	if(g_symcount == 0)
+	{
+		fprintf(stderr, "Error no symbols found in %s\n", g_args.input);
+		return 1;
+	}
+
+	sort_symbols();
+
+	if(g_symcount >= SYMFILE_MAXSYMS)
+	{
+		fprintf(stderr, "Error %d symbols after removing duplicates, psplink can load at most %d\n",
+				g_symcount, SYMFILE_MAXSYMS - 1);
+		return 1;
+	}
+
+	memset(&out, 0, sizeof(out));
+	if(g_args.uncompressed)
+	{
+		ret = build_plain(&out);
+	}
+	else
+	{
+		ret = build_compressed(&out);
+	}
+
+	if(!ret)
+	{
+		return 1;
+	}
+
+	fp = fopen(g_args.output, "wb");
+	if(fp == NULL)
+	{
+		fprintf(stderr, "Error could not open %s for writing\n", g_args.output);
+		return 1;
+	}
+
+	if(fwrite(out.data, 1, out.len, fp) != out.len)
+	{
+		fprintf(stderr, "Error writing to %s\n", g_args.output);
+		fclose(fp);
+		return 1;
+	}
+	fclose(fp);
+
+	if(g_args.verbose)
+	{
+		printf("Module %s - %d symbols - %d bytes\n", g_modname, g_symcount, out.len);
+	}
+
+	return 0;
+}
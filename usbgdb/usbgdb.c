@@ -33,15 +33,19 @@ int putDebugChar(unsigned char ch)
 	return usbAsyncWrite(ASYNC_GDB, &ch, 1);
 }
 
-int getDebugChar(unsigned char *ch)
+int maxPacketSize(void)
 {
-	int ret = 0;
+	/* Incoming data beyond the async buffer is dropped, leave room for acks */
+	return MAX_ASYNC_BUFFER - 64;
+}
 
-	*ch = 0;
+int readDebugData(void *data, int len)
+{
+	int ret = 0;
 
 	do
 	{
-		ret = usbAsyncRead(ASYNC_GDB, ch, 1);
+		ret = usbAsyncRead(ASYNC_GDB, data, len);
 	}
 	while(ret < 1);
 
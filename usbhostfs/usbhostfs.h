@@ -23,6 +23,7 @@
 #define HOSTFS_MAGIC 0x782F0812
 #define ASYNC_MAGIC  0x782F0813
 #define BULK_MAGIC   0x782F0814
+#define MEMREAD_MAGIC 0x782F0815
 
 #define HOSTFS_PATHMAX (4096)
 
@@ -34,6 +35,8 @@
 
 #define HOSTFS_BULK_OPEN      (1 << 24)
 
+#define MEMREAD_MAXSIZE       (64*1024)
+
 #define DEVCTL_GET_INFO       0x02425818
 
 struct DevctlGetInfo
@@ -56,6 +59,8 @@ enum USB_ASYNC_CHANNELS
 	ASYNC_GDB      = 1,
 	ASYNC_STDOUT   = 2,
 	ASYNC_STDERR   = 3,
+	/* The last channel so ASYNC_USER allocations are unchanged */
+	ASYNC_MEMORY   = 7,
 };
 
 #define MAX_ASYNC_CHANNELS 8
@@ -348,6 +353,15 @@ struct AsyncCommand
 	uint32_t channel;
 } __attribute__((packed));
 
+/* Memory read request on ASYNC_MEMORY, the reply is the same header with size set to the
+ * number of readable bytes which follow it */
+struct MemReadCommand
+{
+	uint32_t magic;
+	uint32_t addr;
+	uint32_t size;
+} __attribute__((packed));
+
 struct BulkCommand
 {
 	uint32_t magic;
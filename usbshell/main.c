@@ -19,6 +19,7 @@
 #include <string.h>
 #include <usbhostfs.h>
 #include <usbasync.h>
+#include "../psplink/decodeaddr.h"
 
 PSP_MODULE_INFO("USBShell", PSP_MODULE_KERNEL, 1, 1);
 
@@ -30,6 +31,7 @@ void psplinkPrintPrompt(void);
 void psplinkExitShell(void);
 
 struct AsyncEndpoint g_endp;
+struct AsyncEndpoint g_memendp;
 
 int usbPrint(const char *data, int size)
 {
@@ -78,6 +80,62 @@ int main_thread(SceSize args, void *argp)
 	return 0;
 }
 
+/* Serve binary memory reads so PC frontends can render memory themselves */
+int mem_thread(SceSize args, void *argp)
+{
+	struct MemReadCommand cmd;
+	int pos = 0;
+
+	usbAsyncRegister(ASYNC_MEMORY, &g_memendp);
+	usbWaitForConnect();
+
+	while(1)
+	{
+		u32 size_left;
+		int ret;
+
+		ret = usbAsyncRead(ASYNC_MEMORY, ((unsigned char *) &cmd) + pos, sizeof(cmd) - pos);
+		if(ret < 0)
+		{
+			sceKernelDelayThread(250000);
+			continue;
+		}
+
+		pos += ret;
+		if(pos < sizeof(cmd))
+		{
+			continue;
+		}
+		pos = 0;
+
+		if(cmd.magic != MEMREAD_MAGIC)
+		{
+			/* Lost track of the requests, drop anything pending */
+			usbAsyncFlush(ASYNC_MEMORY);
+			continue;
+		}
+
+		if(cmd.size > MEMREAD_MAXSIZE)
+		{
+			cmd.size = MEMREAD_MAXSIZE;
+		}
+
+		size_left = memValidate(cmd.addr, MEM_ATTRIB_READ | MEM_ATTRIB_BYTE);
+		if(cmd.size > size_left)
+		{
+			cmd.size = size_left;
+		}
+
+		usbAsyncWrite(ASYNC_MEMORY, &cmd, sizeof(cmd));
+		if(cmd.size > 0)
+		{
+			usbAsyncWrite(ASYNC_MEMORY, (void *) cmd.addr, cmd.size);
+		}
+	}
+
+	return 0;
+}
+
 /* Entry point */
 int module_start(SceSize args, void *argp)
 {
@@ -89,6 +147,13 @@ int module_start(SceSize args, void *argp)
 	{
 		sceKernelStartThread(thid, args, argp);
 	}
+
+	thid = sceKernelCreateThread("USBShellMem", mem_thread, 16, 0x1000, 0, NULL);
+	if(thid >= 0)
+	{
+		sceKernelStartThread(thid, 0, NULL);
+	}
+
 	return 0;
 }
 